@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_BINARY_LOG_H
+#define ROBOMETRY_BINARY_LOG_H
+
+#include <robometry/BufferConfig.h>
+#include <robometry/ContiguousBuffer.h>
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief Get the name of an arithmetic type as stored in the robometry binary log, e.g. "double" or "int32".
+ *
+ * @return The name of the type, empty if the type is not supported.
+ */
+template<typename T>
+std::string binaryLogElementType()
+{
+    if constexpr (std::is_same_v<T, bool>) {
+        return "logical";
+    }
+    else if constexpr (std::is_same_v<T, char>) {
+        return "char";
+    }
+    else if constexpr (std::is_floating_point_v<T>) {
+        return sizeof(T) == sizeof(float) ? "single" : (sizeof(T) == sizeof(double) ? "double" : "");
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        return std::string(std::is_signed_v<T> ? "int" : "uint") + std::to_string(8 * sizeof(T));
+    }
+    else {
+        return "";
+    }
+}
+
+/**
+ * @brief Description of a channel of the robometry binary log.
+ */
+struct BinaryLogChannelSchema {
+    std::string name; /**< Full name of the channel, e.g. joints::positions */
+    dimensions_t dimensions; /**< Dimensions of a single sample */
+    elements_names_t elements_names; /**< Names of the elements of a sample */
+    units_of_measure_t units_of_measure; /**< Units of measure of the elements */
+    std::string element_type; /**< Type of the elements, see robometry::binaryLogElementType */
+    size_t sample_size{ 0 }; /**< Size in bytes of a sample */
+    std::string clock_group; /**< The clock group providing the timestamps, empty if the channel has its own timestamps */
+    ChannelCodec codec{ ChannelCodec::None }; /**< The codec compressing the blocks of the channel, see robometry::ChannelInfo::codec */
+};
+
+/**
+ * @brief Serialize the description of a channel as a json string.
+ *
+ * @param[in] schema The description of the channel.
+ * @return The json string.
+ */
+std::string channelSchemaToJson(const BinaryLogChannelSchema& schema);
+
+/**
+ * @brief Parse the description of a channel from a json string, see robometry::channelSchemaToJson.
+ *
+ * @param[in] json The json string.
+ * @param[out] schema The description of the channel.
+ * @return true on success, false otherwise.
+ */
+bool channelSchemaFromJson(const std::string& json, BinaryLogChannelSchema& schema);
+
+/**
+ * @brief The samples of a channel read back from a log, e.g. a robometry binary log.
+ */
+struct BinaryLogChannelSamples {
+    BinaryLogChannelSchema schema; /**< The description of the channel */
+    std::vector<unsigned char> data; /**< The bytes of the samples, one after the other */
+    std::vector<double> timestamps; /**< The timestamps of the samples, empty if they are provided by the clock group */
+    size_t num_samples{ 0 }; /**< The number of samples */
+    size_t overwritten_samples{ 0 }; /**< The samples lost by the channel because it was full, see robometry::ChannelCounters */
+    size_t dropped_samples{ 0 }; /**< The samples not stored by the channel because it was full, see robometry::ChannelCounters */
+};
+
+/**
+ * @brief The content of a log read back, converted to a .mat file by robometry::logContentToMat.
+ */
+struct BinaryLogContent {
+    std::string filename{ "robometry_log" }; /**< The name of the struct containing the channels */
+    std::string yarp_robot_name; /**< The yarp robot name */
+    std::vector<std::string> description_list; /**< The description list */
+    std::vector<BinaryLogChannelSamples> channels; /**< The channels, in the order they are saved */
+    std::map<std::string, std::vector<double>> clock_groups; /**< The timestamps of the clock groups */
+};
+
+/**
+ * @brief Save the content of a log to a .mat file with the same layout of robometry::BufferManager::saveToFile.
+ * The channels without samples are skipped.
+ *
+ * @param[in] content The content of the log.
+ * @param[in] mat_file_name The name of the .mat file to be created.
+ * @param[in] mat_file_version The version of the .mat file.
+ * @return true on success, false otherwise.
+ */
+bool logContentToMat(const BinaryLogContent& content,
+                     const std::string& mat_file_name,
+                     matioCpp::FileVersion mat_file_version = matioCpp::FileVersion::Default);
+
+/**
+ * @brief Writer of the robometry binary log, an append-only format that can be written incrementally
+ * and converted offline to the .mat layout of robometry::BufferManager::saveToFile with robometry::binaryLogToMat.
+ *
+ * The file starts with the 8 bytes magic "RBMTRLOG" and the uint32 version of the format, followed by records.
+ * Each record is made of the uint8 kind, the uint32 id of the channel or clock group it refers to, and
+ * the uint64 size of the payload, followed by the payload. The numbers are written in the byte order of the
+ * machine writing the log. The records are:
+ * - Header: json object with filename, yarp_robot_name and description_list.
+ * - ChannelSchema: json object describing a channel, see robometry::BinaryLogChannelSchema.
+ * - ClockGroupSchema: json object with the name of a clock group.
+ * - ChannelBlock: uint64 number of samples, the bytes of the samples (column-major, one sample after the other)
+ *   and then, if the channel has its own timestamps, the double timestamps.
+ * - ClockGroupBlock: uint64 number of samples and the double timestamps.
+ * - EncodedChannelBlock: uint64 number of samples, uint64 size of the encoded samples, the samples encoded with
+ *   the codec of the channel (see robometry::encodeSamples) and then, if the channel has its own timestamps,
+ *   the timestamps encoded with robometry::encodeTimestamps.
+ * - EncodedClockGroupBlock: uint64 number of samples and the timestamps encoded with robometry::encodeTimestamps.
+ * - ChannelCounters: uint64 overwritten samples and uint64 dropped samples of a channel since the beginning,
+ *   see robometry::ChannelCounters. The last record of a channel holds its final counters.
+ * A record truncated because the writer was interrupted is ignored when reading.
+ *
+ */
+class BinaryLogWriter {
+public:
+    /**
+     * @brief The kinds of the records of the log.
+     */
+    enum class RecordKind : uint8_t {
+        Header = 0,
+        ChannelSchema = 1,
+        ClockGroupSchema = 2,
+        ChannelBlock = 3,
+        ClockGroupBlock = 4,
+        EncodedChannelBlock = 5,
+        EncodedClockGroupBlock = 6,
+        ChannelCounters = 7
+    };
+
+    static constexpr char magic[8] = { 'R', 'B', 'M', 'T', 'R', 'L', 'O', 'G' }; /**< The first bytes of the file */
+    static constexpr uint32_t version{ 1 }; /**< The version of the format */
+
+    /**
+     * @brief Create the log file and write the header.
+     *
+     * @param[in] file_name The name of the file, it is overwritten if it exists.
+     * @param[in] config The configuration providing the filename, yarp_robot_name and description_list of the header.
+     * @return true on success, false otherwise.
+     */
+    bool open(const std::string& file_name, const BufferConfig& config);
+
+    /**
+     * @brief Return true if the log file is open, false otherwise.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Write the description of a channel, it has to precede the blocks of the channel.
+     * If the codec of the channel does not support the type of its elements, the channel is written uncompressed.
+     *
+     * @param[in] id The id of the channel, unique in the log.
+     * @param[in] schema The description of the channel.
+     * @return true on success, false otherwise.
+     */
+    bool writeChannelSchema(uint32_t id, const BinaryLogChannelSchema& schema);
+
+    /**
+     * @brief Write the description of a clock group, it has to precede the blocks of the clock group.
+     *
+     * @param[in] id The id of the clock group, unique among the clock groups of the log.
+     * @param[in] name The name of the clock group.
+     * @return true on success, false otherwise.
+     */
+    bool writeClockGroupSchema(uint32_t id, const std::string& name);
+
+    /**
+     * @brief Write the samples of a channel, without copying them unless the channel has a codec.
+     *
+     * @param[in] id The id of the channel.
+     * @param[in] samples The samples of the channel.
+     * @param[in] with_timestamps true for writing the timestamps of the samples, false if they are provided by a clock group.
+     * @return true on success, false otherwise.
+     */
+    bool writeChannelBlock(uint32_t id, const ContiguousBuffer::DetachedSamples& samples, bool with_timestamps);
+
+    /**
+     * @brief Write the timestamps of a clock group, that are stored as the samples of a ContiguousBuffer.
+     *
+     * @param[in] id The id of the clock group.
+     * @param[in] timestamps The timestamps of the clock group.
+     * @param[in] encode_timestamps true for compressing the timestamps with robometry::encodeTimestamps.
+     * @return true on success, false otherwise.
+     */
+    bool writeClockGroupBlock(uint32_t id, const ContiguousBuffer::DetachedSamples& timestamps, bool encode_timestamps = false);
+
+    /**
+     * @brief Write the counters of the samples lost by a channel since the beginning.
+     *
+     * @param[in] id The id of the channel.
+     * @param[in] overwritten_samples The number of samples overwritten because the channel was full.
+     * @param[in] dropped_samples The number of samples dropped because the channel was full.
+     * @return true on success, false otherwise.
+     */
+    bool writeChannelCounters(uint32_t id, uint64_t overwritten_samples, uint64_t dropped_samples);
+
+    /**
+     * @brief Flush the records written so far to the file.
+     *
+     * @return true on success, false otherwise.
+     */
+    bool flush();
+
+private:
+    void writeRecordHeader(RecordKind kind, uint32_t id, uint64_t payload_size);
+
+    template<typename T>
+    void writeValue(const T& value)
+    {
+        m_file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    std::ofstream m_file;
+    std::map<uint32_t, BinaryLogChannelSchema> m_encoded_channels; // The schemas of the channels with a codec
+    std::vector<unsigned char> m_encoded; // The encoded bytes of the last block, reused between blocks
+};
+
+/**
+ * @brief Convert a robometry binary log to a .mat file with the same layout of robometry::BufferManager::saveToFile.
+ *
+ * @param[in] log_file_name The name of the binary log.
+ * @param[in] mat_file_name The name of the .mat file to be created.
+ * @param[in] mat_file_version The version of the .mat file.
+ * @return true on success, false otherwise.
+ */
+bool binaryLogToMat(const std::string& log_file_name,
+                    const std::string& mat_file_name,
+                    matioCpp::FileVersion mat_file_version = matioCpp::FileVersion::Default);
+
+} // robometry
+
+#endif // ROBOMETRY_BINARY_LOG_H
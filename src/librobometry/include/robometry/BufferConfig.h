@@ -19,6 +19,25 @@ namespace robometry {
 using dimensions_t = std::vector<size_t>;
 using elements_names_t = std::vector<std::string>;
 using units_of_measure_t = std::vector<std::string>;
+
+/**
+ * @brief The codecs compressing the samples of a channel in the robometry binary log, see robometry::ChannelInfo::codec.
+ */
+enum class ChannelCodec {
+    None, /**< The samples are stored as they are */
+    Delta, /**< Delta of each element with the previous sample, zigzag and varint encoded. For integer channels. */
+    Xor /**< XOR of each element with the previous sample, with the bit packing of Gorilla. For floating point channels. */
+};
+
+/**
+ * @brief What a channel does when a sample is pushed and it is full, see robometry::ChannelInfo::overflow_policy.
+ */
+enum class OverflowPolicy {
+    OverwriteOldest, /**< The oldest sample is overwritten by the new one */
+    DropNewest, /**< The new sample is dropped */
+    Flush /**< The channel is saved in background when it reaches robometry::BufferConfig::flush_watermark, and if it gets full anyway the oldest sample is overwritten */
+};
+
 /**
  * @brief Struct representing a channel(variable) in terms of
  * name and dimensions and names of the each element of a variable.
@@ -28,6 +47,50 @@ struct ChannelInfo {
     dimensions_t dimensions; /**< Dimension of the channel */
     elements_names_t elements_names; /**< Vector containing the names of each element of the channel */
     units_of_measure_t units_of_measure; /**< Units of measure of the channel */
+    /** If true, the numeric samples of the channel are stored in a single-producer/single-consumer lock-free buffer.
+     * The producer never blocks, and when the buffer is full the new samples are dropped. The samples after a trigger
+     * are not copied while they are pushed, see robometry::BufferManager::trigger(const std::string&, double). */
+    bool lock_free{ false };
+    /** Name of the clock group of the channel, empty if the channel does not belong to a group.
+     * The channels of the same clock group are sampled together, and they are added to a frame with the name of the group
+     * (see robometry::BufferManager::addFrame). A single timestamps vector is saved for the whole group. */
+    std::string clock_group{ "" };
+    /** Codec compressing the samples of the channel when they are written to the robometry binary log
+     * (see robometry::SaveFormat::BinaryLog). If it is not robometry::ChannelCodec::None, the timestamps of the channel,
+     * or of its clock group, are compressed as well with a delta-of-delta encoding. The .mat files are not affected. */
+    ChannelCodec codec{ ChannelCodec::None };
+    /** Nominal sampling period of the channel in seconds, used as `dt` of its timestamps when they are saved implicitly
+     * (see robometry::BufferConfig::implicit_timestamps). If 0, the period is estimated from the timestamps. */
+    double sampling_period{ 0.0 };
+    /** Decimation factor of the channel: only one sample every `decimation` pushed samples is stored, starting from the first.
+     * The channels of a clock group cannot be decimated. */
+    size_t decimation{ 1 };
+    /** If true and the channel is decimated, its floating point samples are filtered before the decimation by a low-pass filter
+     * with a cutoff at half of the Nyquist frequency of the stored samples, see robometry::Decimator. */
+    bool decimation_filter{ false };
+    /** If true, a sample of the channel is stored only if it changed with respect to the last stored one, see
+     * robometry::ChannelInfo::deadband. The stored samples hold until the next one, and their timestamps tell when the
+     * channel changed. It is applied after the decimation, and the channels of a clock group cannot use it. After each save the
+     * next sample is stored even if it did not change, hence each file holds the value of the channel from its first sample on. */
+    bool on_change{ false };
+    /** The largest change of an element that is ignored when robometry::ChannelInfo::on_change is true, 0 for storing any change. */
+    double deadband{ 0.0 };
+    /** If true, the minimum, maximum, mean, variance and count of each element of the numeric channel are updated at each push,
+     * before the decimation and the deadband. They can be read with robometry::BufferManager::getStatistics, and they are saved
+     * in the .mat files in the `statistics` field of the channel, computed on all the samples pushed until the save.
+     * Reading them never blocks the producer, hence they can be used by the lock-free channels as well. */
+    bool statistics{ false };
+    /** If greater than 0, the numeric channel keeps the samples of the last `retention` seconds instead of the last n_samples samples.
+     * When a sample is stored, the ones older than `retention` with respect to it are removed. The capacity holds the samples
+     * of `retention` plus 25%, and at most the memory_budget if it is set. It is computed once when the channel is added at the
+     * nominal rate given by sampling_period. If sampling_period is 0, the capacity is n_samples until the first save, and then
+     * it follows the rate measured between the saves, changing right after them when the channel is empty. When the capacity
+     * is not enough, the overflow_policy applies. It cannot be used by the lock-free channels and by the channels of a clock group. */
+    double retention{ 0.0 };
+    /** What the channel does when it is full. The samples overwritten and dropped are counted, see
+     * robometry::BufferManager::getChannelCounters, and the counters are saved in the .mat files. The lock-free channels cannot
+     * overwrite the oldest samples, hence they drop the new ones with any policy. */
+    OverflowPolicy overflow_policy{ OverflowPolicy::OverwriteOldest };
     /**
      * @brief Default constructor
      */
@@ -48,6 +111,14 @@ struct ChannelInfo {
 
 };
 
+/**
+ * @brief The format of the files saved by a robometry::BufferManager.
+ */
+enum class SaveFormat {
+    Mat, /**< A .mat file for each save, see robometry::BufferConfig::mat_file_version */
+    BinaryLog /**< A robometry binary log for the whole session, see robometry::BinaryLogWriter */
+};
+
 /**
  * @brief Struct containing the parameters for configuring a robometry::BufferManager.
  *
@@ -68,6 +139,65 @@ struct BufferConfig {
       * is used. Othewrise `std::put_time` is used to generate the indexing. https://en.cppreference.com/w/cpp/io/manip/put_time */
     std::string file_indexing{ "time_since_epoch" };
     matioCpp::FileVersion mat_file_version{ matioCpp::FileVersion::Default }; /**< Version of the saved matfile.  */
+    /** Number of threads converting the channels when saving a file, including the one calling the save.
+     * If 1 the channels are converted serially, if 0 the number of concurrent threads supported by the system is used. */
+    size_t save_threads{ 1 };
+    /** If true, all the saves of a session append the new samples to the same file, created at the first save.
+     * It requires `mat_file_version` to be `v7_3`, see robometry::BufferManager::saveToFile for the layout of the file.
+     * Only the numeric channels can be appended: the samples of the other channels are discarded at each save, with a message
+     * naming the channel. */
+    bool append_to_file{ false };
+    /** The format of the saved files. With robometry::SaveFormat::BinaryLog the samples are streamed to a `.rblog` file,
+     * that can be converted to the usual .mat file with robometry::binaryLogToMat or the robometry_log_to_mat tool. */
+    SaveFormat save_format{ SaveFormat::Mat };
+    /** If not empty, the samples of the numeric channels are stored in memory-mapped temporary files created in this
+     * directory, so that recordings larger than the physical memory are paged out to disk. The files are removed when
+     * the robometry::BufferManager is destroyed. The channels of other types are always stored on the heap. */
+    std::string memory_mapped_path{ "" };
+    /** If not empty, the samples of the numeric channels are also copied to rings in persistent memory-mapped files,
+     * that survive a crash of the process. The rings of a session are in a directory `<filename>_<index>` created in this path,
+     * that after a crash can be converted to a .mat file with robometry::flightRecorderToMat or the robometry_flight_recorder_to_mat
+     * tool. Each ring keeps the last n_samples samples, and the directory is removed when the robometry::BufferManager is destroyed. */
+    std::string flight_recorder_path{ "" };
+    /** If not empty, the samples stored in memory by the numeric channels are dumped to the file `<filename>_<index>_emergency_dump.rblog`
+     * in this path when the process receives SIGSEGV, SIGABRT or SIGTERM, see robometry::EmergencyDump. The file is opened by
+     * robometry::BufferManager::configure, and it is removed when the robometry::BufferManager is destroyed if nothing was dumped.
+     * It is supported only on POSIX systems. */
+    std::string emergency_dump_path{ "" };
+    /** If true, the timestamps of the regularly sampled channels and clock groups are saved in the .mat files as a struct
+     * `timestamps` with the first timestamp `t0`, the period `dt`, the number of samples `num_samples`, and the sparse
+     * `exceptions_indices` (1-based) and `exceptions_values` of the samples starting a new grid. The timestamp of the sample i
+     * is the value of the last exception e before it plus (i - e) * dt, where t0 is the exception of the first sample.
+     * The timestamps are saved as a vector if they are too irregular. It does not affect the append mode and the binary log. */
+    bool implicit_timestamps{ false };
+    /** The largest distance of a timestamp from its grid, as a fraction of dt, for not being saved as an exception
+     * when robometry::BufferConfig::implicit_timestamps is true. */
+    double implicit_timestamps_tolerance{ 0.1 };
+    /** The duration in seconds of the window captured before a trigger, see robometry::BufferManager::trigger.
+     * The samples older than the ones kept in the buffers cannot be captured. */
+    double trigger_pre_duration{ 0.0 };
+    /** The duration in seconds of the window captured after a trigger, see robometry::BufferManager::trigger. */
+    double trigger_post_duration{ 0.0 };
+    /** The budget in bytes of the samples and timestamps kept in memory by the numeric channels, 0 for no budget.
+     * If greater than 0, the capacity of the numeric channels and of the clock groups is computed from the budget instead of
+     * n_samples, in proportion to the rate at which they store the samples, so that all of them hold about the same time span.
+     * The capacities are rebalanced at each save, see robometry::BufferManager::rebalanceMemory, and until the first rates are
+     * observed the budget is split evenly in time, assuming 8 bytes per element for the channels not pushed yet.
+     * The lock-free channels keep their capacity once pushed, and their bytes are subtracted from the budget.
+     * The channels of the other types keep n_samples samples, and they are not accounted. */
+    size_t memory_budget{ 0 };
+    /** The fraction of the capacity of a channel with robometry::OverflowPolicy::Flush that triggers a save in background.
+     * The save is done by the thread of the periodic save, that is started if needed, and it calls the save callback with
+     * robometry::SaveCallbackSaveMethod::flush. */
+    double flush_watermark{ 0.75 };
+    /** If greater than 0, the periodic save thread wakes up as soon as a channel is filled up to this fraction of its capacity,
+     * and save_period becomes the longest interval between two saves. When the period ends, the save is skipped if no channel
+     * has at least data_threshold samples, and at least one. The channels with robometry::OverflowPolicy::Flush use flush_watermark instead. */
+    double save_watermark{ 0.0 };
+    /** If true, the period of the periodic save is stretched when the saves take longer than save_period, so that the
+     * deadlines are not missed. The period becomes 25% longer than the duration of the saves, and it goes back to save_period
+     * gradually as they get faster, see robometry::BufferManager::getSaveCounters. */
+    bool adaptive_save_period{ false };
 };
 
 } // robometry
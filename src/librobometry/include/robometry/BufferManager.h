@@ -10,8 +10,16 @@
 #define ROBOMETRY_BUFFER_MANAGER_H
 
 #include <initializer_list>
+#include <robometry/BinaryLog.h>
 #include <robometry/Buffer.h>
 #include <robometry/BufferConfig.h>
+#include <robometry/ContiguousBuffer.h>
+#include <robometry/Deadband.h>
+#include <robometry/Decimator.h>
+#include <robometry/EmergencyDump.h>
+#include <robometry/FlightRecorder.h>
+#include <robometry/Statistics.h>
+#include <robometry/ThreadPool.h>
 #include <robometry/TreeNode.h>
 
 #include <boost/core/demangle.hpp>
@@ -30,8 +38,12 @@
 #include <mutex>
 #include <condition_variable>
 #include <iomanip>
+#include <limits>
+#include <cmath>
+#include <utility>
 #include <stdexcept>
 #include <typeinfo>
+#include <typeindex>
 
 #ifndef ROBOMETRY_UNUSED
 #  define ROBOMETRY_UNUSED(x) (void)x;
@@ -86,7 +98,38 @@ struct matioCppCanConcatenate<T,
                                                          std::is_same_v<T, matioCpp::MultiDimensionalArray<typename T::value_type>>)>>
         : std::true_type {};
 
+// canUseContiguousBuffer<T>::value is true when the samples of type T can be stored byte-wise in a robometry::ContiguousBuffer,
+// i.e. when T is concatenated as a numeric matioCpp variable and it is either an arithmetic scalar or a type
+// from which we can obtain a span of the same arithmetic elements (e.g. std::vector<double>).
+template <typename T, typename = void>
+struct canUseContiguousBuffer : std::false_type {};
 
+template<typename T>
+struct canUseContiguousBuffer<T,
+                              typename std::enable_if_t<matioCppCanConcatenate<typename matioCpp::make_variable_output<T>::type>::value>>
+{
+private:
+    using elementType = typename matioCpp::make_variable_output<T>::type::value_type;
+
+    static constexpr bool isSpannable()
+    {
+        if constexpr (matioCpp::SpanUtils::is_make_span_callable<const T&>::value)
+        {
+            using spanElementType = typename decltype(matioCpp::make_span(std::declval<const T&>()))::element_type;
+            return std::is_same_v<std::remove_cv_t<spanElementType>, elementType>;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+public:
+    static constexpr bool value = std::is_arithmetic_v<elementType> && (std::is_same_v<T, elementType> || isSpannable());
+};
+
+
+struct FrameInfo;
 
 /**
 * @brief Class that aggregates the robometry::Buffer and some other
@@ -94,20 +137,393 @@ struct matioCppCanConcatenate<T,
 *
 */
 struct BufferInfo {
+    /**
+     * @brief The samples detached from the channel when it is saved, see robometry::BufferInfo::detach.
+     */
+    struct DetachedSamples {
+        size_t size{ 0 };
+        Buffer records;
+        ContiguousBuffer::DetachedSamples chunks;
+    };
+
     inline static std::string type_name_not_set_tag = "type_name_not_set";
     Buffer m_buffer;
+    Buffer m_spare_buffer; // Recycled storage that replaces m_buffer when the channel is detached
+    ContiguousBuffer m_contiguous_buffer; // Used in place of m_buffer when the channel stores numeric data
+    bool m_use_contiguous_buffer{false};
+    std::atomic<bool> m_lock_free_ready{false}; // True when the producer can push to m_contiguous_buffer without locking m_buff_mutex
+    std::atomic<size_t> m_overwritten_records{0}; // Number of samples overwritten in m_buffer
+    std::atomic<size_t> m_dropped_records{0}; // Number of samples dropped because m_buffer was full
+    OverflowPolicy m_overflow_policy{OverflowPolicy::OverwriteOldest};
+    double m_watermark{1.0}; // The fill fraction at which the channel requests a save
+    std::function<void()> m_request_save; // Wakes up the save thread, empty if the channel does not request saves
     std::mutex m_buff_mutex;
+    FrameInfo* m_frame{nullptr}; // The frame the channel belongs to, if any
+    size_t m_frame_index{0}; // The position of the channel in m_frame
     dimensions_t m_dimensions;
     size_t m_dimensions_factorial{0};
     std::string m_type_name{type_name_not_set_tag};
+    std::type_index m_type_index{typeid(void)}; // The type pushed in the channel, typeid(void) until the first push
+    std::string m_element_type; // The type of the elements stored in the ContiguousBuffer, see robometry::binaryLogElementType
     elements_names_t m_elements_names;
-    std::function<matioCpp::Variable(const std::string&)> m_convert_to_matioCpp;
+    std::function<matioCpp::Variable(const std::string&, const DetachedSamples&)> m_convert_to_matioCpp;
     units_of_measure_t m_units_of_measure;
+    std::string m_name; // The full name of the channel
+    std::string m_flight_recorder_file; // The file of the flight recorder ring, empty if the flight recorder is disabled
+    FlightRecorderRing m_flight_recorder; // Copy of the samples of m_contiguous_buffer that survives a crash
+    EmergencyDump* m_emergency_dump{nullptr}; // The dump the channel is registered to at the first push, if enabled
+    ChannelCodec m_codec{ChannelCodec::None}; // The codec compressing the channel in the binary log
+    double m_sampling_period{0.0}; // The nominal sampling period of the stored samples, 0 if it has to be estimated
+    Decimator m_decimator; // Selects the pushed samples that are stored
+    Deadband m_deadband; // Drops the decimated samples that did not change
+    std::atomic<bool> m_keep_next_sample{false}; // Set when the samples are detached, so that each file has a sample of an on-change channel
+    std::unique_ptr<OnlineStatistics> m_statistics; // The statistics of the pushed samples, nullptr if disabled
+    size_t m_stored_samples{0}; // The numeric samples stored since the last rebalance of the memory budget
+    double m_store_rate{0.0}; // The smoothed rate of the stored samples in samples per second, 0 until it is observed
+    double m_retention{0.0}; // The duration in seconds of the samples kept by a numeric channel, 0 if limited by the capacity only
+    double m_rate_start_time{std::numeric_limits<double>::quiet_NaN()}; // The time m_stored_samples is counted from by the retention, NaN until the first save
 
     BufferInfo() = default;
-    BufferInfo(const BufferInfo& other) = default;
 
-    BufferInfo(BufferInfo&& other) = default;
+    /**
+     * @brief Get the mutex protecting the channel, i.e. the one of its frame if the channel belongs to a frame.
+     */
+    std::mutex& mutex();
+
+    /**
+     * @brief Get the description of the numeric channel, available after the first push.
+     */
+    BinaryLogChannelSchema schema() const;
+
+    /**
+     * @brief Create the flight recorder ring of the channel, if enabled. It is called when the first sample is pushed.
+     */
+    void openFlightRecorder();
+
+    /**
+     * @brief Register the channel to the emergency dump, if enabled. It is called when the first sample is pushed.
+     */
+    void registerEmergencyDump();
+
+    /**
+     * @brief Get the number of samples stored in the channel.
+     */
+    size_t size() const
+    {
+        return m_use_contiguous_buffer ? m_contiguous_buffer.size() : m_buffer.size();
+    }
+
+    /**
+     * @brief Return true if the channel does not contain samples, false otherwise.
+     */
+    bool empty() const
+    {
+        return m_use_contiguous_buffer ? m_contiguous_buffer.empty() : m_buffer.empty();
+    }
+
+    /**
+     * @brief Detach the samples stored in the channel, so that they can be converted without blocking the producer.
+     * The storage of the detached samples is replaced without copying it, and it is recycled
+     * once the samples are given back with robometry::BufferInfo::recycle.
+     * It has to be called with the mutex of the channel locked.
+     *
+     * @return The detached samples.
+     */
+    DetachedSamples detach()
+    {
+        DetachedSamples detached;
+        detached.size = size();
+        if (m_use_contiguous_buffer)
+        {
+            detached.chunks = m_contiguous_buffer.detach(detached.size);
+            if (m_deadband.enabled() && detached.size > 0)
+            {
+                m_keep_next_sample.store(true, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            if (m_spare_buffer.getBufferSharedPtr() == nullptr)
+            {
+                m_spare_buffer = Buffer(m_buffer.capacity());
+            }
+            detached.records = std::move(m_buffer);
+            m_buffer = std::move(m_spare_buffer);
+        }
+        return detached;
+    }
+
+    /**
+     * @brief Give back the storage of samples previously detached, so that it can be reused.
+     * It locks m_buff_mutex.
+     *
+     * @param[in] detached The detached samples.
+     */
+    void recycle(DetachedSamples&& detached)
+    {
+        // The chunks of the ContiguousBuffer return to their pool when destroyed
+        detached.chunks = ContiguousBuffer::DetachedSamples();
+        if (detached.records.getBufferSharedPtr() == nullptr)
+        {
+            return;
+        }
+        detached.records.clear();
+
+        std::scoped_lock<std::mutex> lock{ m_buff_mutex };
+        if (m_spare_buffer.getBufferSharedPtr() == nullptr && detached.records.capacity() == m_buffer.capacity())
+        {
+            m_spare_buffer = std::move(detached.records);
+        }
+    }
+
+    /**
+     * @brief Get the number of samples overwritten because the channel was full.
+     */
+    size_t overwrittenSamples() const
+    {
+        return m_overwritten_records.load(std::memory_order_relaxed) + m_contiguous_buffer.overwrittenSamples();
+    }
+
+    /**
+     * @brief Get the number of samples dropped because the channel was full.
+     */
+    size_t droppedSamples() const
+    {
+        return m_dropped_records.load(std::memory_order_relaxed) + m_contiguous_buffer.droppedSamples();
+    }
+
+    /**
+     * @brief Clear the samples stored in the channel.
+     */
+    void clear()
+    {
+        m_use_contiguous_buffer ? m_contiguous_buffer.clear() : m_buffer.clear();
+    }
+
+    /**
+     * @brief Resize the storage of the channel.
+     *
+     * @param[in] new_size The new size to be resized to.
+     */
+    void resize(size_t new_size)
+    {
+        // Until the first push the type of the channel is not known, hence both the storages are kept in sync
+        if (!m_use_contiguous_buffer)
+        {
+            m_buffer.resize(new_size);
+        }
+        m_spare_buffer = Buffer();
+        m_contiguous_buffer.resize(new_size);
+    }
+
+    /**
+     * @brief Change the capacity of the storage of the channel.
+     *
+     * @param[in] new_size The new capacity.
+     */
+    void set_capacity(size_t new_size)
+    {
+        if (!m_use_contiguous_buffer)
+        {
+            m_buffer.set_capacity(new_size);
+        }
+        m_spare_buffer = Buffer();
+        m_contiguous_buffer.set_capacity(new_size);
+    }
+
+    /**
+     * @brief Store a new sample in the channel. The storage is selected at compile time according to T.
+     *
+     * @param[in] elem The element to be pushed.
+     * @param[in] ts The timestamp of the element.
+     */
+    template<typename T>
+    void push_back(const T& elem, double ts)
+    {
+        if constexpr (canUseContiguousBuffer<T>::value)
+        {
+            if constexpr (std::is_arithmetic_v<T>)
+            {
+                pushSample(&elem, 1, ts);
+            }
+            else
+            {
+                auto span = matioCpp::make_span(elem);
+                pushSample(span.data(), static_cast<size_t>(span.size()), ts);
+            }
+        }
+        else
+        {
+            if (m_decimator.enabled() && !m_decimator.keep())
+            {
+                return;
+            }
+            if (m_buffer.full())
+            {
+                if (m_overflow_policy == OverflowPolicy::DropNewest)
+                {
+                    m_dropped_records.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                m_overwritten_records.fetch_add(1, std::memory_order_relaxed);
+            }
+            m_buffer.push_back({ts, elem});
+            checkWatermark();
+        }
+    }
+
+    /**
+     * @brief Store a numeric sample in the ContiguousBuffer, after the decimation and the deadband.
+     * The statistics are computed on all the pushed samples.
+     *
+     * @param[in] elements Pointer to the elements of the sample.
+     * @param[in] num_elements The number of elements of the sample.
+     * @param[in] ts The timestamp of the sample.
+     */
+    template<typename E>
+    void pushSample(const E* elements, size_t num_elements, double ts)
+    {
+        if (m_statistics)
+        {
+            m_statistics->update(elements, num_elements);
+        }
+        const void* sample = elements;
+        if (m_decimator.enabled())
+        {
+            sample = m_decimator.process(elements, num_elements);
+            if (sample == nullptr)
+            {
+                return;
+            }
+        }
+        if (m_deadband.enabled())
+        {
+            // After a detach the first sample is stored even if it did not change, so that each file can be reconstructed alone
+            const bool changed = m_deadband.process<E>(sample, num_elements);
+            if (!changed && !m_keep_next_sample.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            // Reset before storing the sample, so that a detach happening meanwhile requests the next one
+            if (m_keep_next_sample.load(std::memory_order_relaxed))
+            {
+                m_keep_next_sample.store(false, std::memory_order_relaxed);
+            }
+        }
+        if (m_retention > 0.0)
+        {
+            evict(ts);
+        }
+        const bool stored = m_contiguous_buffer.push_back(sample, num_elements * sizeof(E), ts);
+        ++m_stored_samples;
+        checkWatermark();
+        // The samples dropped because the channel is full are not recorded, so that the ring matches the channel
+        if (stored && m_flight_recorder.isOpen())
+        {
+            m_flight_recorder.push_back(sample, num_elements * sizeof(E), ts);
+        }
+    }
+
+    /**
+     * @brief Request a save in background if the channel is filled up to its watermark, see robometry::OverflowPolicy::Flush
+     * and robometry::BufferConfig::save_watermark.
+     */
+    void checkWatermark()
+    {
+        if (m_request_save)
+        {
+            const size_t capacity = m_use_contiguous_buffer ? m_contiguous_buffer.capacity() : m_buffer.capacity();
+            if (static_cast<double>(size()) >= m_watermark * static_cast<double>(capacity))
+            {
+                m_request_save();
+            }
+        }
+    }
+
+    /**
+     * @brief Remove the numeric samples older than the retention with respect to a new sample.
+     * The capacity is not changed, if the samples to be kept fill the channel the overflow policy applies.
+     *
+     * @param[in] ts The timestamp of the new sample.
+     */
+    void evict(double ts)
+    {
+        const size_t old_samples = m_contiguous_buffer.countOlderThan(ts - m_retention);
+        if (old_samples > 0)
+        {
+            m_contiguous_buffer.pop_front(old_samples);
+        }
+    }
+
+    /**
+     * @brief Adapt the capacity of a retention channel without a nominal rate to the rate of the samples stored
+     * since the previous call, so that it holds the samples of the retention plus 25%.
+     * It is called after detaching the samples, with the mutex of the channel locked, so that no sample is copied.
+     *
+     * @param[in] now The current time.
+     * @param[in] max_samples The maximum capacity.
+     */
+    void adaptRetentionCapacity(double now, size_t max_samples)
+    {
+        if (m_retention <= 0.0 || m_sampling_period > 0.0 || !m_use_contiguous_buffer || m_stored_samples == 0)
+        {
+            return;
+        }
+        // The rate is measured on the samples stored since the previous save, and smoothed with the previous one
+        const double elapsed = now - m_rate_start_time;
+        const size_t stored = std::exchange(m_stored_samples, 0);
+        m_rate_start_time = now;
+        if (!(elapsed > 0.0))
+        {
+            return;
+        }
+        const double rate = static_cast<double>(stored) / elapsed;
+        m_store_rate = m_store_rate > 0.0 ? 0.5 * (m_store_rate + rate) : rate;
+        const double samples = std::ceil(1.25 * m_retention * m_store_rate);
+        const size_t capacity = std::max<size_t>(samples < static_cast<double>(max_samples) ? static_cast<size_t>(samples) : max_samples, 1);
+        // Small changes are skipped, since the storage is reallocated
+        const size_t current = m_contiguous_buffer.capacity();
+        const size_t difference = capacity > current ? capacity - current : current - capacity;
+        if (difference * 10 > current)
+        {
+            set_capacity(capacity);
+        }
+    }
+
+    /**
+     * @brief Store many samples in the channel.
+     * The scalar samples of a numeric channel are copied in bulk, the others are pushed one by one.
+     *
+     * @param[in] elems Pointer to the elements to be pushed.
+     * @param[in] timestamps Pointer to the timestamps of the elements.
+     * @param[in] num_samples The number of elements to be pushed.
+     */
+    template<typename T>
+    void push_back_batch(const T* elems, const double* timestamps, size_t num_samples)
+    {
+        if constexpr (canUseContiguousBuffer<T>::value && std::is_arithmetic_v<T>)
+        {
+            if (m_contiguous_buffer.sampleSize() == sizeof(T) && !m_decimator.enabled() && !m_deadband.enabled() && !m_statistics &&
+                m_retention <= 0.0)
+            {
+                const size_t stored = m_contiguous_buffer.push_back(elems, timestamps, num_samples);
+                m_stored_samples += num_samples;
+                checkWatermark();
+                if (stored > 0 && m_flight_recorder.isOpen())
+                {
+                    // The dropped samples are the newest ones, while when overwriting the stored ones are the newest
+                    const size_t skipped = m_contiguous_buffer.dropWhenFull() ? 0 : num_samples - stored;
+                    m_flight_recorder.push_back(elems + skipped, timestamps + skipped, stored);
+                }
+                return;
+            }
+        }
+
+        for (size_t i = 0; i < num_samples; ++i)
+        {
+            push_back(elems[i], timestamps[i]);
+        }
+    }
 
     // This method fills the m_convert_to_matioCpp lambda with a function able to convert the Buffer
     // into a matioCpp variable. This method is called when pushing the first time to a channel,
@@ -130,15 +546,60 @@ struct BufferInfo {
         // The matioCpp::make_variable_output metafunction provides the type that would be output by matioCpp::make_variable
         using matioCppType = typename matioCpp::make_variable_output<T>::type;
 
-        // Start filling the m_convert_to_matioCpp lambda. The lambda will take as input the desired name and will output a matioCpp::Variable.
-        m_convert_to_matioCpp = [this](const std::string& name)
+        // Numeric data is copied in a flat preallocated array, the Buffer of Records is not needed anymore
+        if constexpr (canUseContiguousBuffer<T>::value)
+        {
+            m_use_contiguous_buffer = true;
+            m_element_type = binaryLogElementType<typename matioCppType::value_type>();
+            if (m_decimator.filter() && !std::is_floating_point_v<typename matioCppType::value_type>)
+            {
+                std::cout << "The channel " << m_name << " does not contain floating point data, "
+                          << "its samples are decimated without filtering them." << std::endl;
+            }
+            m_contiguous_buffer.initialize(sizeof(typename matioCppType::value_type) * m_dimensions_factorial);
+            m_buffer.set_capacity(0);
+            m_spare_buffer = Buffer();
+            openFlightRecorder();
+            registerEmergencyDump();
+            m_lock_free_ready = m_contiguous_buffer.lockFree();
+        }
+        else
         {
-            size_t num_instants = this->m_buffer.size();
+            if (m_deadband.enabled())
+            {
+                std::cout << "The channel " << m_name << " does not contain numeric data, all its samples are stored." << std::endl;
+            }
+            if (m_statistics)
+            {
+                std::cout << "The channel " << m_name << " does not contain numeric data, its statistics are not computed." << std::endl;
+            }
+        }
+
+        // Start filling the m_convert_to_matioCpp lambda. The lambda will take as input the desired name and the samples
+        // detached from the channel, and will output a matioCpp::Variable.
+        m_convert_to_matioCpp = [this](const std::string& name, const DetachedSamples& samples)
+        {
+            size_t num_instants = samples.size;
+
+            //---
+            //CONTIGUOUS CASE
+            //if the data is stored in the ContiguousBuffer, it is already laid out as the output variable, so we copy it in bulk
+            if constexpr (canUseContiguousBuffer<T>::value)
+            {
+                using elementType = typename matioCppType::value_type;
+
+                dimensions_t fullDimensions = this->m_dimensions;
+                fullDimensions.push_back(num_instants);
+
+                matioCpp::MultiDimensionalArray<elementType> outputVariable(name, fullDimensions);
+                samples.chunks.copyData(outputVariable.toSpan().data());
+                return outputVariable;
+            }
 
             //---
             //SCALAR CASE
             //if the input data is numeric (scalar, vector, multi-dimensional array), then we concatenate on the last dimension
-            if constexpr (matioCppCanConcatenate<matioCppType>::value)
+            else if constexpr (matioCppCanConcatenate<matioCppType>::value)
             {
                 //the scalar types in matioCpp have the member T::value_type, that is the type of each single element.
                 using elementType = typename matioCppType::value_type;
@@ -150,7 +611,7 @@ struct BufferInfo {
                 matioCpp::MultiDimensionalArray<elementType> outputVariable(name, fullDimensions);
 
                 size_t t = 0;
-                for (auto& _cell : this->m_buffer) {
+                for (auto& _cell : samples.records) {
                     //We convert std::any type using the input type T.
                     const T& cellCasted = std::any_cast<T>(_cell.m_datum);
 
@@ -195,7 +656,7 @@ struct BufferInfo {
                 matioCpp::StructArray outputVariable(name, {1,num_instants});
 
                 size_t i = 0;
-                for (auto& _cell : this->m_buffer) {
+                for (auto& _cell : samples.records) {
                     matioCpp::Struct element = matioCpp::make_variable("element", std::any_cast<T>(_cell.m_datum));
 
                     if (i == 0)
@@ -216,17 +677,248 @@ struct BufferInfo {
                 //The output variable would be a cell array of dimensions t.
                 matioCpp::CellArray outputVariable(name, {1,num_instants});
 
-                size_t i = 0;
-                for (auto& _cell : this->m_buffer) {
-                    outputVariable.setElement(i, matioCpp::make_variable("element", std::any_cast<T>(_cell.m_datum)));
-                    ++i;
-                }
-                return outputVariable;
-            }
-        };
+                size_t i = 0;
+                for (auto& _cell : samples.records) {
+                    outputVariable.setElement(i, matioCpp::make_variable("element", std::any_cast<T>(_cell.m_datum)));
+                    ++i;
+                }
+                return outputVariable;
+            }
+        };
+    }
+
+
+};
+
+/**
+ * @brief A lightweight handle to a channel of a robometry::BufferManager.
+ * It points directly to the robometry::BufferInfo of the channel, so that pushing through
+ * it does not require to look up the channel name in the tree.
+ * It can be obtained with robometry::BufferManager::getChannelHandle.
+ *
+ */
+class ChannelHandle {
+public:
+    /**
+     * @brief Construct an invalid ChannelHandle.
+     */
+    ChannelHandle() = default;
+
+    /**
+     * @brief Return true if the handle refers to a channel, false otherwise.
+     */
+    bool isValid() const
+    {
+        return m_buffer_info != nullptr;
+    }
+
+    /**
+     * @brief Get the name of the channel referred by the handle.
+     *
+     * @return The full name of the channel, empty if the handle is not valid.
+     */
+    const std::string& name() const
+    {
+        return m_name;
+    }
+
+private:
+    friend class BufferManager;
+    friend class FrameHandle;
+
+    ChannelHandle(std::shared_ptr<BufferInfo> buffer_info, const std::string& name) :
+            m_buffer_info(std::move(buffer_info)),
+            m_name(name)
+    {
+    }
+
+    std::shared_ptr<BufferInfo> m_buffer_info;
+    std::string m_name;
+};
+
+/**
+ * @brief Class that aggregates the channels of a frame, i.e. channels that are pushed all together
+ * with the same timestamp by the robometry::BufferManager.
+ * The timestamps are stored once for all the channels, and a single mutex protects all of them.
+ *
+ */
+struct FrameInfo {
+    /**
+     * @brief A sample set for the next push of the frame, see robometry::FrameHandle::set.
+     */
+    struct StagedSample {
+        const void* elem{ nullptr };
+        std::type_index type{ typeid(void) };
+        void (*push)(BufferInfo&, const void*){ nullptr };
+        std::string (*type_name)(){ nullptr };
+    };
+
+    std::string m_name;
+    std::mutex m_mutex;
+    ContiguousBuffer m_timestamps; // The timestamps are stored as the samples of the buffer
+    std::vector<std::shared_ptr<BufferInfo>> m_channels;
+    std::vector<std::string> m_channel_names;
+    std::vector<StagedSample> m_staged; // One for each channel
+    std::string m_flight_recorder_file; // The file of the flight recorder ring of the timestamps, empty if disabled
+    FlightRecorderRing m_flight_recorder;
+    EmergencyDump::Entry* m_emergency_dump_entry{ nullptr }; // The entry of the timestamps in the emergency dump, if enabled
+};
+
+inline std::mutex& BufferInfo::mutex()
+{
+    return m_frame != nullptr ? m_frame->m_mutex : m_buff_mutex;
+}
+
+inline BinaryLogChannelSchema BufferInfo::schema() const
+{
+    BinaryLogChannelSchema schema;
+    schema.name = m_name;
+    schema.dimensions = m_dimensions;
+    schema.elements_names = m_elements_names;
+    schema.units_of_measure = m_units_of_measure;
+    schema.element_type = m_element_type;
+    schema.sample_size = m_contiguous_buffer.sampleSize();
+    schema.clock_group = m_frame != nullptr ? m_frame->m_name : "";
+    schema.codec = m_codec;
+    return schema;
+}
+
+inline void BufferInfo::openFlightRecorder()
+{
+    if (m_flight_recorder_file.empty())
+    {
+        return;
+    }
+    m_flight_recorder.open(m_flight_recorder_file, FlightRecorderRing::Kind::Channel, schema(), m_contiguous_buffer.capacity());
+}
+
+inline void BufferInfo::registerEmergencyDump()
+{
+    if (m_emergency_dump == nullptr)
+    {
+        return;
+    }
+    m_emergency_dump->addChannel(schema(), m_contiguous_buffer, m_frame != nullptr ? m_frame->m_emergency_dump_entry : nullptr);
+}
+
+/**
+ * @brief A handle to a frame of a robometry::BufferManager.
+ * The samples of the channels of the frame are set with robometry::FrameHandle::set,
+ * and then they are pushed all together with robometry::BufferManager::push_back.
+ * It can be obtained with robometry::BufferManager::getFrameHandle.
+ *
+ */
+class FrameHandle {
+public:
+    /**
+     * @brief Construct an invalid FrameHandle.
+     */
+    FrameHandle() = default;
+
+    /**
+     * @brief Return true if the handle refers to a frame, false otherwise.
+     */
+    bool isValid() const
+    {
+        return m_frame_info != nullptr;
+    }
+
+    /**
+     * @brief Get the name of the frame referred by the handle.
+     *
+     * @return The name of the frame, empty if the handle is not valid.
+     */
+    const std::string& name() const
+    {
+        return m_name;
+    }
+
+    /**
+     * @brief Set the sample of a channel for the next push of the frame.
+     * The sample is not copied, hence elem has to be valid until the frame is pushed, and it cannot be a temporary.
+     * Only numeric data can be stored in a frame. The samples are staged under the mutex of the frame, however
+     * they are meant to be set and pushed by the same thread, since a push consumes the samples set by any thread.
+     *
+     * @param[in] channel The handle to the channel, it has to belong to the frame.
+     * @param[in] elem The element to be pushed in the channel.
+     * @return true on success, false if the channel does not belong to the frame.
+     */
+    template<typename T>
+    bool set(const ChannelHandle& channel, const T& elem)
+    {
+        static_assert(canUseContiguousBuffer<T>::value, "Only numeric data can be pushed in a frame.");
+
+        if (!isValid() || !channel.isValid() || channel.m_buffer_info->m_frame != m_frame_info.get())
+        {
+            std::cout << "The channel " << channel.name() << " does not belong to the frame " << m_name << "." << std::endl;
+            return false;
+        }
+
+        std::scoped_lock<std::mutex> lock{ m_frame_info->m_mutex };
+        auto& staged = m_frame_info->m_staged[channel.m_buffer_info->m_frame_index];
+        staged.elem = &elem;
+        staged.type = typeid(T);
+        staged.push = &pushStaged<T>;
+        staged.type_name = &getTypeName<T>;
+        return true;
+    }
+
+    /**
+     * @brief A temporary would be destroyed before the frame is pushed, hence it cannot be set.
+     */
+    template<typename T>
+    bool set(const ChannelHandle& channel, const T&& elem) = delete;
+
+private:
+    friend class BufferManager;
+
+    FrameHandle(std::shared_ptr<FrameInfo> frame_info, const std::string& name) :
+            m_frame_info(std::move(frame_info)),
+            m_name(name)
+    {
+    }
+
+    template<typename T>
+    static void pushStaged(BufferInfo& bufferInfo, const void* elem)
+    {
+        if (bufferInfo.m_type_index == typeid(void))
+        {
+            bufferInfo.m_type_index = typeid(T);
+            bufferInfo.m_type_name = getTypeName<T>();
+        }
+        bufferInfo.template createMatioCppConvertFunction<T>();
+
+        // The timestamp is stored by the frame
+        bufferInfo.push_back(*static_cast<const T*>(elem), 0.0);
     }
 
+    std::shared_ptr<FrameInfo> m_frame_info;
+    std::string m_name;
+};
+
+/**
+ * @brief Struct containing the counters of the samples lost by a channel because it was full.
+ *
+ */
+struct ChannelCounters {
+    size_t overwritten{ 0 }; /**< Number of samples overwritten by newer ones */
+    size_t dropped{ 0 }; /**< Number of new samples dropped, by the lock-free channels and by the ones with robometry::OverflowPolicy::DropNewest */
+};
 
+/**
+ * @brief Struct containing the counters of the periodic save thread, see robometry::BufferManager::getSaveCounters.
+ * The saves start at the deadlines of a fixed-rate schedule, or earlier if requested by a watermark. The durations include
+ * the save callback, and the lag is the delay of the start of a save after its deadline.
+ *
+ */
+struct SaveCounters {
+    size_t saves{ 0 }; /**< Number of saves done by the thread, including the ones requested by the watermarks */
+    size_t missed_deadlines{ 0 }; /**< Number of deadlines skipped since a later one had already expired, the late deadline that is served counts in the lag */
+    double period{ 0.0 }; /**< The current period in seconds, longer than robometry::BufferConfig::save_period if it has been stretched */
+    double last_duration{ 0.0 }; /**< Duration in seconds of the last save */
+    double max_duration{ 0.0 }; /**< Longest duration in seconds of a save */
+    double last_lag{ 0.0 }; /**< Lag in seconds of the last save started at a deadline */
+    double max_lag{ 0.0 }; /**< Longest lag in seconds of a save started at a deadline */
 };
 
 /**
@@ -235,7 +927,7 @@ struct BufferInfo {
  *
  */
 enum class SaveCallbackSaveMethod {
-    periodic, last_call
+    periodic, last_call, trigger, flush
 };
 
 /**
@@ -275,7 +967,8 @@ public:
     /**
      * @brief Enable the save thread with _save_period seconds of period.
      * If the thread has been started yet in the configuration through
-     * BufferConfing, it skips it.
+     * BufferConfing, it skips it. If it has been started only for the flushes of the channels
+     * (see robometry::OverflowPolicy::Flush), it starts saving periodically as well.
      *
      * @param[in] _save_period The period in seconds of the save thread.
      * @return true on success, false otherwise.
@@ -296,6 +989,64 @@ public:
      * @return The BufferConfig object.
      */
     BufferConfig getBufferConfig() const;
+
+    /**
+     * @brief Get the directory of the flight recorder session, see robometry::BufferConfig::flight_recorder_path.
+     *
+     * @return The directory of the session, empty if the flight recorder is disabled.
+     */
+    std::string getFlightRecorderDirectory() const;
+
+    /**
+     * @brief Get the statistics of the samples pushed to a channel since the beginning, see robometry::ChannelInfo::statistics.
+     * They can be read while the channel is pushed.
+     *
+     * @param[in] var_name The name of the channel.
+     * @param[out] statistics The statistics of the channel.
+     * @return true on success, false if the channel does not exist, it does not compute the statistics or it has not been pushed.
+     */
+    bool getStatistics(const std::string& var_name, ChannelStatistics& statistics) const;
+
+    /**
+     * @brief Capture the samples around an event, see robometry::BufferManager::trigger(const std::string&, double).
+     * The trigger time is given by the now function.
+     *
+     * @param[in] name The name of the event, used in the name of the file.
+     * @return true on success, false otherwise.
+     */
+    bool trigger(const std::string& name);
+
+    /**
+     * @brief Capture the samples of the numeric channels with timestamps from trigger_time - trigger_pre_duration
+     * to trigger_time + trigger_post_duration (see robometry::BufferConfig). The samples before the trigger are copied
+     * immediately, the following ones as they are pushed, without affecting the buffers and the usual saves.
+     * The lock-free channels (see robometry::ChannelInfo::lock_free) are excluded from the copies made while pushing,
+     * since their producers never lock: their samples are collected at the end of the window and before each save,
+     * and they are not lost meanwhile because the full lock-free channels drop the new samples.
+     * The samples detached by the saves are kept for trigger_pre_duration, so that they can be captured by the following triggers.
+     * Once the now function reaches the end of the window, the capture is written in background to the file
+     * `<filename>_<index>_<name>.mat` in the path of the configuration, with the same layout of robometry::BufferManager::saveToFile,
+     * and the save callback is called with robometry::SaveCallbackSaveMethod::trigger.
+     * The captures still pending when the robometry::BufferManager is destroyed are written with the samples collected so far.
+     *
+     * @param[in] name The name of the event, used in the name of the file.
+     * @param[in] trigger_time The time of the event.
+     * @return true on success, false otherwise.
+     */
+    bool trigger(const std::string& name, double trigger_time);
+
+    /**
+     * @brief Get the number of captures that have not been written yet, see robometry::BufferManager::trigger.
+     */
+    size_t pendingCaptures() const;
+
+    /**
+     * @brief Write the emergency dump, as done when a fatal signal is received, see robometry::BufferConfig::emergency_dump_path.
+     * The dump is written only once, it is kept on disk and it can be converted with robometry::binaryLogToMat.
+     *
+     * @return true on success, false if the dump is disabled, already written or an error occurred.
+     */
+    bool emergencyDump();
     /**
      * @brief Set the file name that will be created by the BufferManager.
      *
@@ -350,6 +1101,8 @@ public:
     /**
      * @brief Add a list of channels(variables) to the BufferManager.
      * The channels have to be unique in the BufferManager.
+     * The channels with the same robometry::ChannelInfo::clock_group are added to a frame
+     * named after the clock group, see robometry::BufferManager::addFrame.
      *
      * @param[in] channels List of pair representing the channels to be added.
      * @return true on success, false otherwise.
@@ -429,42 +1182,296 @@ public:
         auto bufferInfo = leaf->getValue();
         assert(bufferInfo != nullptr);
 
-        bool typename_set = bufferInfo->m_type_name != BufferInfo::type_name_not_set_tag;
+        pushToChannel(*bufferInfo, elem, ts, var_name);
+    }
+
+    /**
+     * @brief Push a new element in the var_name channel.
+     * The var_name channels must exist, otherwise an exception is thrown.
+     *
+     * @param[in] elem The element to be pushed in the channel.
+     * @param[in] var_name The name of the channel.
+     */
+    template<typename T, typename = std::enable_if_t<!std::is_same_v<T, ChannelHandle>>>
+    inline void push_back(const T& elem, const std::string& var_name)
+    {
+        push_back(elem, m_nowFunction(), var_name);
+    }
+
+    /**
+     * @brief Push many elements in the var_name channel at once.
+     * The channel is looked up and locked only once for the whole batch.
+     * The var_name channels must exist, otherwise an exception is thrown.
+     *
+     * @param[in] var_name The name of the channel.
+     * @param[in] elems The elements to be pushed(via copy) in the channel, from the oldest to the newest.
+     * @param[in] timestamps The timestamps of the elements, it must have the same size of elems.
+     */
+    template<typename T>
+    inline void push_back_batch(const std::string& var_name, matioCpp::Span<const T> elems, matioCpp::Span<const double> timestamps)
+    {
+        auto leaf = getLeaf(var_name, m_tree).lock();
+        if (leaf == nullptr)
+        {
+            throw std::invalid_argument("The channel " + var_name + " does not exist.");
+        }
+        auto bufferInfo = leaf->getValue();
+        assert(bufferInfo != nullptr);
 
-        if (typename_set && (bufferInfo->m_type_name != getTypeName<T>()))
+        if (elems.size() != timestamps.size())
         {
             std::cout << "Cannot push to the channel " << var_name
-                      << ". Expected type: " << bufferInfo->m_type_name
-                      << ". Input type: " << getTypeName<T>() <<std::endl;
+                      << ". The number of elements (" << elems.size()
+                      << ") is different from the number of timestamps (" << timestamps.size() << ")." << std::endl;
             return;
         }
 
-        std::scoped_lock<std::mutex> lock{ bufferInfo->m_buff_mutex };
+        pushBatchToChannel(*bufferInfo, elems.data(), timestamps.data(), static_cast<size_t>(elems.size()), var_name);
+    }
+
+    /**
+     * @brief Push many elements in the var_name channel at once.
+     * The channel is looked up and locked only once for the whole batch.
+     * The var_name channels must exist, otherwise an exception is thrown.
+     *
+     * @param[in] var_name The name of the channel.
+     * @param[in] elems The elements to be pushed(via copy) in the channel, from the oldest to the newest.
+     * @param[in] timestamps The timestamps of the elements, it must have the same size of elems.
+     */
+    template<typename T>
+    inline void push_back_batch(const std::string& var_name, const std::vector<T>& elems, matioCpp::Span<const double> timestamps)
+    {
+        push_back_batch(var_name, matioCpp::make_span(elems), timestamps);
+    }
+
+    /**
+     * @brief Get a handle to the var_name channel.
+     * Pushing through the handle avoids to look up the channel name at every push.
+     * The handle remains valid for the whole life of the BufferManager.
+     *
+     * @param[in] var_name The name of the channel.
+     * @return The handle to the channel, not valid if the channel does not exist.
+     */
+    ChannelHandle getChannelHandle(const std::string& var_name) const;
+
+    /**
+     * @brief Add a frame to the BufferManager, i.e. a group of channels that are pushed all together
+     * with a single timestamp, locking only once. The timestamps are stored once for the whole frame,
+     * and they are saved once as well, in the field `clock_groups.<frame_name>` of the file. The channels
+     * of the frame do not have the `timestamps` field, but the `clock_group` field containing the frame name.
+     * The channels must exist, they cannot belong to another frame and they must not have been pushed yet.
+     * The channels of a frame cannot be pushed individually.
+     *
+     * @param[in] frame_name The name of the frame, it has to be unique.
+     * @param[in] channel_names The names of the channels of the frame.
+     * @return true on success, false otherwise.
+     */
+    bool addFrame(const std::string& frame_name, const std::vector<std::string>& channel_names);
+
+    /**
+     * @brief Get a handle to the frame_name frame.
+     *
+     * @param[in] frame_name The name of the frame.
+     * @return The handle to the frame, not valid if the frame does not exist.
+     */
+    FrameHandle getFrameHandle(const std::string& frame_name) const;
+
+    /**
+     * @brief Push the samples set in the frame, all with the same timestamp.
+     * The samples of all the channels of the frame must have been set, otherwise nothing is pushed.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] frame The handle to the frame.
+     * @param[in] ts The timestamp of the frame.
+     */
+    void push_back(const FrameHandle& frame, double ts);
+
+    /**
+     * @brief Push the samples set in the frame, all with the same timestamp.
+     * The samples of all the channels of the frame must have been set, otherwise nothing is pushed.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] frame The handle to the frame.
+     */
+    void push_back(const FrameHandle& frame);
+
+    /**
+     * @brief Get the counters of the samples lost by the var_name channel since the beginning.
+     * They are saved in the .mat files as well, in the fields `overwritten_samples` and `dropped_samples` of the channel.
+     * When appending to the file, their value at each save is appended to the variables named by the fields
+     * `overwritten_samples_variable` and `dropped_samples_variable`. The binary log stores them after each block
+     * of the channel, and robometry::binaryLogToMat writes the last ones in the usual fields.
+     *
+     * @param[in] var_name The name of the channel.
+     * @param[out] counters The counters of the channel.
+     * @return true on success, false if the channel does not exist.
+     */
+    bool getChannelCounters(const std::string& var_name, ChannelCounters& counters) const;
+
+    /**
+     * @brief Split robometry::BufferConfig::memory_budget among the numeric channels and the clock groups, according to
+     * the rates at which they stored the samples since the last rebalance. It is called by configure and at each save,
+     * hence the channels and the frames added afterwards get their share of the budget at the next save.
+     * The capacity of a channel changes only if it has to shrink for respecting the budget,
+     * or if it grows by more than 10%, since the storage is reallocated. If a channel holds more samples than its new
+     * capacity, the oldest ones are removed and counted as overwritten, see robometry::BufferManager::getChannelCounters.
+     * The channels with a robometry::ChannelInfo::retention keep their capacity, and their bytes are subtracted from the budget.
+     *
+     * @return true on success, false if the budget is not set.
+     */
+    bool rebalanceMemory();
+
+    /**
+     * @brief Get the bytes of the samples and timestamps that a numeric channel can hold in memory.
+     * The timestamps of the channels of a frame are accounted to the frame, see robometry::BufferManager::getMemoryUsage().
+     *
+     * @param[in] var_name The name of the channel.
+     * @param[out] bytes The capacity in bytes of the channel, 0 if it has not been pushed yet.
+     * @return true on success, false if the channel does not exist or it does not contain numeric data.
+     */
+    bool getMemoryUsage(const std::string& var_name, size_t& bytes) const;
+
+    /**
+     * @brief Get the bytes of the samples and timestamps that all the numeric channels and clock groups can hold in memory.
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * @brief Get the counters of the periodic save thread since it has been started.
+     * If a save is still running when a deadline expires, the following save starts right away for the last expired deadline,
+     * and the deadlines expired before it are skipped and counted as missed, so that the schedule does not drift.
+     */
+    SaveCounters getSaveCounters() const;
+
+    /**
+     * @brief Push a new element in the channel referred by handle.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] handle The handle to the channel.
+     * @param[in] elem The element to be pushed(via copy) in the channel.
+     * @param[in] ts The timestamp of the element to be pushed.
+     */
+    template<typename T>
+    inline void push_back(const ChannelHandle& handle, matioCpp::Span<const T> elem, double ts)
+    {
+        push_back(handle, std::vector<T>(elem.begin(), elem.end()), ts);
+    }
+
+    /**
+     * @brief Push a new element in the channel referred by handle.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] handle The handle to the channel.
+     * @param[in] elem The element to be pushed(via copy) in the channel.
+     * @param[in] ts The timestamp of the element to be pushed.
+     */
+    template<typename T>
+    inline void push_back(const ChannelHandle& handle, const std::initializer_list<T>& elem, double ts)
+    {
+        push_back(handle, std::vector<T>(elem.begin(), elem.end()), ts);
+    }
+
+    /**
+     * @brief Push a new element in the channel referred by handle.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] handle The handle to the channel.
+     * @param[in] elem The element to be pushed(via copy) in the channel.
+     */
+    template<typename T>
+    inline void push_back(const ChannelHandle& handle, matioCpp::Span<const T> elem)
+    {
+        push_back(handle, elem, m_nowFunction());
+    }
+
+    /**
+     * @brief Push a new element in the channel referred by handle.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] handle The handle to the channel.
+     * @param[in] elem The element to be pushed(via copy) in the channel.
+     */
+    template<typename T>
+    inline void push_back(const ChannelHandle& handle, const std::initializer_list<T>& elem)
+    {
+        push_back(handle, elem, m_nowFunction());
+    }
 
-        if (!typename_set)
+    /**
+     * @brief Push a new element in the channel referred by handle.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] handle The handle to the channel.
+     * @param[in] elem The element to be pushed in the channel.
+     * @param[in] ts The timestamp of the element to be pushed.
+     */
+    template<typename T>
+    inline void push_back(const ChannelHandle& handle, const T& elem, double ts)
+    {
+        if (!handle.isValid())
         {
-            bufferInfo->m_type_name = getTypeName<T>();
+            throw std::invalid_argument("The channel handle is not valid.");
         }
 
-        //Create the saving functions if they were not present already
-        bufferInfo->template createMatioCppConvertFunction<T>();
-
-        bufferInfo->m_buffer.push_back({ts, elem});
+        pushToChannel(*handle.m_buffer_info, elem, ts, handle.m_name);
     }
 
     /**
-     * @brief Push a new element in the var_name channel.
-     * The var_name channels must exist, otherwise an exception is thrown.
+     * @brief Push a new element in the channel referred by handle.
+     * The handle must be valid, otherwise an exception is thrown.
      *
+     * @param[in] handle The handle to the channel.
      * @param[in] elem The element to be pushed in the channel.
-     * @param[in] var_name The name of the channel.
      */
     template<typename T>
-    inline void push_back(const T& elem, const std::string& var_name)
+    inline void push_back(const ChannelHandle& handle, const T& elem)
     {
-        push_back(elem, m_nowFunction(), var_name);
+        push_back(handle, elem, m_nowFunction());
+    }
+
+
+    /**
+     * @brief Push many elements in the channel referred by handle at once.
+     * The channel is locked only once for the whole batch.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] handle The handle to the channel.
+     * @param[in] elems The elements to be pushed(via copy) in the channel, from the oldest to the newest.
+     * @param[in] timestamps The timestamps of the elements, it must have the same size of elems.
+     */
+    template<typename T>
+    inline void push_back_batch(const ChannelHandle& handle, matioCpp::Span<const T> elems, matioCpp::Span<const double> timestamps)
+    {
+        if (!handle.isValid())
+        {
+            throw std::invalid_argument("The channel handle is not valid.");
+        }
+
+        if (elems.size() != timestamps.size())
+        {
+            std::cout << "Cannot push to the channel " << handle.m_name
+                      << ". The number of elements (" << elems.size()
+                      << ") is different from the number of timestamps (" << timestamps.size() << ")." << std::endl;
+            return;
+        }
+
+        pushBatchToChannel(*handle.m_buffer_info, elems.data(), timestamps.data(), static_cast<size_t>(elems.size()), handle.m_name);
     }
 
+    /**
+     * @brief Push many elements in the channel referred by handle at once.
+     * The channel is locked only once for the whole batch.
+     * The handle must be valid, otherwise an exception is thrown.
+     *
+     * @param[in] handle The handle to the channel.
+     * @param[in] elems The elements to be pushed(via copy) in the channel, from the oldest to the newest.
+     * @param[in] timestamps The timestamps of the elements, it must have the same size of elems.
+     */
+    template<typename T>
+    inline void push_back_batch(const ChannelHandle& handle, const std::vector<T>& elems, matioCpp::Span<const double> timestamps)
+    {
+        push_back_batch(handle, matioCpp::make_span(elems), timestamps);
+    }
 
     /**
      * @brief Save the content of all the channels into a file.
@@ -485,6 +1492,18 @@ public:
      * If robometry::BufferConfig::data_threshold is greater than robometry::BufferConfig::n_samples
      * this check is skipped.
      *
+     * If robometry::BufferConfig::append_to_file is true, the first save creates the file of the session,
+     * containing the usual struct without the samples. The `data` and `timestamps` fields of each channel are
+     * replaced by `data_variable` and `timestamps_variable`, the names of the variables at the root of the file
+     * where the samples are appended along the last dimension, e.g. `joints__positions__data`. In the same way,
+     * `overwritten_samples_variable` and `dropped_samples_variable` name the variables where the counters of the
+     * channel are appended at each save, see robometry::BufferManager::getChannelCounters.
+     * The `dimensions` field contains the dimensions of a single sample. Only numeric channels can be appended,
+     * and the channels added after the first save are not described in the struct.
+     * If robometry::BufferConfig::save_format is robometry::SaveFormat::BinaryLog, the samples of the numeric channels
+     * are written to the binary log of the session, see robometry::BinaryLogWriter, and file_name_path is the name
+     * of the log without the suffix .rblog.
+     *
      * @param[in] flush_all Flag for forcing the save of whatever is contained in the channels.
      * @param[out] file_name_path path name of the matfile without the suffix .mat
      * @return true on success, false otherwise.
@@ -511,15 +1530,143 @@ public:
 private:
     static double DefaultClock();
 
+    template<typename T>
+    void pushToChannel(BufferInfo& bufferInfo, const T& elem, double ts, const std::string& var_name)
+    {
+        pushBatchToChannel(bufferInfo, &elem, &ts, 1, var_name);
+    }
+
+    template<typename T>
+    void pushBatchToChannel(BufferInfo& bufferInfo, const T* elems, const double* timestamps, size_t num_samples, const std::string& var_name)
+    {
+        const std::type_index type{ typeid(T) };
+
+        // Once initialized, the lock-free channels are written without locking the mutex,
+        // so that the producer is never blocked by the save thread. For the same reason they do not collect the
+        // samples of the pending captures, that are collected by the capture thread at the end of the windows.
+        // In case of type mismatch, the error is reported below.
+        if constexpr (canUseContiguousBuffer<T>::value)
+        {
+            if (bufferInfo.m_lock_free_ready.load(std::memory_order_acquire) && bufferInfo.m_type_index == type)
+            {
+                bufferInfo.push_back_batch(elems, timestamps, num_samples);
+                return;
+            }
+        }
+
+        if (bufferInfo.m_frame != nullptr)
+        {
+            std::cout << "Cannot push to the channel " << var_name
+                      << ". It belongs to a frame, hence it can be pushed only together with the frame." << std::endl;
+            return;
+        }
+
+        std::scoped_lock<std::mutex> lock{ bufferInfo.m_buff_mutex };
+
+        if (bufferInfo.m_type_index == typeid(void))
+        {
+            // The demangled name is computed only once, it is used just for the error messages
+            bufferInfo.m_type_index = type;
+            bufferInfo.m_type_name = getTypeName<T>();
+        }
+        else if (bufferInfo.m_type_index != type)
+        {
+            std::cout << "Cannot push to the channel " << var_name
+                      << ". Expected type: " << bufferInfo.m_type_name
+                      << ". Input type: " << getTypeName<T>() <<std::endl;
+            return;
+        }
+
+        //Create the saving functions if they were not present already
+        bufferInfo.template createMatioCppConvertFunction<T>();
+
+        bufferInfo.push_back_batch(elems, timestamps, num_samples);
+        if (m_pending_captures.load(std::memory_order_relaxed) > 0)
+        {
+            collectPushed(bufferInfo);
+        }
+    }
+
     void periodicSave();
 
+    // Wake up the save thread for saving the channels that reached their watermark, request is the flag of the kind of save.
+    // It never waits for a mutex, so that it can be called by the lock-free producers.
+    void requestSave(std::atomic<bool>& request);
+
+    // Return true if a channel or a frame has at least data_threshold samples, and at least one
+    bool hasDataToSave() const;
+
+    // Start the save thread, if it is not running, for serving the flushes
+    void startFlushThread();
+
+    // The samples of the frames, detached all together before creating the structs
+    struct DetachedFrames {
+        std::unordered_map<const BufferInfo*, BufferInfo::DetachedSamples> channels;
+        std::vector<std::pair<std::string, ContiguousBuffer::DetachedSamples>> timestamps; // One for each frame
+    };
+
+    DetachedFrames detachFrames(bool flush_all);
+
+    struct Leaf {
+        std::string name;
+        std::string path; // The full name of the channel
+        std::shared_ptr<BufferInfo> buffer_info;
+    };
+    using Leaves = std::vector<Leaf>;
+
+    // Collect the channels in the order in which createTreeStruct visits them
+    void collectLeaves(const std::string& node_name,
+                       const std::string& node_path,
+                       std::shared_ptr<TreeNode<BufferInfo>> tree_node,
+                       Leaves& leaves) const;
+
+    // Assemble the tree using the structs of the channels, ordered as returned by collectLeaves
     matioCpp::Struct createTreeStruct(const std::string& node_name,
                                       std::shared_ptr<TreeNode<BufferInfo>> tree_node,
-                                      bool flush_all);
+                                      const std::vector<matioCpp::Struct>& elements,
+                                      size_t& next_element) const;
 
     matioCpp::Struct createElementStruct(const std::string& var_name,
                                          std::shared_ptr<BufferInfo> buffInfo,
-                                         bool flush_all) const;
+                                         bool flush_all,
+                                         DetachedFrames& detached_frames) const;
+
+    // Detach the samples to be saved, it returns false if there are not enough samples
+    bool detachSamples(const std::string& var_name,
+                       BufferInfo& buffInfo,
+                       bool flush_all,
+                       DetachedFrames& detached_frames,
+                       BufferInfo::DetachedSamples& samples) const;
+
+    static void copyTimestamps(const BufferInfo& buffInfo,
+                               const BufferInfo::DetachedSamples& samples,
+                               double* destination);
+
+    // The timestamps vector, or the struct describing them implicitly if they are regular enough
+    matioCpp::Variable createTimestampsVariable(const std::string& name,
+                                                const std::vector<double>& timestamps,
+                                                double sampling_period) const;
+
+    // Name of the variable at the root of the append file, e.g. joints__positions__data
+    static std::string appendVariableName(const std::string& path, const std::string& field);
+
+    bool appendToFile(std::string& file_name_path, bool flush_all);
+
+    bool writeMatFile(std::string& file_name_path, bool flush_all);
+
+    bool writeBinaryLog(std::string& file_name_path, bool flush_all);
+
+    // Create the file of the session, with the description of the channels
+    bool createAppendFile(const std::string& file_name);
+
+    matioCpp::Struct createAppendTreeStruct(const std::string& node_name,
+                                            const std::string& node_path,
+                                            std::shared_ptr<TreeNode<BufferInfo>> tree_node) const;
+
+    // The variables appended to the file for a channel, empty if there is nothing to append
+    std::vector<matioCpp::Variable> createAppendVariables(const Leaf& leaf,
+                                                          bool flush_all,
+                                                          DetachedFrames& detached_frames) const;
 
     /**
     * This is an helper function that can be used to generate the file indexing accordingly to the
@@ -528,6 +1675,52 @@ private:
     */
     std::string fileIndex() const;
 
+    // A window of samples around a trigger, collected from the buffers before they are detached
+    struct Capture {
+        std::string file_name; // Without the suffix .mat
+        double start_time{ 0.0 };
+        double end_time{ 0.0 };
+        std::mutex mutex; // Serializes the collections from the producers of the different channels
+        BinaryLogContent content;
+        std::unordered_map<const BufferInfo*, size_t> channels; // The position of each channel in content.channels
+        std::unordered_map<const void*, double> last_timestamps; // The newest timestamp collected from each channel or frame
+    };
+
+    // Copy the samples of the window that have not been collected yet, with the mutex of the channel or frame locked.
+    // Return true if the channel or frame holds a sample after the end of the window.
+    static bool collectCapture(Capture& capture, const BufferInfo& buffInfo);
+    static bool collectCapture(Capture& capture, const FrameInfo& frame);
+
+    // Collect the samples of the pending captures, before the samples are detached from the channel or frame
+    void collectCaptures(const BufferInfo& buffInfo) const;
+    void collectCaptures(const FrameInfo& frame) const;
+
+    // Collect the samples just pushed by the producer of a channel or frame, with its mutex locked, so that the samples
+    // of the windows are copied before they can be overwritten. The capture thread is woken up when a window ends.
+    void collectPushed(const BufferInfo& buffInfo);
+    void collectPushed(const FrameInfo& frame);
+
+    // Collect the samples of all the channels and frames, locking them
+    void collectAll(Capture& capture) const;
+
+    // Reserve the storage of the whole window, estimating the rates from the sampling periods or from the samples
+    // collected before the trigger, so that the producers collecting the following samples do not reallocate it
+    static void reserveCapture(Capture& capture);
+
+    // Remove the samples older than duration with respect to the newest one of each channel or clock group
+    static void trimCapture(Capture& capture, double duration);
+
+    // Copy the samples of the window of a new capture, together with the progress of the collection
+    static void copyCaptureWindow(Capture& source, Capture& capture);
+
+    // Write the captures whose window has ended, or all of them
+    void completeCaptures(bool all);
+
+    void captureThread();
+
+    // The name of the file of a new flight recorder ring, e.g. <session>/channel_000001.rbring
+    std::string flightRecorderRingFileName(const std::string& prefix);
+
     /**
     * This is an helper function that will be disappear the day matio-cpp
     * will support the std::vector<std::string>
@@ -541,14 +1734,40 @@ private:
 
     BufferConfig m_bufferConfig;
     bool m_should_stop_thread{ false };
+    bool m_periodic_save{ false }; // True once the periodic save has been enabled, protected by m_mutex_cv
+    std::atomic<bool> m_flush_requested{ false }; // Set by the producers, reset by the save thread when it saves
+    std::atomic<bool> m_save_requested{ false }; // As m_flush_requested, for the watermark of the periodic save
+    mutable std::mutex m_save_counters_mutex; // Protects m_save_counters, it is never held while saving
+    SaveCounters m_save_counters;
     std::mutex m_mutex_cv;
     std::condition_variable m_cv;
     std::shared_ptr<TreeNode<BufferInfo>> m_tree;
+    std::unordered_map<std::string, std::shared_ptr<FrameInfo>> m_frames;
 
     std::function<double(void)> m_nowFunction{DefaultClock};
     std::function<bool(const std::string&, const SaveCallbackSaveMethod& method)> m_saveCallback{};
 
     std::thread m_save_thread;
+    std::unique_ptr<ThreadPool> m_save_thread_pool; // Not allocated if the channels are converted serially
+    std::mutex m_append_mutex; // The saves appending to the same file, or to the binary log, are serialized
+    std::string m_append_file_name; // Without the suffix .mat, empty until the first save in append mode
+    std::unique_ptr<BinaryLogWriter> m_binary_log;
+    std::string m_binary_log_file_name; // Without the suffix .rblog
+    std::unordered_map<const BufferInfo*, uint32_t> m_binary_log_channels; // The ids of the channels already described in the log
+    std::unordered_map<std::string, uint32_t> m_binary_log_clock_groups; // The ids of the clock groups already described in the log
+    std::string m_flight_recorder_directory; // Empty if the flight recorder is disabled
+    size_t m_flight_recorder_rings{ 0 }; // The number of rings of the session
+    mutable std::mutex m_captures_mutex; // Protects m_captures and m_stop_captures, it is locked after the mutexes of the channels
+    std::vector<std::shared_ptr<Capture>> m_captures;
+    std::shared_ptr<Capture> m_capture_history; // The samples detached in the last trigger_pre_duration, nullptr if it is 0
+    std::atomic<size_t> m_pending_captures{ 0 }; // The size of m_captures, checked without locking before detaching the samples
+    bool m_stop_captures{ false };
+    bool m_captures_wake{ false }; // Set by the triggers and by the producers at the end of a window, protected by m_captures_mutex
+    std::condition_variable m_captures_cv;
+    std::thread m_capture_thread; // Started at the first trigger
+    std::mutex m_memory_mutex; // Serializes the rebalances of the memory budget
+    double m_last_rebalance_time{ std::numeric_limits<double>::quiet_NaN() }; // NaN until the first rebalance
+    EmergencyDump m_emergency_dump; // Declared last, so that it is closed before the buffers it refers to are destroyed
     matioCpp::CellArray m_description_cell_array;
 };
 
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_CODEC_H
+#define ROBOMETRY_CODEC_H
+
+#include <robometry/BufferConfig.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief Get the name of a codec, e.g. "delta".
+ */
+std::string channelCodecName(ChannelCodec codec);
+
+/**
+ * @brief Get a codec from its name, see robometry::channelCodecName.
+ *
+ * @param[in] name The name of the codec.
+ * @param[out] codec The codec.
+ * @return true on success, false if the name is not known.
+ */
+bool channelCodecFromName(const std::string& name, ChannelCodec& codec);
+
+/**
+ * @brief Return true if the codec can compress elements of the given type.
+ *
+ * @param[in] codec The codec.
+ * @param[in] element_type The type of the elements, see robometry::binaryLogElementType.
+ */
+bool channelCodecSupports(ChannelCodec codec, const std::string& element_type);
+
+/**
+ * @brief Compress samples laid out one after the other. Each element is encoded with respect to the same element
+ * of the previous sample, starting from zero, hence a block of samples can be decoded on its own.
+ *
+ * @param[in] codec The codec, it has to support the type of the elements.
+ * @param[in] element_type The type of the elements, see robometry::binaryLogElementType.
+ * @param[in] data Pointer to the samples.
+ * @param[in] num_samples The number of samples.
+ * @param[in] sample_size The size in bytes of a sample.
+ * @param[out] out The vector the encoded bytes are appended to.
+ * @return true on success, false if the codec does not support the type.
+ */
+bool encodeSamples(ChannelCodec codec, const std::string& element_type, const unsigned char* data,
+                   size_t num_samples, size_t sample_size, std::vector<unsigned char>& out);
+
+/**
+ * @brief Decompress samples encoded with robometry::encodeSamples.
+ *
+ * @param[in] codec The codec.
+ * @param[in] element_type The type of the elements.
+ * @param[in] in Pointer to the encoded bytes.
+ * @param[in] in_size The number of encoded bytes.
+ * @param[in] num_samples The number of samples.
+ * @param[in] sample_size The size in bytes of a sample.
+ * @param[out] data Pointer to the memory of num_samples * sample_size bytes receiving the samples.
+ * @return true on success, false if the encoded bytes are malformed.
+ */
+bool decodeSamples(ChannelCodec codec, const std::string& element_type, const unsigned char* in, size_t in_size,
+                   size_t num_samples, size_t sample_size, unsigned char* data);
+
+/**
+ * @brief Compress timestamps with a delta-of-delta encoding of their bit patterns, zigzag and varint encoded.
+ * Periodic timestamps take about one byte each, and the encoding is lossless.
+ *
+ * @param[in] timestamps Pointer to the timestamps.
+ * @param[in] num_samples The number of timestamps.
+ * @param[out] out The vector the encoded bytes are appended to.
+ */
+void encodeTimestamps(const double* timestamps, size_t num_samples, std::vector<unsigned char>& out);
+
+/**
+ * @brief Decompress timestamps encoded with robometry::encodeTimestamps.
+ *
+ * @param[in] in Pointer to the encoded bytes.
+ * @param[in] in_size The number of encoded bytes.
+ * @param[in] num_samples The number of timestamps.
+ * @param[out] timestamps Pointer to the memory receiving the timestamps.
+ * @return true on success, false if the encoded bytes are malformed.
+ */
+bool decodeTimestamps(const unsigned char* in, size_t in_size, size_t num_samples, double* timestamps);
+
+} // robometry
+
+#endif // ROBOMETRY_CODEC_H
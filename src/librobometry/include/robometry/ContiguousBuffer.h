@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_CONTIGUOUS_BUFFER_H
+#define ROBOMETRY_CONTIGUOUS_BUFFER_H
+
+#include <robometry/MappedFile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief A circular buffer storing fixed-size samples in preallocated chunks.
+ * Differently from robometry::Buffer, the samples are not wrapped in a robometry::Record, but they
+ * are copied byte-wise in flat arrays of chunk_size * sample_size bytes. The timestamps are
+ * stored in separate arrays. The storage is allocated only once the size of a sample is known,
+ * see robometry::ContiguousBuffer::initialize.
+ *
+ * The samples can be detached from the buffer with robometry::ContiguousBuffer::detach. The chunks that
+ * are completely filled are handed over without copying them, and they are replaced with chunks taken
+ * from a pool. The detached chunks return to the pool when the robometry::ContiguousBuffer::DetachedSamples
+ * object is destroyed.
+ *
+ * The buffer can be used in lock-free mode by a single producer and a single consumer.
+ * The producer is the only one writing the write index and the consumer is the only one
+ * writing the read index, with acquire/release semantics. Since the producer cannot
+ * move the read index, when the buffer is full the new samples are dropped instead of
+ * overwriting the oldest ones.
+ * The methods changing the storage (initialize, resize, set_capacity, clear) are not thread safe.
+ *
+ * The chunks can be allocated in a memory-mapped temporary file instead of the heap, see
+ * robometry::ContiguousBuffer::setMappedStorage, for recordings that do not fit in memory.
+ *
+ */
+class ContiguousBuffer {
+
+    struct Chunk {
+        unsigned char* data{ nullptr };
+        double* timestamps{ nullptr }; // nullptr if the timestamps are not stored
+        std::vector<double> heap_storage; // Empty if the chunk is allocated in the mapped file
+    };
+
+    // The chunks that are not in use. It is shared with the DetachedSamples, that return their chunks when destroyed.
+    struct ChunkPool {
+        size_t chunk_size{ 0 };
+        size_t sample_size{ 0 };
+        bool store_timestamps{ true };
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        std::unique_ptr<MappedFile> mapped_file; // If not null, the chunks are allocated in this file
+
+        std::unique_ptr<Chunk> acquire();
+    };
+
+public:
+
+    static constexpr size_t default_chunk_size_bytes{ 64 * 1024 }; /**< Default size in bytes of a chunk */
+
+    /**
+     * @brief Samples detached from a ContiguousBuffer, see robometry::ContiguousBuffer::detach.
+     *
+     */
+    class DetachedSamples {
+    public:
+        DetachedSamples() = default;
+
+        DetachedSamples(DetachedSamples&& _other) noexcept = default;
+
+        DetachedSamples& operator=(DetachedSamples&& _other) noexcept;
+
+        /**
+         * @brief Destroy the DetachedSamples object, giving back the chunks to the ContiguousBuffer.
+         *
+         */
+        ~DetachedSamples();
+
+        /**
+         * @brief Get the number of detached samples.
+         */
+        size_t size() const;
+
+        /**
+         * @brief Get the size in bytes of a single sample, 0 if there are no samples.
+         */
+        size_t sampleSize() const;
+
+        /**
+         * @brief Copy the detached samples, from the oldest to the newest.
+         *
+         * @param[out] destination Pointer to a memory area of at least size() * sample_size bytes.
+         */
+        void copyData(void* destination) const;
+
+        /**
+         * @brief Copy the timestamps of the detached samples, from the oldest to the newest.
+         *
+         * @param[out] destination Pointer to an array of at least size() elements.
+         */
+        void copyTimestamps(double* destination) const;
+
+        /**
+         * @brief Call the visitor on each contiguous segment of the detached samples, from the oldest to the newest,
+         * without copying them.
+         *
+         * @param[in] visitor Function taking the pointer to the bytes of the samples of the segment, the pointer to their timestamps
+         * (nullptr if the timestamps are not stored) and the number of samples of the segment.
+         */
+        void visit(const std::function<void(const unsigned char* data, const double* timestamps, size_t num_samples)>& visitor) const;
+
+    private:
+        friend class ContiguousBuffer;
+
+        struct Segment {
+            std::unique_ptr<Chunk> chunk;
+            size_t begin{ 0 };
+            size_t end{ 0 };
+        };
+
+        void release();
+
+        std::vector<Segment> m_segments;
+        std::shared_ptr<ChunkPool> m_pool;
+        size_t m_size{ 0 };
+    };
+
+    ContiguousBuffer() = default;
+
+    /**
+     * @brief Construct a new ContiguousBuffer object.
+     *
+     * @param[in] num_elements Number of samples of the ContiguousBuffer to be constructed.
+     * @param[in] chunk_size_bytes Size in bytes of the chunks the storage is made of.
+     */
+    ContiguousBuffer(size_t num_elements, size_t chunk_size_bytes = default_chunk_size_bytes);
+
+    /**
+     * @brief Construct a new ContiguousBuffer object moving from another ContiguousBuffer.
+     * It must not be used concurrently with a producer or a consumer.
+     *
+     * @param[in] _other ContiguousBuffer to be moved.
+     */
+    ContiguousBuffer(ContiguousBuffer&& _other) noexcept;
+
+    /**
+     * @brief Move assignment operator.
+     * It must not be used concurrently with a producer or a consumer.
+     *
+     * @param[in] _other ContiguousBuffer to be moved.
+     * @return ContiguousBuffer& Resulting ContiguousBuffer.
+     */
+    ContiguousBuffer& operator=(ContiguousBuffer&& _other) noexcept;
+
+    /**
+     * @brief Allocate the storage of the buffer.
+     * The samples already contained in the buffer are discarded.
+     *
+     * @param[in] sample_size The size in bytes of a single sample.
+     */
+    void initialize(size_t sample_size);
+
+    /**
+     * @brief Return true if the storage has been allocated, false otherwise.
+     *
+     */
+    bool initialized() const;
+
+    /**
+     * @brief Get the size in bytes of a single sample.
+     *
+     * @return size_t The size of a sample, 0 if the buffer has not been initialized.
+     */
+    size_t sampleSize() const;
+
+    /**
+     * @brief Get the number of samples contained in a chunk.
+     *
+     * @return size_t The size of a chunk, 0 if the buffer has not been initialized.
+     */
+    size_t chunkSize() const;
+
+    /**
+     * @brief Enable the single-producer/single-consumer lock-free mode.
+     *
+     * @param[in] lock_free true for enabling the lock-free mode.
+     */
+    void setLockFree(bool lock_free);
+
+    /**
+     * @brief Return true if the buffer is in lock-free mode.
+     *
+     */
+    bool lockFree() const;
+
+    /**
+     * @brief Drop the new samples instead of overwriting the oldest ones when the buffer is full, as in lock-free mode.
+     *
+     * @param[in] drop_when_full true for dropping the new samples.
+     */
+    void setDropWhenFull(bool drop_when_full);
+
+    /**
+     * @brief Return true if the new samples are dropped when the buffer is full, i.e. if it is set or in lock-free mode.
+     *
+     */
+    bool dropWhenFull() const;
+
+    /**
+     * @brief Enable or disable the storage of the timestamps, e.g. because they are stored elsewhere.
+     * It has to be called before robometry::ContiguousBuffer::initialize.
+     * If disabled, the methods copying the timestamps do nothing.
+     *
+     * @param[in] store_timestamps true for storing the timestamps (default).
+     */
+    void setStoreTimestamps(bool store_timestamps);
+
+    /**
+     * @brief Return true if the buffer stores the timestamps of the samples.
+     *
+     */
+    bool storeTimestamps() const;
+
+    /**
+     * @brief Allocate the chunks in a memory-mapped temporary file instead of the heap, so that the operating
+     * system can page the samples out to disk. It has to be called before robometry::ContiguousBuffer::initialize.
+     * If the file cannot be created or extended, the chunks are allocated on the heap.
+     *
+     * @param[in] directory The directory of the temporary file, empty for allocating the chunks on the heap (default).
+     */
+    void setMappedStorage(const std::string& directory);
+
+    /**
+     * @brief Return the directory of the memory-mapped storage, empty if the chunks are allocated on the heap.
+     *
+     */
+    const std::string& mappedStorage() const;
+
+    /**
+     * @brief Push back copying the new sample.
+     * If the buffer is full, the oldest sample is overwritten, or the new sample is dropped in lock-free mode or if
+     * robometry::ContiguousBuffer::setDropWhenFull has been set.
+     * If size is smaller than the sample size, the remaining bytes are set to zero,
+     * if it is bigger the exceeding bytes are ignored.
+     *
+     * @param[in] data Pointer to the bytes of the sample to be copied.
+     * @param[in] size Number of bytes pointed by data.
+     * @param[in] ts The timestamp of the sample.
+     * @return true if the sample has been stored, false if it has been dropped.
+     */
+    bool push_back(const void* data, size_t size, double ts);
+
+    /**
+     * @brief Push back copying many samples at once.
+     * If the samples do not fit in the buffer, the oldest samples are overwritten, or the samples exceeding the
+     * free space are dropped in lock-free mode or if robometry::ContiguousBuffer::setDropWhenFull has been set.
+     *
+     * @param[in] data Pointer to the bytes of the samples, num_samples * sampleSize() bytes are copied.
+     * @param[in] timestamps Pointer to the num_samples timestamps of the samples.
+     * @param[in] num_samples The number of samples to be copied.
+     * @return The number of samples that have been stored.
+     */
+    size_t push_back(const void* data, const double* timestamps, size_t num_samples);
+
+    /**
+     * @brief Copy the oldest samples contained in the buffer, from the oldest to the newest.
+     *
+     * @param[out] destination Pointer to a memory area of at least num_samples * sampleSize() bytes.
+     * @param[in] num_samples The number of samples to be copied, it must not be greater than size().
+     */
+    void copyData(void* destination, size_t num_samples) const;
+
+    /**
+     * @brief Copy all the samples contained in the buffer, from the oldest to the newest.
+     *
+     * @param[out] destination Pointer to a memory area of at least size() * sampleSize() bytes.
+     */
+    void copyData(void* destination) const;
+
+    /**
+     * @brief Copy the timestamps of the oldest samples contained in the buffer, from the oldest to the newest.
+     *
+     * @param[out] destination Pointer to an array of at least num_samples elements.
+     * @param[in] num_samples The number of timestamps to be copied, it must not be greater than size().
+     */
+    void copyTimestamps(double* destination, size_t num_samples) const;
+
+    /**
+     * @brief Copy the timestamps of the samples contained in the buffer, from the oldest to the newest.
+     *
+     * @param[out] destination Pointer to an array of at least size() elements.
+     */
+    void copyTimestamps(double* destination) const;
+
+    /**
+     * @brief Detach the oldest samples from the buffer.
+     * The filled chunks are moved in the returned object and replaced with recycled ones,
+     * while the samples of the partially filled chunks are copied.
+     * In lock-free mode it has to be called by the consumer.
+     *
+     * @param[in] num_samples The number of samples to be detached, it must not be greater than size().
+     * @return The detached samples.
+     */
+    DetachedSamples detach(size_t num_samples);
+
+    /**
+     * @brief Remove the oldest samples from the buffer.
+     * In lock-free mode it has to be called by the consumer.
+     *
+     * @param[in] num_samples The number of samples to be removed, it must not be greater than size().
+     */
+    void pop_front(size_t num_samples);
+
+    /**
+     * @brief Remove the oldest samples from the buffer counting them as overwritten, e.g. for keeping the newest samples
+     * when the capacity is reduced. It cannot be used in lock-free mode.
+     *
+     * @param[in] num_samples The number of samples to be removed, it must not be greater than size().
+     */
+    void discardOldest(size_t num_samples);
+
+    /**
+     * @brief Count the oldest samples with a timestamp lower than ts, with a binary search since the timestamps
+     * are expected not to decrease. It returns 0 if the timestamps are not stored.
+     *
+     * @param[in] ts The timestamp to be compared with the ones of the samples.
+     * @return The number of samples older than ts.
+     */
+    size_t countOlderThan(double ts) const;
+
+    /**
+     * @brief Get the number of samples that have been overwritten because the buffer was full.
+     *
+     */
+    size_t overwrittenSamples() const;
+
+    /**
+     * @brief Get the number of samples that have been dropped because the buffer was full.
+     *
+     */
+    size_t droppedSamples() const;
+
+    /**
+     * @brief Get the ContiguousBuffer free space.
+     *
+     * @return size_t The free space expressed in number of samples.
+     */
+    size_t getBufferFreeSpace() const;
+
+    /**
+     * @brief Get the size of the ContiguousBuffer.
+     *
+     * @return size_t The number of samples in the buffer.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the capacity of ContiguousBuffer
+     *
+     * @return size_t The capacity of the buffer.
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief Get the bytes of the samples and of their timestamps that the ContiguousBuffer can hold.
+     *
+     * @return size_t The capacity in bytes, 0 if the buffer has not been initialized.
+     */
+    size_t memoryUsage() const;
+
+    /**
+     * @brief Return true if the ContiguousBuffer is empty, false otherwise.
+     *
+     */
+    bool empty() const;
+
+    /**
+     * @brief Return true if the ContiguousBuffer is full, false otherwise.
+     *
+     */
+    bool full() const;
+
+    /**
+     * @brief Resize the ContiguousBuffer.
+     * If new_size is bigger than the actual size, zero-initialized samples are appended.
+     * If new_size is bigger than the capacity, the capacity is increased as well.
+     *
+     * @param[in] new_size The new size to be resized to.
+     */
+    void resize(size_t new_size);
+
+    /**
+     * @brief Change the capacity of the ContiguousBuffer.
+     * If the number of samples is greater than the new capacity, the newest samples are removed.
+     *
+     * @param[in] new_size The new capacity.
+     */
+    void set_capacity(size_t new_size);
+
+    /**
+     * @brief Clear the content of the buffer, keeping the storage allocated.
+     *
+     */
+    void clear() noexcept;
+
+    /**
+     * @brief Visit the newest samples without locking and without allocating memory, e.g. from a signal handler.
+     * The visitor is called for each contiguous segment with the pointer to the bytes of the samples, the pointer to
+     * their timestamps (nullptr if they are not stored) and the number of samples of the segment.
+     * If the buffer is modified concurrently the samples may be inconsistent, but the number of visited samples is not affected.
+     *
+     * @param[in] num_samples The number of samples to visit, at most the capacity of the buffer.
+     * The samples older than the ones stored in the buffer are not meaningful.
+     * @param[in] visitor The callable object.
+     */
+    template<typename Visitor>
+    void visitNewest(size_t num_samples, Visitor&& visitor) const
+    {
+        if (!initialized()) {
+            return;
+        }
+        size_t remaining = std::min(num_samples, m_capacity);
+        size_t index = m_write_index.load(std::memory_order_acquire) - remaining;
+        while (remaining > 0) {
+            size_t offset{ 0 };
+            const Chunk& chunk = locate(index, offset);
+            const size_t count = std::min(remaining, m_chunk_size - offset);
+            visitor(static_cast<const unsigned char*>(chunk.data + offset * m_sample_size),
+                    chunk.timestamps != nullptr ? static_cast<const double*>(chunk.timestamps + offset) : nullptr,
+                    count);
+            index += count;
+            remaining -= count;
+        }
+    }
+
+    /**
+     * @brief Visit the samples contained in the buffer, from the oldest to the newest, as robometry::ContiguousBuffer::visitNewest.
+     * In lock-free mode it has to be called by the consumer, so that the samples are not released while visiting them.
+     *
+     * @param[in] first The position of the first sample to visit, 0 for the oldest one.
+     * @param[in] num_samples The number of samples to visit, first + num_samples must not be greater than size().
+     * @param[in] visitor The callable object.
+     */
+    template<typename Visitor>
+    void visit(size_t first, size_t num_samples, Visitor&& visitor) const
+    {
+        if (!initialized()) {
+            return;
+        }
+        size_t index = m_read_index.load(std::memory_order_acquire) + first;
+        while (num_samples > 0) {
+            size_t offset{ 0 };
+            const Chunk& chunk = locate(index, offset);
+            const size_t count = std::min(num_samples, m_chunk_size - offset);
+            visitor(static_cast<const unsigned char*>(chunk.data + offset * m_sample_size),
+                    chunk.timestamps != nullptr ? static_cast<const double*>(chunk.timestamps + offset) : nullptr,
+                    count);
+            index += count;
+            num_samples -= count;
+        }
+    }
+
+private:
+    // Get the chunk containing the sample with the given monotonic index, and the position of the sample in the chunk
+    Chunk& locate(size_t index, size_t& offset) const;
+
+    void store(size_t index, const void* data, size_t size, double ts);
+
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    std::shared_ptr<ChunkPool> m_pool;
+    size_t m_sample_size{ 0 };
+    size_t m_capacity{ 0 };
+    size_t m_chunk_size_bytes{ default_chunk_size_bytes };
+    size_t m_chunk_size{ 0 }; // In samples
+    size_t m_slots{ 0 }; // Number of samples that can be stored in m_chunks, it can be greater than m_capacity
+    bool m_lock_free{ false };
+    bool m_drop_when_full{ false };
+    bool m_store_timestamps{ true };
+    std::string m_mapped_storage;
+
+    // Monotonic indices, the position in the storage is obtained modulo m_slots.
+    // They are kept on different cache lines to avoid false sharing between producer and consumer.
+    alignas(64) std::atomic<size_t> m_write_index{ 0 };
+    alignas(64) std::atomic<size_t> m_read_index{ 0 };
+    alignas(64) std::atomic<size_t> m_overwritten{ 0 };
+    std::atomic<size_t> m_dropped{ 0 };
+};
+
+} // robometry
+
+#endif // ROBOMETRY_CONTIGUOUS_BUFFER_H
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_DEADBAND_H
+#define ROBOMETRY_DEADBAND_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief Selection of the samples of a channel that changed, for channels that vary seldom.
+ * A sample is kept if at least one of its elements differs from the same element of the last kept sample
+ * by more than the threshold, or exactly if the threshold is 0. The first sample is always kept.
+ * NaN elements are considered equal to each other, and different from any number.
+ * The samples kept hold until the next one, hence the signal can be reconstructed from them and their timestamps.
+ * It is not thread safe, it is meant to be used by the producer of the channel.
+ *
+ */
+class Deadband {
+public:
+    Deadband() = default;
+
+    /**
+     * @brief Construct a new Deadband object.
+     *
+     * @param[in] enabled true for keeping only the samples that changed.
+     * @param[in] threshold The largest change of an element that is ignored, it must not be negative.
+     */
+    Deadband(bool enabled, double threshold)
+        : m_enabled(enabled)
+        , m_threshold(threshold)
+    {
+    }
+
+    /**
+     * @brief Return true if only the samples that changed are kept.
+     */
+    bool enabled() const
+    {
+        return m_enabled;
+    }
+
+    /**
+     * @brief Process a sample made of num_elements elements of type E.
+     *
+     * @param[in] sample Pointer to the elements of the sample.
+     * @param[in] num_elements The number of elements, the same for all the samples.
+     * @return true if the sample is kept, false if it is dropped.
+     */
+    template<typename E>
+    bool process(const void* sample, size_t num_elements)
+    {
+        const size_t sample_size = num_elements * sizeof(E);
+        auto bytes = static_cast<const unsigned char*>(sample);
+        if (m_last.size() != sample_size)
+        {
+            m_last.assign(bytes, bytes + sample_size);
+            return true;
+        }
+
+        // No early exit, so that the comparison of all the elements can be vectorized
+        bool changed{ false };
+        for (size_t i = 0; i < num_elements; ++i)
+        {
+            E value;
+            E last;
+            std::memcpy(&value, bytes + i * sizeof(E), sizeof(E));
+            std::memcpy(&last, m_last.data() + i * sizeof(E), sizeof(E));
+            changed |= differ(value, last);
+        }
+        if (changed)
+        {
+            std::memcpy(m_last.data(), bytes, sample_size);
+        }
+        return changed;
+    }
+
+private:
+    template<typename E>
+    bool differ(E value, E last) const
+    {
+        if constexpr (std::is_floating_point_v<E>)
+        {
+            const bool both_nan = std::isnan(value) && std::isnan(last);
+            const bool equal = m_threshold > 0.0 ? std::abs(static_cast<double>(value) - static_cast<double>(last)) <= m_threshold
+                                                 : value == last;
+            return !equal && !both_nan;
+        }
+        else if constexpr (std::is_same_v<E, bool>)
+        {
+            return value != last;
+        }
+        else
+        {
+            // The integers are compared exactly when there is no threshold, even if they do not fit a double
+            return m_threshold > 0.0 ? std::abs(static_cast<double>(value) - static_cast<double>(last)) > m_threshold
+                                     : value != last;
+        }
+    }
+
+    bool m_enabled{ false };
+    double m_threshold{ 0.0 };
+    std::vector<unsigned char> m_last; // The last kept sample, empty until the first one
+};
+
+} // robometry
+
+#endif // ROBOMETRY_DEADBAND_H
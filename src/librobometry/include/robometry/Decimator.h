@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_DECIMATOR_H
+#define ROBOMETRY_DECIMATOR_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief Decimation of the samples of a channel, keeping one sample every `factor` pushed samples.
+ * The first sample is kept. Optionally, the floating point samples are filtered before being decimated by a
+ * second-order Butterworth low-pass filter, applied element-wise with a cutoff at half of the Nyquist frequency
+ * of the decimated samples. The filter depends only on the factor, since the cutoff is relative to the sampling
+ * frequency. Its state starts from the first sample, as if it had been constant before.
+ * The elements that are not finite, e.g. the NaN of a failed reading, are passed through without updating the state,
+ * and the state of the element restarts from its next finite value.
+ * The samples of the other types are decimated without filtering them.
+ * It is not thread safe, it is meant to be used by the producer of the channel.
+ *
+ */
+class Decimator {
+public:
+    Decimator() = default;
+
+    /**
+     * @brief Construct a new Decimator object.
+     *
+     * @param[in] factor The decimation factor, 1 for keeping all the samples.
+     * @param[in] filter true for applying the low-pass filter to the floating point samples.
+     */
+    Decimator(size_t factor, bool filter);
+
+    /**
+     * @brief Return true if some samples are dropped, i.e. the factor is greater than 1.
+     */
+    bool enabled() const
+    {
+        return m_factor > 1;
+    }
+
+    /**
+     * @brief Get the decimation factor.
+     */
+    size_t factor() const
+    {
+        return m_factor;
+    }
+
+    /**
+     * @brief Return true if the floating point samples are filtered.
+     */
+    bool filter() const
+    {
+        return m_filter;
+    }
+
+    /**
+     * @brief Count a sample that cannot be filtered.
+     *
+     * @return true if the sample is kept, false if it is dropped.
+     */
+    bool keep()
+    {
+        const bool kept = m_counter == 0;
+        m_counter = (m_counter + 1) % m_factor;
+        return kept;
+    }
+
+    /**
+     * @brief Process a sample made of num_elements elements.
+     *
+     * @param[in] elements Pointer to the elements of the sample.
+     * @param[in] num_elements The number of elements, the same for all the samples.
+     * @return Pointer to the sample to be stored, valid until the next call, nullptr if the sample is dropped.
+     */
+    template<typename T>
+    const void* process(const T* elements, size_t num_elements)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            if (m_filter)
+            {
+                if (m_z1.size() != num_elements)
+                {
+                    initializeState(elements, num_elements);
+                }
+                // Direct form II transposed, each element has its own state
+                for (size_t i = 0; i < num_elements; ++i)
+                {
+                    const double x = static_cast<double>(elements[i]);
+                    if (!std::isfinite(x))
+                    {
+                        m_y[i] = x;
+                        m_restart[i] = true;
+                        continue;
+                    }
+                    if (m_restart[i])
+                    {
+                        initializeElement(i, x);
+                    }
+                    const double y = m_b0 * x + m_z1[i];
+                    m_z1[i] = m_b1 * x - m_a1 * y + m_z2[i];
+                    m_z2[i] = m_b2 * x - m_a2 * y;
+                    m_y[i] = y;
+                }
+                if (!keep())
+                {
+                    return nullptr;
+                }
+                m_output.resize(num_elements * sizeof(T));
+                for (size_t i = 0; i < num_elements; ++i)
+                {
+                    const T value = static_cast<T>(m_y[i]);
+                    std::memcpy(m_output.data() + i * sizeof(T), &value, sizeof(T));
+                }
+                return m_output.data();
+            }
+        }
+        return keep() ? elements : nullptr;
+    }
+
+private:
+    template<typename T>
+    void initializeState(const T* elements, size_t num_elements)
+    {
+        m_z1.resize(num_elements);
+        m_z2.resize(num_elements);
+        m_y.resize(num_elements);
+        m_restart.assign(num_elements, true);
+        for (size_t i = 0; i < num_elements; ++i)
+        {
+            const double x = static_cast<double>(elements[i]);
+            if (std::isfinite(x))
+            {
+                initializeElement(i, x);
+            }
+        }
+    }
+
+    void initializeElement(size_t i, double x)
+    {
+        // The steady state for a constant input, since the gain of the filter at zero frequency is 1
+        m_z2[i] = (m_b2 - m_a2) * x;
+        m_z1[i] = (m_b1 - m_a1) * x + m_z2[i];
+        m_restart[i] = false;
+    }
+
+    size_t m_factor{ 1 };
+    bool m_filter{ false };
+    size_t m_counter{ 0 }; // The position of the next sample in the current group of factor samples
+    double m_b0{ 1.0 }, m_b1{ 0.0 }, m_b2{ 0.0 }, m_a1{ 0.0 }, m_a2{ 0.0 }; // The coefficients of the filter, with a0 = 1
+    std::vector<double> m_z1, m_z2; // The state of the filter, one for each element
+    std::vector<bool> m_restart; // True for the elements whose state restarts from their next finite value
+    std::vector<double> m_y; // The filtered elements of the last sample
+    std::vector<unsigned char> m_output; // The last kept sample, converted back to the type of the elements
+};
+
+} // robometry
+
+#endif // ROBOMETRY_DECIMATOR_H
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_EMERGENCY_DUMP_H
+#define ROBOMETRY_EMERGENCY_DUMP_H
+
+#include <robometry/BinaryLog.h>
+#include <robometry/BufferConfig.h>
+#include <robometry/ContiguousBuffer.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace robometry {
+
+/**
+ * @brief Dump of the samples stored in memory when the process receives SIGSEGV, SIGABRT or SIGTERM.
+ * The file of the dump is opened in advance, and the signal handler writes the samples of the registered
+ * buffers using only async-signal-safe calls, without allocating memory and without locking.
+ * The dump is a robometry binary log (see robometry::BinaryLogWriter), that can be converted post-mortem
+ * with robometry::binaryLogToMat or the robometry_log_to_mat tool.
+ * After the dump, the signal is raised again with the previous handler.
+ * The samples are read while other threads may still be writing them, hence the newest samples may be torn.
+ * It is supported only on POSIX systems.
+ *
+ */
+class EmergencyDump {
+public:
+    struct Entry;
+
+    EmergencyDump() = default;
+
+    EmergencyDump(const EmergencyDump&) = delete;
+
+    EmergencyDump& operator=(const EmergencyDump&) = delete;
+
+    /**
+     * @brief Destroy the EmergencyDump object, see robometry::EmergencyDump::close.
+     */
+    ~EmergencyDump();
+
+    /**
+     * @brief Open the file of the dump and install the signal handlers.
+     *
+     * @param[in] file_name The name of the file, it is overwritten if it exists.
+     * @param[in] config The configuration providing the filename, yarp_robot_name and description_list of the dump.
+     * @return true on success, false otherwise.
+     */
+    bool open(const std::string& file_name, const BufferConfig& config);
+
+    /**
+     * @brief Return true if the dump is open, false otherwise.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Stop dumping the registered buffers on signals and close the file, removing it if the dump has not been written.
+     * It has to be called before destroying the registered buffers.
+     */
+    void close();
+
+    /**
+     * @brief Register the timestamps of a clock group.
+     * The registered objects have to stay alive until the dump is closed.
+     *
+     * @param[in] name The name of the clock group.
+     * @param[in] timestamps The buffer storing the timestamps as its samples.
+     * @return The entry of the clock group, nullptr if the dump is not open.
+     */
+    Entry* addClockGroup(const std::string& name, const ContiguousBuffer& timestamps);
+
+    /**
+     * @brief Register a channel, once the size of its samples is known.
+     * The registered objects have to stay alive until the dump is closed.
+     *
+     * @param[in] schema The description of the channel.
+     * @param[in] buffer The buffer storing the samples of the channel.
+     * @param[in] clock_group The entry of the clock group of the channel, nullptr if the channel stores its timestamps.
+     * @return The entry of the channel, nullptr if the dump is not open.
+     */
+    Entry* addChannel(const BinaryLogChannelSchema& schema, const ContiguousBuffer& buffer, Entry* clock_group);
+
+    /**
+     * @brief Write the dump of the registered buffers, as done by the signal handler.
+     * It can be called only once, the following calls do nothing.
+     *
+     * @return true on success, false otherwise.
+     */
+    bool dump();
+
+private:
+    Entry* add(Entry* entry);
+
+    int m_file{ -1 };
+    std::string m_file_name;
+    std::string m_header; // The magic, the version and the header record of the binary log
+    std::mutex m_mutex; // Serializes the registrations, it is not used by the signal handler
+    std::atomic<Entry*> m_entries{ nullptr }; // A list that the signal handler can walk while new entries are added
+    uint32_t m_channels{ 0 };
+    uint32_t m_clock_groups{ 0 };
+    std::atomic<bool> m_dumped{ false };
+};
+
+} // robometry
+
+#endif // ROBOMETRY_EMERGENCY_DUMP_H
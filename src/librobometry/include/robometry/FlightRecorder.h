@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_FLIGHT_RECORDER_H
+#define ROBOMETRY_FLIGHT_RECORDER_H
+
+#include <robometry/BinaryLog.h>
+#include <robometry/BufferConfig.h>
+#include <robometry/MappedFile.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace robometry {
+
+/**
+ * @brief A circular buffer of fixed-size samples stored in a persistent memory-mapped file.
+ * Since the content of the mapping is kept by the operating system, the samples pushed before
+ * a crash of the process can be recovered with robometry::flightRecorderToMat.
+ *
+ * The file starts with a header containing the magic "RBMTRING", the version of the format, the kind of ring,
+ * the capacity, the size of a sample, the size of the json description of the channel (see robometry::channelSchemaToJson),
+ * the offsets of the samples and of the timestamps and the monotonic write index, followed by the description of the channel.
+ * The write index is updated after the sample is copied, hence a sample being written during a crash is not recovered.
+ * A ring has a single producer, i.e. the pushes have to be serialized.
+ *
+ */
+class FlightRecorderRing {
+public:
+    /**
+     * @brief The kinds of ring.
+     */
+    enum class Kind : uint32_t {
+        Channel = 0, /**< The samples of a channel */
+        ClockGroup = 1 /**< The timestamps of a clock group, stored as the samples of the ring */
+    };
+
+    static constexpr char magic[8] = { 'R', 'B', 'M', 'T', 'R', 'I', 'N', 'G' }; /**< The first bytes of the file */
+    static constexpr uint32_t version{ 1 }; /**< The version of the format */
+
+    /**
+     * @brief Create the file of the ring. The timestamps are stored only for the channels without a clock group.
+     *
+     * @param[in] file_name The name of the file, it is overwritten if it exists.
+     * @param[in] kind The kind of ring.
+     * @param[in] schema The description of the channel, or the name of the clock group.
+     * @param[in] capacity The number of samples of the ring.
+     * @return true on success, false otherwise.
+     */
+    bool open(const std::string& file_name, Kind kind, const BinaryLogChannelSchema& schema, size_t capacity);
+
+    /**
+     * @brief Return true if the ring is open, false otherwise.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Unmap the file of the ring, keeping it on disk.
+     */
+    void close();
+
+    /**
+     * @brief Push back copying the new sample, the oldest sample is overwritten if the ring is full.
+     *
+     * @param[in] data Pointer to the bytes of the sample.
+     * @param[in] size Number of bytes of the sample. The sample is truncated or zero padded to the sample size of the ring.
+     * @param[in] ts The timestamp of the sample.
+     */
+    void push_back(const void* data, size_t size, double ts);
+
+    /**
+     * @brief Push back many samples at once.
+     *
+     * @param[in] data Pointer to the samples, one after the other.
+     * @param[in] timestamps Pointer to the timestamps of the samples.
+     * @param[in] num_samples The number of samples.
+     */
+    void push_back(const void* data, const double* timestamps, size_t num_samples);
+
+private:
+    struct Header;
+
+    std::unique_ptr<MappedFile> m_file;
+    Header* m_header{ nullptr };
+    unsigned char* m_data{ nullptr };
+    double* m_timestamps{ nullptr }; // nullptr if the timestamps are not stored
+    size_t m_capacity{ 0 };
+    size_t m_sample_size{ 0 };
+    uint64_t m_write_index{ 0 };
+};
+
+/**
+ * @brief Create the directory of a flight recorder session, with the description of the session used by robometry::flightRecorderToMat.
+ *
+ * @param[in] directory The directory of the session, it is created if it does not exist.
+ * @param[in] config The configuration providing the filename, yarp_robot_name and description_list of the session.
+ * @return true on success, false otherwise.
+ */
+bool createFlightRecorderSession(const std::string& directory, const BufferConfig& config);
+
+/**
+ * @brief Rebuild the samples stored in the rings of a flight recorder session, e.g. after a crash, and save them
+ * to a .mat file with the same layout of robometry::BufferManager::saveToFile.
+ * The channels of a clock group are cut to the samples available in all of them.
+ *
+ * @param[in] directory The directory of the session.
+ * @param[in] mat_file_name The name of the .mat file to be created.
+ * @param[in] mat_file_version The version of the .mat file.
+ * @return true on success, false otherwise.
+ */
+bool flightRecorderToMat(const std::string& directory,
+                         const std::string& mat_file_name,
+                         matioCpp::FileVersion mat_file_version = matioCpp::FileVersion::Default);
+
+} // robometry
+
+#endif // ROBOMETRY_FLIGHT_RECORDER_H
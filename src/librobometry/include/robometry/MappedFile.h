@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_MAPPED_FILE_H
+#define ROBOMETRY_MAPPED_FILE_H
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief A file on disk that grows by regions mapped in memory.
+ * The memory of the regions is backed by the file instead of the swap, so the operating system
+ * can page it out when the physical memory is not enough. A temporary file is removed from the file system
+ * as soon as it is created (or when it is closed on Windows), while a persistent file keeps the content
+ * written in the regions also if the process crashes. The regions are unmapped when the object is destroyed.
+ *
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Destroy the MappedFile object, unmapping all the regions and closing the file.
+     */
+    ~MappedFile();
+
+    /**
+     * @brief Create the temporary file.
+     *
+     * @param[in] directory The directory where the file is created, it has to exist.
+     * @return true on success, false otherwise.
+     */
+    bool create(const std::string& directory);
+
+    /**
+     * @brief Create a persistent file, that is kept on disk when the object is destroyed.
+     *
+     * @param[in] file_name The name of the file, it is overwritten if it exists.
+     * @return true on success, false otherwise.
+     */
+    bool createPersistent(const std::string& file_name);
+
+    /**
+     * @brief Extend the file and map the new part in memory. The new region is filled with zeros.
+     * The method is thread safe.
+     *
+     * @param[in] size The size in bytes of the region, it is rounded up to the allocation granularity.
+     * @return The address of the region, nullptr on failure (e.g. because the disk is full).
+     */
+    void* map(size_t size);
+
+private:
+    struct Region {
+        void* address{ nullptr };
+        size_t size{ 0 };
+#ifdef _WIN32
+        void* mapping{ nullptr };
+#endif
+    };
+
+    std::mutex m_mutex;
+    std::vector<Region> m_regions;
+    size_t m_file_size{ 0 };
+#ifdef _WIN32
+    void* m_file{ nullptr };
+#else
+    int m_file{ -1 };
+#endif
+};
+
+} // robometry
+
+#endif // ROBOMETRY_MAPPED_FILE_H
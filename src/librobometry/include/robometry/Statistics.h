@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_STATISTICS_H
+#define ROBOMETRY_STATISTICS_H
+
+#include <robometry/BufferConfig.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief The statistics of the elements of a channel, see robometry::BufferManager::getStatistics.
+ * The vectors have one value for each element of a sample, in column-major order.
+ */
+struct ChannelStatistics {
+    dimensions_t dimensions; /**< The dimensions of a sample */
+    std::vector<size_t> count; /**< The number of samples of each element, NaN excluded */
+    std::vector<double> min; /**< The minimum of each element, NaN if there are no samples */
+    std::vector<double> max; /**< The maximum of each element, NaN if there are no samples */
+    std::vector<double> mean; /**< The mean of each element, NaN if there are no samples */
+    std::vector<double> variance; /**< The unbiased variance of each element, NaN if there are less than two samples */
+};
+
+/**
+ * @brief Running statistics of the elements of the samples pushed to a channel.
+ * They are updated incrementally at each sample with the algorithm of Welford, element-wise, and the NaN elements
+ * are ignored. The state is owned by the producer of the channel, that publishes a copy of it after each update
+ * through a triple buffer, hence the producer never blocks, also in the lock-free channels, and the readers
+ * get the statistics of all the samples pushed until the last update.
+ *
+ */
+class OnlineStatistics {
+public:
+    OnlineStatistics() = default;
+
+    OnlineStatistics(const OnlineStatistics&) = delete;
+
+    OnlineStatistics& operator=(const OnlineStatistics&) = delete;
+
+    /**
+     * @brief Update the statistics with a sample.
+     * It has to be called by a single thread at a time, i.e. by the producer of the channel.
+     *
+     * @param[in] elements Pointer to the elements of the sample.
+     * @param[in] num_elements The number of elements, the same for all the samples.
+     */
+    template<typename E>
+    void update(const E* elements, size_t num_elements)
+    {
+        auto& state = m_state;
+        if (state.count.size() != num_elements)
+        {
+            state.count.assign(num_elements, 0.0);
+            state.min.assign(num_elements, std::numeric_limits<double>::infinity());
+            state.max.assign(num_elements, -std::numeric_limits<double>::infinity());
+            state.mean.assign(num_elements, 0.0);
+            state.m2.assign(num_elements, 0.0);
+        }
+        // Branchless, so that the loop can be vectorized
+        for (size_t i = 0; i < num_elements; ++i)
+        {
+            const double x = static_cast<double>(elements[i]);
+            const bool valid = x == x;
+            const double value = valid ? x : state.mean[i];
+            const double count = state.count[i] + (valid ? 1.0 : 0.0);
+            const double delta = value - state.mean[i];
+            const double mean = state.mean[i] + (valid ? delta / count : 0.0);
+            state.m2[i] += delta * (value - mean);
+            state.mean[i] = mean;
+            state.count[i] = count;
+            state.min[i] = valid ? std::min(state.min[i], x) : state.min[i];
+            state.max[i] = valid ? std::max(state.max[i], x) : state.max[i];
+        }
+
+        // The vectors of the copies keep their storage, hence no memory is allocated after the first samples
+        m_buffers[m_back] = state;
+        m_back = m_middle.exchange(m_back | dirty, std::memory_order_acq_rel) & index_mask;
+    }
+
+    /**
+     * @brief Get the statistics.
+     *
+     * @param[in] dimensions The dimensions of a sample of the channel.
+     * @param[out] statistics The statistics.
+     * @return true on success, false if no sample has been pushed.
+     */
+    bool get(const dimensions_t& dimensions, ChannelStatistics& statistics) const
+    {
+        constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+        std::scoped_lock<std::mutex> lock{ m_mutex };
+        if (m_middle.load(std::memory_order_acquire) & dirty)
+        {
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index_mask;
+        }
+        const auto& state = m_buffers[m_front];
+        if (state.count.empty())
+        {
+            return false;
+        }
+        const size_t num_elements = state.count.size();
+        statistics.dimensions = dimensions;
+        statistics.count.resize(num_elements);
+        statistics.min.resize(num_elements);
+        statistics.max.resize(num_elements);
+        statistics.mean.resize(num_elements);
+        statistics.variance.resize(num_elements);
+        for (size_t i = 0; i < num_elements; ++i)
+        {
+            const bool has_samples = state.count[i] > 0.0;
+            statistics.count[i] = static_cast<size_t>(state.count[i]);
+            statistics.min[i] = has_samples ? state.min[i] : nan;
+            statistics.max[i] = has_samples ? state.max[i] : nan;
+            statistics.mean[i] = has_samples ? state.mean[i] : nan;
+            statistics.variance[i] = state.count[i] > 1.0 ? state.m2[i] / (state.count[i] - 1.0) : nan;
+        }
+        return true;
+    }
+
+private:
+    struct State {
+        std::vector<double> count; // Stored as double, like the other values, to ease the vectorization
+        std::vector<double> min;
+        std::vector<double> max;
+        std::vector<double> mean;
+        std::vector<double> m2; // The sum of the squared differences from the mean
+    };
+
+    static constexpr unsigned index_mask{ 3 };
+    static constexpr unsigned dirty{ 4 }; // Set in m_middle when it holds a copy not read yet
+
+    State m_state; // Owned by the producer
+    State m_buffers[3]; // The copies of the state, the one being written, the last published, and the one being read
+    unsigned m_back{ 0 }; // Owned by the producer
+    mutable std::atomic<unsigned> m_middle{ 1 };
+    mutable unsigned m_front{ 2 }; // Protected by m_mutex
+    mutable std::mutex m_mutex; // Serializes the readers, the producer never locks it
+};
+
+} // robometry
+
+#endif // ROBOMETRY_STATISTICS_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#ifndef ROBOMETRY_THREAD_POOL_H
+#define ROBOMETRY_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace robometry {
+
+/**
+ * @brief A fixed set of worker threads running the iterations of a loop in parallel,
+ * see robometry::ThreadPool::parallelFor.
+ *
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Construct a new ThreadPool object.
+     *
+     * @param[in] num_threads The number of threads running the loops, including the one calling
+     * robometry::ThreadPool::parallelFor. Hence num_threads - 1 worker threads are started.
+     */
+    explicit ThreadPool(size_t num_threads);
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Destroy the ThreadPool object, joining the worker threads.
+     *
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Get the number of threads running the loops, including the calling one.
+     *
+     */
+    size_t size() const;
+
+    /**
+     * @brief Call task(i) for each i in [0, num_tasks), in parallel on the worker threads and the calling thread.
+     * It returns when all the tasks are completed. The calls from different threads are serialized.
+     * If a task throws, the first exception is rethrown once all the other tasks are completed.
+     *
+     * @param[in] num_tasks The number of tasks.
+     * @param[in] task The function to be called with the index of each task.
+     */
+    void parallelFor(size_t num_tasks, const std::function<void(size_t)>& task);
+
+private:
+    void workerLoop();
+
+    // Run the tasks of the current loop until there are no more
+    void runTasks();
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_loop_mutex; // Serializes the calls to parallelFor
+    std::mutex m_mutex;
+    std::condition_variable m_cv_start;
+    std::condition_variable m_cv_done;
+    size_t m_generation{ 0 };
+    size_t m_active_workers{ 0 };
+    bool m_stop{ false };
+
+    const std::function<void(size_t)>* m_task{ nullptr };
+    size_t m_num_tasks{ 0 };
+    std::atomic<size_t> m_next_task{ 0 };
+    std::exception_ptr m_exception;
+};
+
+} // robometry
+
+#endif // ROBOMETRY_THREAD_POOL_H
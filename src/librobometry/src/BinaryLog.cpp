@@ -0,0 +1,526 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/BinaryLog.h>
+#include <robometry/Codec.h>
+#include <robometry/TreeNode.h>
+
+#include <nlohmann/json.hpp>
+#include <matioCpp/matioCpp.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+
+std::string robometry::channelSchemaToJson(const BinaryLogChannelSchema& schema)
+{
+    return nlohmann::json{ {"name", schema.name},
+                           {"dimensions", schema.dimensions},
+                           {"elements_names", schema.elements_names},
+                           {"units_of_measure", schema.units_of_measure},
+                           {"element_type", schema.element_type},
+                           {"sample_size", schema.sample_size},
+                           {"clock_group", schema.clock_group},
+                           {"codec", channelCodecName(schema.codec)} }.dump();
+}
+
+bool robometry::channelSchemaFromJson(const std::string& json, BinaryLogChannelSchema& schema)
+{
+    try {
+        const auto j = nlohmann::json::parse(json);
+        j.at("name").get_to(schema.name);
+        j.at("dimensions").get_to(schema.dimensions);
+        j.at("elements_names").get_to(schema.elements_names);
+        j.at("units_of_measure").get_to(schema.units_of_measure);
+        j.at("element_type").get_to(schema.element_type);
+        j.at("sample_size").get_to(schema.sample_size);
+        j.at("clock_group").get_to(schema.clock_group);
+        // The logs written before the codecs were introduced do not contain it
+        if (!channelCodecFromName(j.value("codec", std::string("none")), schema.codec)) {
+            std::cout << "Unknown codec " << j.at("codec") << " of the channel " << schema.name << std::endl;
+            return false;
+        }
+    }
+    catch (const nlohmann::json::exception& e) {
+        std::cout << "Failed to parse the description of a channel: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool robometry::BinaryLogWriter::open(const std::string& file_name, const BufferConfig& config)
+{
+    m_file.open(file_name, std::ios::binary | std::ios::trunc);
+    if (!m_file.is_open()) {
+        std::cout << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    m_file.write(magic, sizeof(magic));
+    writeValue(version);
+
+    const std::string header = nlohmann::json{ {"filename", config.filename},
+                                               {"yarp_robot_name", config.yarp_robot_name},
+                                               {"description_list", config.description_list} }.dump();
+    writeRecordHeader(RecordKind::Header, 0, header.size());
+    m_file.write(header.data(), header.size());
+    return flush();
+}
+
+bool robometry::BinaryLogWriter::isOpen() const
+{
+    return m_file.is_open();
+}
+
+bool robometry::BinaryLogWriter::writeChannelSchema(uint32_t id, const BinaryLogChannelSchema& schema)
+{
+    BinaryLogChannelSchema written = schema;
+    if (!channelCodecSupports(written.codec, written.element_type)) {
+        std::cout << "The codec " << channelCodecName(written.codec) << " does not support the type " << written.element_type
+                  << " of the channel " << written.name << ", it is written uncompressed." << std::endl;
+        written.codec = ChannelCodec::None;
+    }
+    if (written.codec != ChannelCodec::None) {
+        m_encoded_channels[id] = written;
+    }
+    else {
+        m_encoded_channels.erase(id);
+    }
+    const std::string payload = channelSchemaToJson(written);
+    writeRecordHeader(RecordKind::ChannelSchema, id, payload.size());
+    m_file.write(payload.data(), payload.size());
+    return m_file.good();
+}
+
+bool robometry::BinaryLogWriter::writeClockGroupSchema(uint32_t id, const std::string& name)
+{
+    const std::string payload = nlohmann::json{ {"name", name} }.dump();
+    writeRecordHeader(RecordKind::ClockGroupSchema, id, payload.size());
+    m_file.write(payload.data(), payload.size());
+    return m_file.good();
+}
+
+bool robometry::BinaryLogWriter::writeChannelBlock(uint32_t id, const ContiguousBuffer::DetachedSamples& samples, bool with_timestamps)
+{
+    const uint64_t num_samples = samples.size();
+    const size_t sample_size = samples.sampleSize();
+
+    auto encoded_channel = m_encoded_channels.find(id);
+    if (encoded_channel != m_encoded_channels.end()) {
+        // The codecs need the samples one after the other, hence they are copied out of the chunks
+        const auto& schema = encoded_channel->second;
+        std::vector<unsigned char> data(num_samples * sample_size);
+        samples.copyData(data.data());
+        m_encoded.clear();
+        if (!encodeSamples(schema.codec, schema.element_type, data.data(), num_samples, sample_size, m_encoded)) {
+            std::cout << "Failed to encode the samples of the channel " << schema.name << std::endl;
+            return false;
+        }
+        const uint64_t data_size = m_encoded.size();
+        if (with_timestamps) {
+            std::vector<double> timestamps(num_samples);
+            samples.copyTimestamps(timestamps.data());
+            encodeTimestamps(timestamps.data(), num_samples, m_encoded);
+        }
+        writeRecordHeader(RecordKind::EncodedChannelBlock, id, 2 * sizeof(uint64_t) + m_encoded.size());
+        writeValue(num_samples);
+        writeValue(data_size);
+        m_file.write(reinterpret_cast<const char*>(m_encoded.data()), m_encoded.size());
+        return m_file.good();
+    }
+
+    uint64_t payload_size = sizeof(uint64_t) + num_samples * sample_size;
+    if (with_timestamps) {
+        payload_size += num_samples * sizeof(double);
+    }
+    writeRecordHeader(RecordKind::ChannelBlock, id, payload_size);
+    writeValue(num_samples);
+
+    // The segments are written directly from the chunks of the buffer, first the samples and then the timestamps
+    samples.visit([this, sample_size](const unsigned char* data, const double*, size_t num) {
+        m_file.write(reinterpret_cast<const char*>(data), num * sample_size);
+    });
+    if (with_timestamps) {
+        samples.visit([this](const unsigned char*, const double* timestamps, size_t num) {
+            m_file.write(reinterpret_cast<const char*>(timestamps), num * sizeof(double));
+        });
+    }
+    return m_file.good();
+}
+
+bool robometry::BinaryLogWriter::writeClockGroupBlock(uint32_t id, const ContiguousBuffer::DetachedSamples& timestamps, bool encode_timestamps)
+{
+    const uint64_t num_samples = timestamps.size();
+    if (encode_timestamps) {
+        std::vector<double> values(num_samples);
+        timestamps.copyData(values.data());
+        m_encoded.clear();
+        encodeTimestamps(values.data(), num_samples, m_encoded);
+        writeRecordHeader(RecordKind::EncodedClockGroupBlock, id, sizeof(uint64_t) + m_encoded.size());
+        writeValue(num_samples);
+        m_file.write(reinterpret_cast<const char*>(m_encoded.data()), m_encoded.size());
+        return m_file.good();
+    }
+    writeRecordHeader(RecordKind::ClockGroupBlock, id, sizeof(uint64_t) + num_samples * sizeof(double));
+    writeValue(num_samples);
+    timestamps.visit([this](const unsigned char* data, const double*, size_t num) {
+        m_file.write(reinterpret_cast<const char*>(data), num * sizeof(double));
+    });
+    return m_file.good();
+}
+
+bool robometry::BinaryLogWriter::writeChannelCounters(uint32_t id, uint64_t overwritten_samples, uint64_t dropped_samples)
+{
+    writeRecordHeader(RecordKind::ChannelCounters, id, 2 * sizeof(uint64_t));
+    writeValue(overwritten_samples);
+    writeValue(dropped_samples);
+    return m_file.good();
+}
+
+bool robometry::BinaryLogWriter::flush()
+{
+    m_file.flush();
+    return m_file.good();
+}
+
+void robometry::BinaryLogWriter::writeRecordHeader(RecordKind kind, uint32_t id, uint64_t payload_size)
+{
+    writeValue(static_cast<uint8_t>(kind));
+    writeValue(id);
+    writeValue(payload_size);
+}
+
+namespace {
+
+template<typename T>
+matioCpp::Variable makeDataVariable(const robometry::BinaryLogChannelSamples& channel, const robometry::dimensions_t& dimensions)
+{
+    matioCpp::MultiDimensionalArray<T> data("data", dimensions);
+    std::memcpy(data.toSpan().data(), channel.data.data(), channel.data.size());
+    return data;
+}
+
+matioCpp::Variable createDataVariable(const robometry::BinaryLogChannelSamples& channel)
+{
+    robometry::dimensions_t dimensions = channel.schema.dimensions;
+    dimensions.push_back(channel.num_samples);
+
+    const auto& type = channel.schema.element_type;
+    if (type == "double") return makeDataVariable<double>(channel, dimensions);
+    if (type == "single") return makeDataVariable<float>(channel, dimensions);
+    if (type == "int8") return makeDataVariable<int8_t>(channel, dimensions);
+    if (type == "uint8") return makeDataVariable<uint8_t>(channel, dimensions);
+    if (type == "int16") return makeDataVariable<int16_t>(channel, dimensions);
+    if (type == "uint16") return makeDataVariable<uint16_t>(channel, dimensions);
+    if (type == "int32") return makeDataVariable<int32_t>(channel, dimensions);
+    if (type == "uint32") return makeDataVariable<uint32_t>(channel, dimensions);
+    if (type == "int64") return makeDataVariable<int64_t>(channel, dimensions);
+    if (type == "uint64") return makeDataVariable<uint64_t>(channel, dimensions);
+    if (type == "char") return makeDataVariable<char>(channel, dimensions);
+    return matioCpp::Variable();
+}
+
+matioCpp::Struct createTreeStruct(const std::string& node_name, const std::shared_ptr<robometry::TreeNode<matioCpp::Struct>>& node)
+{
+    if (node->getChildren().empty()) {
+        return *node->getValue();
+    }
+    matioCpp::Struct tmp(node_name);
+    for (const auto& [child_name, child] : node->getChildren()) {
+        tmp.setField(createTreeStruct(child_name, child));
+    }
+    return tmp;
+}
+
+} // namespace
+
+bool robometry::binaryLogToMat(const std::string& log_file_name,
+                               const std::string& mat_file_name,
+                               matioCpp::FileVersion mat_file_version)
+{
+    std::ifstream input(log_file_name, std::ios::binary);
+    if (!input.is_open()) {
+        std::cout << "Failed to open " << log_file_name << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(BinaryLogWriter::magic)];
+    uint32_t version{ 0 };
+    input.read(magic, sizeof(magic));
+    input.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!input || std::memcmp(magic, BinaryLogWriter::magic, sizeof(magic)) != 0 || version != BinaryLogWriter::version) {
+        std::cout << log_file_name << " is not a robometry binary log of version " << BinaryLogWriter::version << std::endl;
+        return false;
+    }
+
+    input.seekg(0, std::ios::end);
+    const uint64_t file_size = static_cast<uint64_t>(input.tellg());
+    input.seekg(sizeof(magic) + sizeof(version), std::ios::beg);
+
+    nlohmann::json header;
+    BinaryLogContent content;
+    std::map<uint32_t, BinaryLogChannelSamples> channels;
+    std::map<uint32_t, std::string> clock_group_names;
+
+    while (true) {
+        uint8_t kind{ 0 };
+        uint32_t id{ 0 };
+        uint64_t payload_size{ 0 };
+        input.read(reinterpret_cast<char*>(&kind), sizeof(kind));
+        input.read(reinterpret_cast<char*>(&id), sizeof(id));
+        input.read(reinterpret_cast<char*>(&payload_size), sizeof(payload_size));
+        if (!input) {
+            break;
+        }
+        if (payload_size > file_size - static_cast<uint64_t>(input.tellg())) {
+            std::cout << "The last record of " << log_file_name << " is truncated, it is ignored." << std::endl;
+            break;
+        }
+        std::vector<char> payload(payload_size);
+        input.read(payload.data(), payload_size);
+        if (!input) {
+            std::cout << "The last record of " << log_file_name << " is truncated, it is ignored." << std::endl;
+            break;
+        }
+
+        try {
+            switch (static_cast<BinaryLogWriter::RecordKind>(kind)) {
+            case BinaryLogWriter::RecordKind::Header:
+                header = nlohmann::json::parse(payload.begin(), payload.end());
+                break;
+            case BinaryLogWriter::RecordKind::ChannelSchema:
+                if (!channelSchemaFromJson(std::string(payload.begin(), payload.end()), channels[id].schema)) {
+                    return false;
+                }
+                break;
+            case BinaryLogWriter::RecordKind::ClockGroupSchema:
+                nlohmann::json::parse(payload.begin(), payload.end()).at("name").get_to(clock_group_names[id]);
+                break;
+            case BinaryLogWriter::RecordKind::ChannelBlock: {
+                auto channel = channels.find(id);
+                if (channel == channels.end() || channel->second.schema.sample_size == 0) {
+                    std::cout << "The block of the unknown channel " << id << " is ignored." << std::endl;
+                    break;
+                }
+                auto& c = channel->second;
+                uint64_t num_samples{ 0 };
+                if (payload_size >= sizeof(num_samples)) {
+                    std::memcpy(&num_samples, payload.data(), sizeof(num_samples));
+                }
+                // The number of samples is checked against the payload before multiplying, since it could overflow
+                const uint64_t samples_size = payload_size - std::min<uint64_t>(payload_size, sizeof(num_samples));
+                if (num_samples > samples_size / c.schema.sample_size ||
+                    (c.schema.clock_group.empty() && num_samples > samples_size / sizeof(double))) {
+                    std::cout << "The block of the channel " << c.schema.name << " is malformed, it is ignored." << std::endl;
+                    break;
+                }
+                const size_t data_size = num_samples * c.schema.sample_size;
+                const size_t timestamps_size = c.schema.clock_group.empty() ? num_samples * sizeof(double) : 0;
+                if (payload_size != sizeof(num_samples) + data_size + timestamps_size) {
+                    std::cout << "The block of the channel " << c.schema.name << " is malformed, it is ignored." << std::endl;
+                    break;
+                }
+                const char* data = payload.data() + sizeof(num_samples);
+                c.data.insert(c.data.end(), data, data + data_size);
+                if (c.schema.clock_group.empty()) {
+                    const size_t old_size = c.timestamps.size();
+                    c.timestamps.resize(old_size + num_samples);
+                    std::memcpy(c.timestamps.data() + old_size, data + data_size, num_samples * sizeof(double));
+                }
+                c.num_samples += num_samples;
+                break;
+            }
+            case BinaryLogWriter::RecordKind::EncodedChannelBlock: {
+                auto channel = channels.find(id);
+                if (channel == channels.end() || channel->second.schema.sample_size == 0) {
+                    std::cout << "The block of the unknown channel " << id << " is ignored." << std::endl;
+                    break;
+                }
+                auto& c = channel->second;
+                uint64_t num_samples{ 0 };
+                uint64_t data_size{ 0 };
+                if (payload_size >= 2 * sizeof(uint64_t)) {
+                    std::memcpy(&num_samples, payload.data(), sizeof(num_samples));
+                    std::memcpy(&data_size, payload.data() + sizeof(num_samples), sizeof(data_size));
+                }
+                const auto encoded = reinterpret_cast<const unsigned char*>(payload.data()) + 2 * sizeof(uint64_t);
+                const uint64_t encoded_size = payload_size - std::min<uint64_t>(payload_size, 2 * sizeof(uint64_t));
+                // Each encoded sample takes at least one bit, and each encoded timestamp at least one byte
+                if (data_size > encoded_size || num_samples > 8 * encoded_size ||
+                    num_samples > std::numeric_limits<size_t>::max() / c.schema.sample_size) {
+                    std::cout << "The block of the channel " << c.schema.name << " is malformed, it is ignored." << std::endl;
+                    break;
+                }
+                const size_t old_size = c.data.size();
+                c.data.resize(old_size + num_samples * c.schema.sample_size);
+                bool decoded = decodeSamples(c.schema.codec, c.schema.element_type, encoded, data_size,
+                                             num_samples, c.schema.sample_size, c.data.data() + old_size);
+                if (decoded && c.schema.clock_group.empty()) {
+                    c.timestamps.resize(c.num_samples + num_samples);
+                    decoded = decodeTimestamps(encoded + data_size, encoded_size - data_size, num_samples,
+                                               c.timestamps.data() + c.num_samples);
+                    if (!decoded) {
+                        c.timestamps.resize(c.num_samples);
+                    }
+                }
+                if (!decoded) {
+                    c.data.resize(old_size);
+                    std::cout << "The block of the channel " << c.schema.name << " is malformed, it is ignored." << std::endl;
+                    break;
+                }
+                c.num_samples += num_samples;
+                break;
+            }
+            case BinaryLogWriter::RecordKind::EncodedClockGroupBlock: {
+                uint64_t num_samples{ 0 };
+                if (payload_size >= sizeof(num_samples)) {
+                    std::memcpy(&num_samples, payload.data(), sizeof(num_samples));
+                }
+                const uint64_t encoded_size = payload_size - std::min<uint64_t>(payload_size, sizeof(num_samples));
+                if (clock_group_names.count(id) == 0 || num_samples > encoded_size) {
+                    std::cout << "The block of the clock group " << id << " is malformed, it is ignored." << std::endl;
+                    break;
+                }
+                auto& timestamps = content.clock_groups[clock_group_names[id]];
+                const size_t old_size = timestamps.size();
+                timestamps.resize(old_size + num_samples);
+                if (!decodeTimestamps(reinterpret_cast<const unsigned char*>(payload.data()) + sizeof(num_samples), encoded_size,
+                                      num_samples, timestamps.data() + old_size)) {
+                    timestamps.resize(old_size);
+                    std::cout << "The block of the clock group " << id << " is malformed, it is ignored." << std::endl;
+                }
+                break;
+            }
+            case BinaryLogWriter::RecordKind::ClockGroupBlock: {
+                uint64_t num_samples{ 0 };
+                if (payload_size >= sizeof(num_samples)) {
+                    std::memcpy(&num_samples, payload.data(), sizeof(num_samples));
+                }
+                if (clock_group_names.count(id) == 0 || num_samples > payload_size / sizeof(double) ||
+                    payload_size != sizeof(num_samples) + num_samples * sizeof(double)) {
+                    std::cout << "The block of the clock group " << id << " is malformed, it is ignored." << std::endl;
+                    break;
+                }
+                auto& timestamps = content.clock_groups[clock_group_names[id]];
+                const size_t old_size = timestamps.size();
+                timestamps.resize(old_size + num_samples);
+                std::memcpy(timestamps.data() + old_size, payload.data() + sizeof(num_samples), num_samples * sizeof(double));
+                break;
+            }
+            case BinaryLogWriter::RecordKind::ChannelCounters: {
+                auto channel = channels.find(id);
+                if (channel == channels.end() || payload_size != 2 * sizeof(uint64_t)) {
+                    std::cout << "The counters of the channel " << id << " are malformed, they are ignored." << std::endl;
+                    break;
+                }
+                // The counters are cumulative, hence the last record holds the final ones
+                uint64_t overwritten_samples{ 0 };
+                uint64_t dropped_samples{ 0 };
+                std::memcpy(&overwritten_samples, payload.data(), sizeof(overwritten_samples));
+                std::memcpy(&dropped_samples, payload.data() + sizeof(overwritten_samples), sizeof(dropped_samples));
+                channel->second.overwritten_samples = overwritten_samples;
+                channel->second.dropped_samples = dropped_samples;
+                break;
+            }
+            default:
+                std::cout << "Unknown record of kind" << static_cast<int>(kind) << " in " << log_file_name << ", it is ignored." << std::endl;
+                break;
+            }
+        }
+        catch (const nlohmann::json::exception& e) {
+            std::cout << "Failed to parse a record of " << log_file_name << ": " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    if (!header.is_object()) {
+        std::cout << log_file_name << " does not contain the header." << std::endl;
+        return false;
+    }
+    content.filename = header.value("filename", content.filename);
+    content.yarp_robot_name = header.value("yarp_robot_name", std::string());
+    content.description_list = header.value("description_list", std::vector<std::string>());
+    for (auto& [id, channel] : channels) {
+        content.channels.push_back(std::move(channel));
+    }
+    return logContentToMat(content, mat_file_name, mat_file_version);
+}
+
+bool robometry::logContentToMat(const BinaryLogContent& content,
+                                const std::string& mat_file_name,
+                                matioCpp::FileVersion mat_file_version)
+{
+    // The same layout of robometry::BufferManager::saveToFile
+    std::vector<matioCpp::Variable> signalsVect;
+    if (!content.description_list.empty()) {
+        std::vector<matioCpp::Variable> descrListVect;
+        for (const auto& str : content.description_list) {
+            descrListVect.emplace_back(matioCpp::String("useless_name", str));
+        }
+        signalsVect.emplace_back(matioCpp::CellArray("description_list", { content.description_list.size(), 1 }, descrListVect));
+    }
+    signalsVect.emplace_back(matioCpp::String("yarp_robot_name", content.yarp_robot_name));
+
+    auto tree = std::make_shared<TreeNode<matioCpp::Struct>>();
+    for (const auto& channel : content.channels) {
+        if (channel.num_samples == 0) {
+            continue;
+        }
+        matioCpp::Variable data = createDataVariable(channel);
+        if (!data.isValid()) {
+            std::cout << "The type " << channel.schema.element_type << " of the channel " << channel.schema.name << " is not supported, skipping" << std::endl;
+            continue;
+        }
+
+        const auto nodes = TreeNode<matioCpp::Struct>::splitString(channel.schema.name);
+        dimensions_t fullDimensions = channel.schema.dimensions;
+        fullDimensions.push_back(channel.num_samples);
+
+        std::vector<matioCpp::Variable> var_data;
+        var_data.emplace_back(data);
+        var_data.emplace_back(matioCpp::make_variable("dimensions", fullDimensions));
+        var_data.emplace_back(matioCpp::make_variable("elements_names", channel.schema.elements_names));
+        var_data.emplace_back(matioCpp::make_variable("units_of_measure", channel.schema.units_of_measure));
+        var_data.emplace_back(matioCpp::String("name", nodes.back()));
+        if (channel.schema.clock_group.empty()) {
+            var_data.emplace_back(matioCpp::Vector<double>("timestamps", matioCpp::make_span(channel.timestamps)));
+        }
+        else {
+            var_data.emplace_back(matioCpp::String("clock_group", channel.schema.clock_group));
+        }
+        var_data.emplace_back(matioCpp::make_variable("overwritten_samples", channel.overwritten_samples));
+        var_data.emplace_back(matioCpp::make_variable("dropped_samples", channel.dropped_samples));
+        if (!addLeaf(channel.schema.name, std::make_shared<matioCpp::Struct>(nodes.back(), var_data), tree)) {
+            std::cout << "Failed to add the channel " << channel.schema.name << ", skipping" << std::endl;
+        }
+    }
+
+    for (const auto& [node_name, node] : tree->getChildren()) {
+        signalsVect.emplace_back(createTreeStruct(node_name, node));
+    }
+
+    std::vector<matioCpp::Variable> clockGroupsVect;
+    for (const auto& [group_name, timestamps] : content.clock_groups) {
+        clockGroupsVect.emplace_back(matioCpp::Vector<double>(group_name, matioCpp::make_span(timestamps)));
+    }
+    if (!clockGroupsVect.empty()) {
+        signalsVect.emplace_back(matioCpp::Struct("clock_groups", clockGroupsVect));
+    }
+
+    matioCpp::File file = matioCpp::File::Create(mat_file_name, mat_file_version);
+    if (!file.isOpen()) {
+        std::cout << "Failed to create " << mat_file_name << std::endl;
+        return false;
+    }
+    bool ok = file.write(matioCpp::Struct(content.filename, signalsVect));
+    if (!ok) {
+        std::cout << "An error occurred while saving the data to the file." << std::endl;
+    }
+    return ok;
+}
@@ -23,6 +23,23 @@ namespace matioCpp {
 
 namespace robometry {
 
+    NLOHMANN_JSON_SERIALIZE_ENUM( SaveFormat, {
+            {SaveFormat::Mat, "mat"},
+            {SaveFormat::BinaryLog, "binary_log"},
+        })
+
+    NLOHMANN_JSON_SERIALIZE_ENUM( ChannelCodec, {
+            {ChannelCodec::None, "none"},
+            {ChannelCodec::Delta, "delta"},
+            {ChannelCodec::Xor, "xor"},
+        })
+
+    NLOHMANN_JSON_SERIALIZE_ENUM( OverflowPolicy, {
+            {OverflowPolicy::OverwriteOldest, "overwrite_oldest"},
+            {OverflowPolicy::DropNewest, "drop_newest"},
+            {OverflowPolicy::Flush, "flush"},
+        })
+
     ChannelInfo::ChannelInfo(const std::string& name,
                              const dimensions_t& dimensions,
                              const elements_names_t& elements_names,
@@ -71,7 +88,18 @@ namespace robometry {
         j = nlohmann::json{{"name", info.name},
                            {"dimensions", info.dimensions},
                            {"elements_names", info.elements_names},
-                           {"units_of_measure", info.units_of_measure}};
+                           {"units_of_measure", info.units_of_measure},
+                           {"lock_free", info.lock_free},
+                           {"clock_group", info.clock_group},
+                           {"codec", info.codec},
+                           {"sampling_period", info.sampling_period},
+                           {"decimation", info.decimation},
+                           {"decimation_filter", info.decimation_filter},
+                           {"on_change", info.on_change},
+                           {"deadband", info.deadband},
+                           {"statistics", info.statistics},
+                           {"retention", info.retention},
+                           {"overflow_policy", info.overflow_policy}};
     }
 
     void from_json(const nlohmann::json& j, ChannelInfo& info)
@@ -80,10 +108,83 @@ namespace robometry {
         j.at("dimensions").get_to(info.dimensions);
         j.at("elements_names").get_to(info.elements_names);
         j.at("units_of_measure").get_to(info.units_of_measure);
+        // Optional, for compatibility with the configuration files written before their introduction
+        info.lock_free = j.value("lock_free", false);
+        info.clock_group = j.value("clock_group", std::string());
+        info.codec = j.value("codec", ChannelCodec::None);
+        info.sampling_period = j.value("sampling_period", 0.0);
+        info.decimation = j.value("decimation", size_t{ 1 });
+        info.decimation_filter = j.value("decimation_filter", false);
+        info.on_change = j.value("on_change", false);
+        info.deadband = j.value("deadband", 0.0);
+        info.statistics = j.value("statistics", false);
+        info.retention = j.value("retention", 0.0);
+        info.overflow_policy = j.value("overflow_policy", OverflowPolicy::OverwriteOldest);
     }
 
     // This expects that the name of the json keyword is the same of the relative variable
-    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(BufferConfig, yarp_robot_name, description_list, path, filename, n_samples, save_period, data_threshold, auto_save, save_periodically, channels, enable_compression, file_indexing, mat_file_version)
+    void to_json(nlohmann::json& j, const BufferConfig& config)
+    {
+        j = nlohmann::json{ {"yarp_robot_name", config.yarp_robot_name},
+                            {"description_list", config.description_list},
+                            {"path", config.path},
+                            {"filename", config.filename},
+                            {"n_samples", config.n_samples},
+                            {"save_period", config.save_period},
+                            {"data_threshold", config.data_threshold},
+                            {"auto_save", config.auto_save},
+                            {"save_periodically", config.save_periodically},
+                            {"channels", config.channels},
+                            {"enable_compression", config.enable_compression},
+                            {"file_indexing", config.file_indexing},
+                            {"mat_file_version", config.mat_file_version},
+                            {"save_threads", config.save_threads},
+                            {"append_to_file", config.append_to_file},
+                            {"save_format", config.save_format},
+                            {"memory_mapped_path", config.memory_mapped_path},
+                            {"flight_recorder_path", config.flight_recorder_path},
+                            {"emergency_dump_path", config.emergency_dump_path},
+                            {"implicit_timestamps", config.implicit_timestamps},
+                            {"implicit_timestamps_tolerance", config.implicit_timestamps_tolerance},
+                            {"trigger_pre_duration", config.trigger_pre_duration},
+                            {"trigger_post_duration", config.trigger_post_duration},
+                            {"memory_budget", config.memory_budget},
+                            {"flush_watermark", config.flush_watermark},
+                            {"save_watermark", config.save_watermark},
+                            {"adaptive_save_period", config.adaptive_save_period} };
+    }
+
+    void from_json(const nlohmann::json& j, BufferConfig& config)
+    {
+        j.at("yarp_robot_name").get_to(config.yarp_robot_name);
+        j.at("description_list").get_to(config.description_list);
+        j.at("path").get_to(config.path);
+        j.at("filename").get_to(config.filename);
+        j.at("n_samples").get_to(config.n_samples);
+        j.at("save_period").get_to(config.save_period);
+        j.at("data_threshold").get_to(config.data_threshold);
+        j.at("auto_save").get_to(config.auto_save);
+        j.at("save_periodically").get_to(config.save_periodically);
+        j.at("channels").get_to(config.channels);
+        j.at("enable_compression").get_to(config.enable_compression);
+        j.at("file_indexing").get_to(config.file_indexing);
+        j.at("mat_file_version").get_to(config.mat_file_version);
+        // Optional, for compatibility with the configuration files written before their introduction
+        config.save_threads = j.value("save_threads", BufferConfig().save_threads);
+        config.append_to_file = j.value("append_to_file", BufferConfig().append_to_file);
+        config.save_format = j.value("save_format", BufferConfig().save_format);
+        config.memory_mapped_path = j.value("memory_mapped_path", BufferConfig().memory_mapped_path);
+        config.flight_recorder_path = j.value("flight_recorder_path", BufferConfig().flight_recorder_path);
+        config.emergency_dump_path = j.value("emergency_dump_path", BufferConfig().emergency_dump_path);
+        config.implicit_timestamps = j.value("implicit_timestamps", BufferConfig().implicit_timestamps);
+        config.implicit_timestamps_tolerance = j.value("implicit_timestamps_tolerance", BufferConfig().implicit_timestamps_tolerance);
+        config.trigger_pre_duration = j.value("trigger_pre_duration", BufferConfig().trigger_pre_duration);
+        config.trigger_post_duration = j.value("trigger_post_duration", BufferConfig().trigger_post_duration);
+        config.memory_budget = j.value("memory_budget", BufferConfig().memory_budget);
+        config.flush_watermark = j.value("flush_watermark", BufferConfig().flush_watermark);
+        config.save_watermark = j.value("save_watermark", BufferConfig().save_watermark);
+        config.adaptive_save_period = j.value("adaptive_save_period", BufferConfig().adaptive_save_period);
+    }
 }
 bool bufferConfigFromJson(robometry::BufferConfig& bufferConfig, const std::string& config_filename) {
     // read a JSON file
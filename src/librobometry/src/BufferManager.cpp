@@ -8,6 +8,13 @@
 
 #include <robometry/BufferManager.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <matio.h>
+
 robometry::BufferManager::BufferManager() {
     m_tree = std::make_shared<TreeNode<BufferInfo>>();
 }
@@ -21,6 +28,7 @@ robometry::BufferManager::BufferManager(const BufferConfig &_bufferConfig) {
 }
 
 robometry::BufferManager::~BufferManager() {
+    m_emergency_dump.close();
     if (m_save_thread.joinable()) {
         // This additional brackets are needed for make unique_lock out of scope before the join
         {
@@ -30,6 +38,16 @@ robometry::BufferManager::~BufferManager() {
         }
         m_save_thread.join();
     }
+    if (m_capture_thread.joinable()) {
+        {
+            std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+            m_stop_captures = true;
+        }
+        m_captures_cv.notify_one();
+        m_capture_thread.join();
+    }
+    // The pending captures are written with the samples collected so far
+    completeCaptures(true);
     if (m_bufferConfig.auto_save) {
         std::string fileName;
         saveToFile(fileName);
@@ -38,17 +56,39 @@ robometry::BufferManager::~BufferManager() {
             m_saveCallback(fileName, SaveCallbackSaveMethod::last_call);
         }
     }
+    if (!m_flight_recorder_directory.empty()) {
+        // The rings are unmapped before removing the session, since on Windows the mapped files cannot be removed
+        Leaves leaves;
+        for (auto& [node_name, node] : m_tree->getChildren()) {
+            collectLeaves(node_name, node_name, node, leaves);
+        }
+        for (auto& leaf : leaves) {
+            leaf.buffer_info->m_flight_recorder.close();
+        }
+        for (auto& [frame_name, frame] : m_frames) {
+            frame->m_flight_recorder.close();
+        }
+        std::error_code ec;
+        robometry_fs::remove_all(m_flight_recorder_directory, ec);
+    }
 }
 
 bool robometry::BufferManager::enablePeriodicSave(double _save_period) {
-    // If it is not joinable means it is not running
-    if (!m_save_thread.joinable()) {
-        m_bufferConfig.save_periodically = true;
-        m_bufferConfig.save_period = _save_period;
+    std::scoped_lock<std::mutex> lock{ m_mutex_cv };
+    if (m_periodic_save) {
+        return false;
+    }
+    m_periodic_save = true;
+    m_bufferConfig.save_periodically = true;
+    m_bufferConfig.save_period = _save_period;
+    // If it is joinable, it has been started for the flushes and it becomes periodic
+    if (m_save_thread.joinable()) {
+        m_cv.notify_one();
+    }
+    else {
         m_save_thread = std::thread(&BufferManager::periodicSave, this);
-        return true;
     }
-    return false;
+    return true;
 }
 
 bool robometry::BufferManager::configure(const BufferConfig &_bufferConfig) {
@@ -58,11 +98,47 @@ bool robometry::BufferManager::configure(const BufferConfig &_bufferConfig) {
         std::cout << "The filename cannot be empty." << std::endl;
         return false;
     }
+    if (_bufferConfig.save_format == SaveFormat::Mat && _bufferConfig.append_to_file &&
+        _bufferConfig.mat_file_version != matioCpp::FileVersion::MAT7_3)
+    {
+        std::cout << "The samples can be appended to the file only if the mat_file_version is v7_3." << std::endl;
+        return false;
+    }
     set_capacity(_bufferConfig.n_samples);
     m_bufferConfig = _bufferConfig;
+    const size_t save_threads = _bufferConfig.save_threads == 0 ? std::thread::hardware_concurrency() : _bufferConfig.save_threads;
+    if (save_threads <= 1) {
+        m_save_thread_pool.reset();
+    }
+    else if (!m_save_thread_pool || m_save_thread_pool->size() != save_threads) {
+        m_save_thread_pool = std::make_unique<ThreadPool>(save_threads);
+    }
+    if (m_bufferConfig.trigger_pre_duration > 0.0 && !m_capture_history) {
+        m_capture_history = std::make_shared<Capture>();
+        m_capture_history->start_time = -std::numeric_limits<double>::infinity();
+        m_capture_history->end_time = std::numeric_limits<double>::infinity();
+    }
+    if (!m_bufferConfig.flight_recorder_path.empty() && m_flight_recorder_directory.empty()) {
+        const auto directory = robometry_fs::path(m_bufferConfig.flight_recorder_path) / (m_bufferConfig.filename + "_" + fileIndex());
+        if (!createFlightRecorderSession(directory.string(), m_bufferConfig)) {
+            return false;
+        }
+        m_flight_recorder_directory = directory.string();
+    }
+    if (!m_bufferConfig.emergency_dump_path.empty() && !m_emergency_dump.isOpen()) {
+        std::error_code ec;
+        robometry_fs::create_directories(m_bufferConfig.emergency_dump_path, ec);
+        const auto file_name = robometry_fs::path(m_bufferConfig.emergency_dump_path) /
+                               (m_bufferConfig.filename + "_" + fileIndex() + "_emergency_dump.rblog");
+        if (!m_emergency_dump.open(file_name.string(), m_bufferConfig)) {
+            return false;
+        }
+    }
     if (!_bufferConfig.channels.empty()) {
         ok = ok && addChannels(_bufferConfig.channels);
     }
+    // The channels are empty, the ones added later are accounted at the next save
+    rebalanceMemory();
     if (ok && _bufferConfig.save_periodically) {
         ok = ok && enablePeriodicSave(_bufferConfig.save_period);
     }
@@ -75,6 +151,14 @@ bool robometry::BufferManager::configure(const BufferConfig &_bufferConfig) {
             return false;
         }
     }
+    if (!m_bufferConfig.memory_mapped_path.empty() && !robometry_fs::exists(m_bufferConfig.memory_mapped_path)) {
+        std::error_code ec;
+        auto dir_created = robometry_fs::create_directories(m_bufferConfig.memory_mapped_path, ec);
+        if (!dir_created) {
+            std::cout << m_bufferConfig.memory_mapped_path << " does not exists, and it was not possible to create it." << std::endl;
+            return false;
+        }
+    }
     // TODO ROLL BACK IN CASE OF FAILURE
     return ok;
 }
@@ -83,6 +167,73 @@ robometry::BufferConfig robometry::BufferManager::getBufferConfig() const {
     return m_bufferConfig;
 }
 
+std::string robometry::BufferManager::getFlightRecorderDirectory() const {
+    return m_flight_recorder_directory;
+}
+
+bool robometry::BufferManager::getStatistics(const std::string& var_name, ChannelStatistics& statistics) const {
+    auto leaf = getLeaf(var_name, m_tree).lock();
+    if (leaf == nullptr || leaf->getValue() == nullptr) {
+        std::cout << "The channel " << var_name << " does not exist." << std::endl;
+        return false;
+    }
+    const auto& buffInfo = leaf->getValue();
+    if (!buffInfo->m_statistics) {
+        std::cout << "The channel " << var_name << " does not compute its statistics." << std::endl;
+        return false;
+    }
+    return buffInfo->m_statistics->get(buffInfo->m_dimensions, statistics);
+}
+
+bool robometry::BufferManager::trigger(const std::string& name) {
+    return trigger(name, m_nowFunction());
+}
+
+bool robometry::BufferManager::trigger(const std::string& name, double trigger_time) {
+    if (name.empty()) {
+        std::cout << "The name of the trigger cannot be empty." << std::endl;
+        return false;
+    }
+    auto capture = std::make_shared<Capture>();
+    capture->start_time = trigger_time - m_bufferConfig.trigger_pre_duration;
+    capture->end_time = trigger_time + m_bufferConfig.trigger_post_duration;
+    capture->file_name = m_bufferConfig.path + m_bufferConfig.filename + "_" + fileIndex() + "_" + name;
+    capture->content.filename = m_bufferConfig.filename;
+    capture->content.yarp_robot_name = m_bufferConfig.yarp_robot_name;
+    capture->content.description_list = m_bufferConfig.description_list;
+
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        // The samples before the trigger that have been already saved
+        if (m_capture_history) {
+            copyCaptureWindow(*m_capture_history, *capture);
+        }
+        // Published before collecting, so that the samples detached in the meantime are collected as well
+        m_captures.push_back(capture);
+        ++m_pending_captures;
+        if (!m_capture_thread.joinable()) {
+            m_capture_thread = std::thread(&BufferManager::captureThread, this);
+        }
+    }
+    // The samples before the trigger are copied now, the following ones are copied by the producers as they are pushed
+    collectAll(*capture);
+    reserveCapture(*capture);
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        m_captures_wake = true;
+    }
+    m_captures_cv.notify_one();
+    return true;
+}
+
+size_t robometry::BufferManager::pendingCaptures() const {
+    return m_pending_captures.load();
+}
+
+bool robometry::BufferManager::emergencyDump() {
+    return m_emergency_dump.dump();
+}
+
 void robometry::BufferManager::setFileName(const std::string &filename) {
     m_bufferConfig.filename = filename;
     return;
@@ -106,20 +257,85 @@ void robometry::BufferManager::setDescriptionList(const std::vector<std::string>
 
 void robometry::BufferManager::resize(size_t new_size) {
     this->resize(new_size, m_tree);
+    for (auto& [frame_name, frame] : m_frames) {
+        frame->m_timestamps.resize(new_size);
+    }
     m_bufferConfig.n_samples = new_size;
     return;
 }
 
 void robometry::BufferManager::set_capacity(size_t new_size) {
     this->set_capacity(new_size, m_tree);
+    for (auto& [frame_name, frame] : m_frames) {
+        frame->m_timestamps.set_capacity(new_size);
+    }
     m_bufferConfig.n_samples = new_size;
     return;
 }
 
 bool robometry::BufferManager::addChannel(const ChannelInfo &channel) {
+    if (channel.decimation == 0) {
+        std::cout << "Failed to add channel " << channel.name << ". The decimation factor has to be at least 1." << std::endl;
+        return false;
+    }
+    if (!(channel.deadband >= 0.0)) {
+        std::cout << "Failed to add channel " << channel.name << ". The deadband cannot be negative." << std::endl;
+        return false;
+    }
+    if (!(channel.retention >= 0.0)) {
+        std::cout << "Failed to add channel " << channel.name << ". The retention cannot be negative." << std::endl;
+        return false;
+    }
+    if (channel.retention > 0.0 && channel.lock_free) {
+        // The producer of a lock-free channel cannot remove the old samples, only the consumer can
+        std::cout << "Failed to add channel " << channel.name << ". A lock-free channel cannot have a retention." << std::endl;
+        return false;
+    }
+    size_t capacity = m_bufferConfig.n_samples;
+    // The stored samples are decimated, hence their period is longer than the one of the pushed samples
+    const double stored_period = channel.sampling_period * static_cast<double>(channel.decimation);
+    if (channel.retention > 0.0 && stored_period > 0.0) {
+        // The samples of the retention at the nominal rate, plus 25% for the jitter of the timestamps. The capacity is
+        // not changed afterwards, hence it is estimated with 8 bytes per element for respecting the budget.
+        const double samples = std::ceil(1.25 * channel.retention / stored_period);
+        const size_t sample_bytes = sizeof(double) * (1 + std::accumulate(channel.dimensions.begin(), channel.dimensions.end(),
+                                                                          size_t{ 1 }, std::multiplies<>()));
+        const size_t max_samples = m_bufferConfig.memory_budget > 0 ? m_bufferConfig.memory_budget / sample_bytes
+                                                                    : std::numeric_limits<size_t>::max();
+        capacity = samples < static_cast<double>(max_samples) ? static_cast<size_t>(samples) : max_samples;
+        capacity = std::max<size_t>(capacity, 1);
+    }
     auto buffInfo = std::make_shared<BufferInfo>();
     buffInfo->m_buffer = Buffer(m_bufferConfig.n_samples);
+    buffInfo->m_contiguous_buffer = ContiguousBuffer(capacity);
+    buffInfo->m_contiguous_buffer.setLockFree(channel.lock_free);
+    buffInfo->m_contiguous_buffer.setMappedStorage(m_bufferConfig.memory_mapped_path);
     buffInfo->m_dimensions = channel.dimensions;
+    buffInfo->m_name = channel.name;
+    buffInfo->m_codec = channel.codec;
+    buffInfo->m_sampling_period = stored_period;
+    buffInfo->m_decimator = Decimator(channel.decimation, channel.decimation_filter);
+    buffInfo->m_deadband = Deadband(channel.on_change, channel.deadband);
+    buffInfo->m_retention = channel.retention;
+    buffInfo->m_overflow_policy = channel.overflow_policy;
+    buffInfo->m_contiguous_buffer.setDropWhenFull(channel.overflow_policy == OverflowPolicy::DropNewest);
+    if (channel.overflow_policy == OverflowPolicy::Flush) {
+        buffInfo->m_watermark = m_bufferConfig.flush_watermark;
+        buffInfo->m_request_save = [this]() { requestSave(m_flush_requested); };
+    }
+    else if (m_bufferConfig.save_watermark > 0.0) {
+        buffInfo->m_watermark = m_bufferConfig.save_watermark;
+        buffInfo->m_request_save = [this]() { requestSave(m_save_requested); };
+    }
+    if (channel.statistics) {
+        buffInfo->m_statistics = std::make_unique<OnlineStatistics>();
+    }
+    if (m_emergency_dump.isOpen()) {
+        buffInfo->m_emergency_dump = &m_emergency_dump;
+    }
+    if (!m_flight_recorder_directory.empty()) {
+        buffInfo->m_flight_recorder_file = flightRecorderRingFileName("channel");
+    }
 
     buffInfo->m_dimensions_factorial = std::accumulate(channel.dimensions.begin(),
                                                        channel.dimensions.end(),
@@ -132,6 +348,9 @@ bool robometry::BufferManager::addChannel(const ChannelInfo &channel) {
     const bool ok = addLeaf(channel.name, buffInfo, m_tree);
     if(ok) {
         m_bufferConfig.channels.push_back(channel);
+        if (channel.overflow_policy == OverflowPolicy::Flush) {
+            startFlushThread();
+        }
     }
     else {
         std::cout << "Failed to add channel " << channel.name << std::endl;
@@ -144,12 +363,390 @@ bool robometry::BufferManager::addChannels(const std::vector<ChannelInfo> &chann
         return false;
     }
     bool ret{ true };
+    // The names of the channels of each clock group, in order of appearance
+    std::vector<std::pair<std::string, std::vector<std::string>>> clock_groups;
     for (const auto& c : channels) {
         ret = ret && addChannel(c);
+        if (!c.clock_group.empty()) {
+            auto group = std::find_if(clock_groups.begin(), clock_groups.end(),
+                                      [&c](const auto& g) { return g.first == c.clock_group; });
+            if (group == clock_groups.end()) {
+                clock_groups.push_back({ c.clock_group, {} });
+                group = std::prev(clock_groups.end());
+            }
+            group->second.push_back(c.name);
+        }
+    }
+    for (const auto& [group_name, channel_names] : clock_groups) {
+        ret = ret && addFrame(group_name, channel_names);
     }
     return ret;
 }
 
+robometry::ChannelHandle robometry::BufferManager::getChannelHandle(const std::string& var_name) const {
+    auto leaf = getLeaf(var_name, m_tree).lock();
+    if (leaf == nullptr || leaf->getValue() == nullptr) {
+        return ChannelHandle();
+    }
+    return ChannelHandle(leaf->getValue(), var_name);
+}
+
+bool robometry::BufferManager::addFrame(const std::string& frame_name, const std::vector<std::string>& channel_names) {
+    if (m_frames.find(frame_name) != m_frames.end()) {
+        std::cout << "The frame " << frame_name << " already exists." << std::endl;
+        return false;
+    }
+    if (channel_names.empty()) {
+        std::cout << "The frame " << frame_name << " does not contain any channel." << std::endl;
+        return false;
+    }
+
+    auto frame = std::make_shared<FrameInfo>();
+    frame->m_name = frame_name;
+    frame->m_timestamps = ContiguousBuffer(m_bufferConfig.n_samples);
+    frame->m_timestamps.setStoreTimestamps(false);
+    frame->m_timestamps.setMappedStorage(m_bufferConfig.memory_mapped_path);
+    if (!m_flight_recorder_directory.empty()) {
+        frame->m_flight_recorder_file = flightRecorderRingFileName("clock_group");
+    }
+    for (const auto& channel_name : channel_names) {
+        auto leaf = getLeaf(channel_name, m_tree).lock();
+        if (leaf == nullptr || leaf->getValue() == nullptr) {
+            std::cout << "Failed to add frame " << frame_name << ". The channel " << channel_name << " does not exist." << std::endl;
+            return false;
+        }
+        auto buffInfo = leaf->getValue();
+        if (buffInfo->m_frame != nullptr ||
+            std::find(frame->m_channels.begin(), frame->m_channels.end(), buffInfo) != frame->m_channels.end()) {
+            std::cout << "Failed to add frame " << frame_name << ". The channel " << channel_name << " already belongs to a frame." << std::endl;
+            return false;
+        }
+        if (buffInfo->m_type_index != typeid(void)) {
+            std::cout << "Failed to add frame " << frame_name << ". The channel " << channel_name << " has already been pushed." << std::endl;
+            return false;
+        }
+        if (buffInfo->m_decimator.enabled() || buffInfo->m_deadband.enabled() ||
+            buffInfo->m_overflow_policy == OverflowPolicy::DropNewest) {
+            // The channels of a frame share the timestamps, hence they cannot drop samples independently
+            std::cout << "Failed to add frame " << frame_name << ". The channel " << channel_name << " drops some of its samples." << std::endl;
+            return false;
+        }
+        if (buffInfo->m_retention > 0.0) {
+            // The capacity of the channels of a frame is the one of its timestamps
+            std::cout << "Failed to add frame " << frame_name << ". The channel " << channel_name << " has a retention." << std::endl;
+            return false;
+        }
+        frame->m_channels.push_back(buffInfo);
+        frame->m_channel_names.push_back(channel_name);
+    }
+
+    // The channels are modified only once we know that all of them can be added to the frame
+    for (size_t i = 0; i < frame->m_channels.size(); ++i) {
+        auto& buffInfo = frame->m_channels[i];
+        buffInfo->m_frame = frame.get();
+        buffInfo->m_frame_index = i;
+        // The frame mutex synchronizes producer and consumers, and the timestamps are stored by the frame
+        buffInfo->m_contiguous_buffer.setLockFree(false);
+        buffInfo->m_contiguous_buffer.setStoreTimestamps(false);
+    }
+    frame->m_staged.resize(frame->m_channels.size());
+    frame->m_emergency_dump_entry = m_emergency_dump.addClockGroup(frame_name, frame->m_timestamps);
+    m_frames[frame_name] = frame;
+    return true;
+}
+
+robometry::FrameHandle robometry::BufferManager::getFrameHandle(const std::string& frame_name) const {
+    auto frame = m_frames.find(frame_name);
+    if (frame == m_frames.end()) {
+        return FrameHandle();
+    }
+    return FrameHandle(frame->second, frame_name);
+}
+
+void robometry::BufferManager::push_back(const FrameHandle& frame, double ts) {
+    if (!frame.isValid()) {
+        throw std::invalid_argument("The frame handle is not valid.");
+    }
+
+    auto& frameInfo = *frame.m_frame_info;
+    std::scoped_lock<std::mutex> lock{ frameInfo.m_mutex };
+
+    // Nothing is pushed if a sample is missing or has the wrong type, otherwise the channels would not be aligned anymore
+    bool ok{ true };
+    for (size_t i = 0; i < frameInfo.m_channels.size(); ++i) {
+        const auto& staged = frameInfo.m_staged[i];
+        const auto& buffInfo = frameInfo.m_channels[i];
+        if (staged.elem == nullptr) {
+            std::cout << "Cannot push the frame " << frame.m_name << ". The sample of the channel "
+                      << frameInfo.m_channel_names[i] << " has not been set." << std::endl;
+            ok = false;
+        }
+        else if (buffInfo->m_type_index != typeid(void) && buffInfo->m_type_index != staged.type) {
+            std::cout << "Cannot push the frame " << frame.m_name << ". Channel: " << frameInfo.m_channel_names[i]
+                      << ". Expected type: " << buffInfo->m_type_name
+                      << ". Input type: " << staged.type_name() << std::endl;
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        if (!frameInfo.m_timestamps.initialized()) {
+            frameInfo.m_timestamps.initialize(sizeof(double));
+            if (!frameInfo.m_flight_recorder_file.empty()) {
+                BinaryLogChannelSchema schema;
+                schema.name = frameInfo.m_name;
+                schema.dimensions = { 1, 1 };
+                schema.element_type = binaryLogElementType<double>();
+                schema.sample_size = sizeof(double);
+                frameInfo.m_flight_recorder.open(frameInfo.m_flight_recorder_file, FlightRecorderRing::Kind::ClockGroup,
+                                                 schema, frameInfo.m_timestamps.capacity());
+            }
+        }
+        frameInfo.m_timestamps.push_back(&ts, sizeof(double), ts);
+        if (frameInfo.m_flight_recorder.isOpen()) {
+            frameInfo.m_flight_recorder.push_back(&ts, sizeof(double), ts);
+        }
+        for (size_t i = 0; i < frameInfo.m_channels.size(); ++i) {
+            frameInfo.m_staged[i].push(*frameInfo.m_channels[i], frameInfo.m_staged[i].elem);
+        }
+        if (m_pending_captures.load(std::memory_order_relaxed) > 0) {
+            collectPushed(frameInfo);
+        }
+    }
+
+    for (auto& staged : frameInfo.m_staged) {
+        staged = FrameInfo::StagedSample();
+    }
+}
+
+void robometry::BufferManager::push_back(const FrameHandle& frame) {
+    push_back(frame, m_nowFunction());
+}
+
+bool robometry::BufferManager::getChannelCounters(const std::string& var_name, ChannelCounters& counters) const {
+    auto leaf = getLeaf(var_name, m_tree).lock();
+    if (leaf == nullptr || leaf->getValue() == nullptr) {
+        std::cout << "The channel " << var_name << " does not exist." << std::endl;
+        return false;
+    }
+    auto buffInfo = leaf->getValue();
+    std::scoped_lock<std::mutex> lock{ buffInfo->mutex() };
+    counters.overwritten = buffInfo->overwrittenSamples();
+    counters.dropped = buffInfo->droppedSamples();
+    return true;
+}
+
+robometry::SaveCounters robometry::BufferManager::getSaveCounters() const {
+    std::scoped_lock<std::mutex> lock{ m_save_counters_mutex };
+    return m_save_counters;
+}
+
+bool robometry::BufferManager::rebalanceMemory() {
+    if (m_bufferConfig.memory_budget == 0) {
+        return false;
+    }
+    std::scoped_lock<std::mutex> rebalance_lock{ m_memory_mutex };
+    const double now = m_nowFunction();
+    const double elapsed = now - m_last_rebalance_time; // NaN at the first rebalance
+    m_last_rebalance_time = now;
+
+    // The channels outside the frames, and the frames as a whole since all their buffers must have the same capacity
+    struct MemoryUnit {
+        std::mutex* mutex{ nullptr };
+        std::vector<BufferInfo*> channels;
+        ContiguousBuffer* timestamps{ nullptr }; // The timestamps of the frame, nullptr for a single channel
+        size_t sample_bytes{ 0 };
+        size_t capacity{ 0 };
+        size_t new_capacity{ 0 };
+        bool resize{ false };
+        double rate{ 0.0 };
+    };
+
+    // The bytes of a sample, estimated with 8 bytes per element if the channel has not been pushed yet
+    auto sampleBytes = [](const BufferInfo& buffInfo) {
+        const auto& buffer = buffInfo.m_contiguous_buffer;
+        const size_t data = buffer.initialized() ? buffer.sampleSize() : sizeof(double) * buffInfo.m_dimensions_factorial;
+        return data + (buffer.storeTimestamps() ? sizeof(double) : 0);
+    };
+    // The rate is measured on the samples stored since the last rebalance, and smoothed with the previous one
+    auto updateRate = [elapsed](BufferInfo& buffInfo) {
+        const size_t stored = std::exchange(buffInfo.m_stored_samples, 0);
+        if (elapsed > 0.0) {
+            const double rate = static_cast<double>(stored) / elapsed;
+            buffInfo.m_store_rate = buffInfo.m_store_rate > 0.0 ? 0.5 * (buffInfo.m_store_rate + rate) : rate;
+        }
+        return buffInfo.m_store_rate;
+    };
+
+    std::vector<MemoryUnit> units;
+    size_t fixed_bytes{ 0 };
+    Leaves leaves;
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        collectLeaves(node_name, node_name, node, leaves);
+    }
+    for (auto& leaf : leaves) {
+        auto& buffInfo = *leaf.buffer_info;
+        if (buffInfo.m_frame != nullptr) {
+            continue;
+        }
+        std::scoped_lock<std::mutex> lock{ buffInfo.m_buff_mutex };
+        if (buffInfo.m_type_index != typeid(void) && !buffInfo.m_use_contiguous_buffer) {
+            continue;
+        }
+        if (buffInfo.m_lock_free_ready) {
+            // The producer does not lock the channel, hence its storage cannot be changed
+            fixed_bytes += buffInfo.m_contiguous_buffer.memoryUsage();
+            continue;
+        }
+        if (buffInfo.m_retention > 0.0) {
+            // The capacity is computed from the retention, see BufferInfo::adaptRetentionCapacity
+            fixed_bytes += buffInfo.m_contiguous_buffer.capacity() * sampleBytes(buffInfo);
+            continue;
+        }
+        MemoryUnit unit;
+        unit.mutex = &buffInfo.m_buff_mutex;
+        unit.channels.push_back(&buffInfo);
+        unit.sample_bytes = sampleBytes(buffInfo);
+        unit.capacity = buffInfo.m_contiguous_buffer.capacity();
+        unit.rate = updateRate(buffInfo);
+        units.push_back(std::move(unit));
+    }
+    for (auto& [frame_name, frame] : m_frames) {
+        std::scoped_lock<std::mutex> lock{ frame->m_mutex };
+        MemoryUnit unit;
+        unit.mutex = &frame->m_mutex;
+        unit.timestamps = &frame->m_timestamps;
+        unit.sample_bytes = sizeof(double);
+        unit.capacity = frame->m_timestamps.capacity();
+        bool numeric{ true };
+        for (const auto& buffInfo : frame->m_channels) {
+            numeric = numeric && (buffInfo->m_type_index == typeid(void) || buffInfo->m_use_contiguous_buffer);
+            unit.channels.push_back(buffInfo.get());
+            unit.sample_bytes += sampleBytes(*buffInfo);
+        }
+        // All the channels of the frame store the same samples, the first one measures the rate
+        unit.rate = updateRate(*frame->m_channels.front());
+        if (!numeric) {
+            // The other channels keep n_samples, hence the frame cannot change its capacity
+            for (const auto& buffInfo : frame->m_channels) {
+                fixed_bytes += buffInfo->m_contiguous_buffer.memoryUsage();
+            }
+            fixed_bytes += frame->m_timestamps.memoryUsage();
+            continue;
+        }
+        units.push_back(std::move(unit));
+    }
+    // Small changes are skipped, since the storage is reallocated
+    auto significant = [](const MemoryUnit& unit) {
+        const size_t difference = unit.new_capacity > unit.capacity ? unit.new_capacity - unit.capacity : unit.capacity - unit.new_capacity;
+        return unit.capacity == 0 || difference * 10 > unit.capacity;
+    };
+
+    if (!units.empty()) {
+        // All the units hold the same time span, the ones that did not store samples get the rate of the slowest one.
+        // If no rate has been observed yet, the budget is split as if all the rates were the same.
+        const size_t budget = m_bufferConfig.memory_budget > fixed_bytes ? m_bufferConfig.memory_budget - fixed_bytes : 0;
+        double min_rate = std::numeric_limits<double>::infinity();
+        for (const auto& unit : units) {
+            if (unit.rate > 0.0) {
+                min_rate = std::min(min_rate, unit.rate);
+            }
+        }
+        if (std::isinf(min_rate)) {
+            min_rate = 1.0;
+        }
+        double bytes_per_second{ 0.0 };
+        for (const auto& unit : units) {
+            bytes_per_second += std::max(unit.rate, min_rate) * static_cast<double>(unit.sample_bytes);
+        }
+        const double time_span = static_cast<double>(budget) / bytes_per_second;
+
+        // The shrinks that are skipped are applied anyway if they are needed to respect the budget
+        size_t total_bytes{ 0 };
+        for (auto& unit : units) {
+            unit.new_capacity = std::max<size_t>(static_cast<size_t>(time_span * std::max(unit.rate, min_rate)), 1);
+            unit.resize = significant(unit);
+            total_bytes += (unit.resize ? unit.new_capacity : unit.capacity) * unit.sample_bytes;
+        }
+        for (auto& unit : units) {
+            if (total_bytes <= budget) {
+                break;
+            }
+            if (!unit.resize && unit.new_capacity < unit.capacity) {
+                unit.resize = true;
+                total_bytes -= (unit.capacity - unit.new_capacity) * unit.sample_bytes;
+            }
+        }
+    }
+
+    for (auto& unit : units) {
+        if (!unit.resize || unit.new_capacity == unit.capacity) {
+            continue;
+        }
+        std::scoped_lock<std::mutex> lock{ *unit.mutex };
+        // set_capacity keeps the oldest samples, hence the ones exceeding the new capacity are overwritten before
+        auto shrink = [&unit](BufferInfo& buffInfo) {
+            auto& buffer = buffInfo.m_contiguous_buffer;
+            if (buffer.size() > unit.new_capacity) {
+                buffer.discardOldest(buffer.size() - unit.new_capacity);
+            }
+            buffInfo.set_capacity(unit.new_capacity);
+        };
+        if (unit.timestamps != nullptr) {
+            if (unit.timestamps->size() > unit.new_capacity) {
+                unit.timestamps->discardOldest(unit.timestamps->size() - unit.new_capacity);
+            }
+            unit.timestamps->set_capacity(unit.new_capacity);
+            for (auto* buffInfo : unit.channels) {
+                shrink(*buffInfo);
+            }
+        }
+        else {
+            // The channel may have been pushed since it was measured, and then it may have become non-numeric,
+            // or lock-free, in which case the producer does not lock the channel and its storage cannot be changed
+            auto& buffInfo = *unit.channels.front();
+            if (buffInfo.m_lock_free_ready || (buffInfo.m_type_index != typeid(void) && !buffInfo.m_use_contiguous_buffer)) {
+                continue;
+            }
+            shrink(buffInfo);
+        }
+    }
+    return true;
+}
+
+bool robometry::BufferManager::getMemoryUsage(const std::string& var_name, size_t& bytes) const {
+    auto leaf = getLeaf(var_name, m_tree).lock();
+    if (leaf == nullptr || leaf->getValue() == nullptr) {
+        std::cout << "The channel " << var_name << " does not exist." << std::endl;
+        return false;
+    }
+    auto buffInfo = leaf->getValue();
+    std::scoped_lock<std::mutex> lock{ buffInfo->mutex() };
+    if (buffInfo->m_type_index != typeid(void) && !buffInfo->m_use_contiguous_buffer) {
+        std::cout << "The channel " << var_name << " does not contain numeric data." << std::endl;
+        return false;
+    }
+    bytes = buffInfo->m_contiguous_buffer.memoryUsage();
+    return true;
+}
+
+size_t robometry::BufferManager::getMemoryUsage() const {
+    size_t bytes{ 0 };
+    Leaves leaves;
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        collectLeaves(node_name, node_name, node, leaves);
+    }
+    for (auto& leaf : leaves) {
+        std::scoped_lock<std::mutex> lock{ leaf.buffer_info->mutex() };
+        bytes += leaf.buffer_info->m_contiguous_buffer.memoryUsage();
+    }
+    for (const auto& [frame_name, frame] : m_frames) {
+        std::scoped_lock<std::mutex> lock{ frame->m_mutex };
+        bytes += frame->m_timestamps.memoryUsage();
+    }
+    return bytes;
+}
+
 bool robometry::BufferManager::saveToFile(bool flush_all) {
     std::string dummy_file_name;
     return saveToFile(dummy_file_name, flush_all);
@@ -157,6 +754,24 @@ bool robometry::BufferManager::saveToFile(bool flush_all) {
 
 bool robometry::BufferManager::saveToFile(std::string &file_name_path, bool flush_all) {
 
+    // we have to force the flush.
+    flush_all = flush_all || (m_bufferConfig.data_threshold > m_bufferConfig.n_samples);
+    bool ok{ false };
+    if (m_bufferConfig.save_format == SaveFormat::BinaryLog) {
+        ok = writeBinaryLog(file_name_path, flush_all);
+    }
+    else if (m_bufferConfig.append_to_file) {
+        ok = appendToFile(file_name_path, flush_all);
+    }
+    else {
+        ok = writeMatFile(file_name_path, flush_all);
+    }
+    // The channels have just been emptied, hence their capacity can be changed losing few samples, if any
+    rebalanceMemory();
+    return ok;
+}
+
+bool robometry::BufferManager::writeMatFile(std::string &file_name_path, bool flush_all) {
     // now we initialize the proto-timeseries structure
     std::vector<matioCpp::Variable> signalsVect, descrListVect;
     // and the matioCpp struct for these signals
@@ -167,12 +782,52 @@ bool robometry::BufferManager::saveToFile(std::string &file_name_path, bool flus
 
     signalsVect.emplace_back(matioCpp::String("yarp_robot_name", m_bufferConfig.yarp_robot_name));
 
-    // we have to force the flush.
-    flush_all = flush_all || (m_bufferConfig.data_threshold > m_bufferConfig.n_samples);
+    auto detached_frames = detachFrames(flush_all);
+
+    // The channels are converted independently, possibly in parallel, and then the tree is assembled in order
+    Leaves leaves;
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        collectLeaves(node_name, node_name, node, leaves);
+    }
+    std::vector<matioCpp::Struct> elements(leaves.size());
+    auto convertLeaf = [&](size_t i) {
+        elements[i] = createElementStruct(leaves[i].name, leaves[i].buffer_info, flush_all, detached_frames);
+    };
+    if (m_save_thread_pool) {
+        m_save_thread_pool->parallelFor(leaves.size(), convertLeaf);
+    }
+    else {
+        for (size_t i = 0; i < leaves.size(); ++i) {
+            convertLeaf(i);
+        }
+    }
+
+    size_t next_element{ 0 };
     for (auto& [node_name, node] : m_tree->getChildren()) {
 
         // now we create the vector that stores different signals (in case we had more than one)
-        signalsVect.emplace_back(this->createTreeStruct(node_name, node, flush_all));
+        signalsVect.emplace_back(this->createTreeStruct(node_name, node, elements, next_element));
+    }
+
+    // The timestamps of each frame are saved only once, and its channels refer to them through the clock_group field
+    std::vector<matioCpp::Variable> clockGroupsVect;
+    for (const auto& [frame_name, timestamps] : detached_frames.timestamps) {
+        std::vector<double> frameTimestamps(timestamps.size());
+        timestamps.copyData(frameTimestamps.data());
+        // The sampling period of the clock group is the one of its first channel providing it
+        double sampling_period{ 0.0 };
+        auto frame = m_frames.find(frame_name);
+        if (frame != m_frames.end()) {
+            for (const auto& channel : frame->second->m_channels) {
+                if (sampling_period <= 0.0) {
+                    sampling_period = channel->m_sampling_period;
+                }
+            }
+        }
+        clockGroupsVect.emplace_back(createTimestampsVariable(frame_name, frameTimestamps, sampling_period));
+    }
+    if (!clockGroupsVect.empty()) {
+        signalsVect.emplace_back(matioCpp::Struct("clock_groups", clockGroupsVect));
     }
 
     // This means that no variables are logged, we have only the description_list (if set) and the yarp_robot_name
@@ -229,72 +884,226 @@ double robometry::BufferManager::DefaultClock() {
 
 void robometry::BufferManager::periodicSave()
 {
+    using clock = std::chrono::steady_clock;
+    // The stretched period exceeds the estimated duration of the saves by 25%
+    constexpr double period_headroom{ 1.25 };
+    // The requests of the producers are checked at least this often, since their notifications can be missed
+    constexpr double request_check_period{ 0.1 };
+    auto seconds = [](double value) { return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(value)); };
     std::unique_lock<std::mutex> lk_cv(m_mutex_cv);
 
-    auto timeout =  std::chrono::duration<double>(m_bufferConfig.save_period);
     // For avoiding spurious wake up, the lambda check that the threads wake up only if we are trying to close
-    // (additionally to the timeout expiration)
-    while (!(m_cv.wait_for(lk_cv, timeout, [this](){return m_should_stop_thread;})))
+    // or a save has been requested (additionally to the timeout expiration)
+    auto wake_up = [this]() { return m_should_stop_thread || m_flush_requested.load(); };
+    double save_period{ 0.0 }; // 0 until the periodic save is enabled
+    double period{ 0.0 };
+    double duration_estimate{ 0.0 };
+    clock::time_point deadline;
+    while (true)
     {
-        if (!m_tree->empty()) // if there are channels
+        if (m_periodic_save)
+        {
+            if (save_period == 0.0)
+            {
+                // The schedule starts when the periodic save is enabled, and the deadlines do not depend on the saves
+                save_period = m_bufferConfig.save_period;
+                period = save_period;
+                deadline = clock::now() + seconds(period);
+                std::scoped_lock<std::mutex> lock{ m_save_counters_mutex };
+                m_save_counters.period = period;
+            }
+            const auto now = clock::now();
+            if (now > deadline)
+            {
+                // The next save starts right away for the last deadline expired while saving, the ones before it are missed
+                const auto missed = static_cast<size_t>(std::chrono::duration<double>(now - deadline).count() / period);
+                deadline += seconds(period * static_cast<double>(missed));
+                std::scoped_lock<std::mutex> lock{ m_save_counters_mutex };
+                m_save_counters.missed_deadlines += missed;
+            }
+            // With the watermark, the period is the longest interval between two saves
+            const auto wait_end = std::min(deadline, now + seconds(request_check_period));
+            if (!m_cv.wait_until(lk_cv, wait_end, [&]() { return wake_up() || m_save_requested.load(); }) &&
+                clock::now() < deadline)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            // The thread serves only the flushes, until the periodic save is enabled
+            m_cv.wait_for(lk_cv, seconds(request_check_period), [&]() { return wake_up() || m_periodic_save; });
+            if (!m_flush_requested && !m_should_stop_thread)
+            {
+                continue;
+            }
+        }
+        if (m_should_stop_thread)
+        {
+            break;
+        }
+        const bool flush = m_flush_requested.exchange(false);
+        m_save_requested = false;
+
+        // The producers requesting a save lock the mutex, hence it is released while saving
+        lk_cv.unlock();
+        const auto start = clock::now();
+        const bool at_deadline = save_period > 0.0 && start >= deadline;
+        // With the watermark, the wake ups at the end of the period do not save if there is nothing to save
+        const bool skip = !flush && m_bufferConfig.save_watermark > 0.0 && !hasDataToSave();
+        if (!m_tree->empty() && !skip) // if there are channels
         {
             std::string fileName;
-            saveToFile(fileName, false);
+            saveToFile(fileName, flush);
             if (m_saveCallback)
             {
-                m_saveCallback(fileName, SaveCallbackSaveMethod::periodic);
+                m_saveCallback(fileName, flush ? SaveCallbackSaveMethod::flush : SaveCallbackSaveMethod::periodic);
+            }
+            const double duration = std::chrono::duration<double>(clock::now() - start).count();
+            if (m_bufferConfig.adaptive_save_period && save_period > 0.0)
+            {
+                // The period is stretched at once, and it shrinks gradually
+                duration_estimate = duration > duration_estimate ? duration : 0.5 * (duration_estimate + duration);
+                period = std::max(save_period, period_headroom * duration_estimate);
             }
+            std::scoped_lock<std::mutex> lock{ m_save_counters_mutex };
+            ++m_save_counters.saves;
+            m_save_counters.last_duration = duration;
+            m_save_counters.max_duration = std::max(m_save_counters.max_duration, duration);
+            m_save_counters.period = period;
+        }
+        if (at_deadline)
+        {
+            const double lag = std::chrono::duration<double>(start - deadline).count();
+            deadline += seconds(period);
+            std::scoped_lock<std::mutex> lock{ m_save_counters_mutex };
+            m_save_counters.last_lag = lag;
+            m_save_counters.max_lag = std::max(m_save_counters.max_lag, lag);
         }
+        lk_cv.lock();
     }
 }
 
-matioCpp::Struct robometry::BufferManager::createTreeStruct(const std::string &node_name, std::shared_ptr<TreeNode<BufferInfo> > tree_node, bool flush_all) {
-    const auto& children = tree_node->getChildren();
-    if (children.size() == 0) {
-        return createElementStruct(node_name, tree_node->getValue(), flush_all);
+void robometry::BufferManager::requestSave(std::atomic<bool>& request)
+{
+    // Only the first request after a save wakes up the thread, the following ones are served by the same save.
+    // The producers never wait for the mutex, if the save thread holds it the notification may arrive before it
+    // waits, and in that case the request is noticed by its periodic check, see robometry::BufferManager::periodicSave.
+    if (!request.exchange(true)) {
+        std::unique_lock<std::mutex> lock{ m_mutex_cv, std::try_to_lock };
+        m_cv.notify_one();
     }
+}
 
-    matioCpp::Struct tmp(node_name);
-    for (const auto& [child_name, child] : tree_node->getChildren()) {
-        tmp.setField(this->createTreeStruct(child_name, child, flush_all));
+bool robometry::BufferManager::hasDataToSave() const
+{
+    // As in saveToFile, the threshold is ignored if it cannot be reached
+    const size_t threshold = m_bufferConfig.data_threshold > m_bufferConfig.n_samples ? 1 : std::max<size_t>(m_bufferConfig.data_threshold, 1);
+    Leaves leaves;
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        collectLeaves(node_name, node_name, node, leaves);
     }
-
-    return tmp;
+    for (const auto& leaf : leaves) {
+        if (leaf.buffer_info->m_frame != nullptr) {
+            continue;
+        }
+        std::scoped_lock<std::mutex> lock{ leaf.buffer_info->m_buff_mutex };
+        if (leaf.buffer_info->size() >= threshold) {
+            return true;
+        }
+    }
+    for (const auto& [frame_name, frame] : m_frames) {
+        std::scoped_lock<std::mutex> lock{ frame->m_mutex };
+        if (frame->m_timestamps.size() >= threshold) {
+            return true;
+        }
+    }
+    return false;
 }
 
-matioCpp::Struct robometry::BufferManager::createElementStruct(const std::string &var_name, std::shared_ptr<BufferInfo> buffInfo, bool flush_all) const {
+void robometry::BufferManager::startFlushThread()
+{
+    std::scoped_lock<std::mutex> lock{ m_mutex_cv };
+    if (!m_save_thread.joinable()) {
+        m_save_thread = std::thread(&BufferManager::periodicSave, this);
+    }
+}
 
-    assert(buffInfo);
+robometry::BufferManager::DetachedFrames robometry::BufferManager::detachFrames(bool flush_all) {
+    DetachedFrames detached_frames;
+    for (auto& [frame_name, frame] : m_frames) {
+        // All the channels of the frame are detached at once, so that they stay aligned with the timestamps
+        std::scoped_lock<std::mutex> lock{ frame->m_mutex };
+        collectCaptures(*frame);
+        const size_t num_samples = frame->m_timestamps.size();
+        if (num_samples == 0 || (!flush_all && num_samples < m_bufferConfig.data_threshold)) {
+            continue;
+        }
 
-    std::scoped_lock<std::mutex> lock{ buffInfo->m_buff_mutex };
-    if (buffInfo->m_buffer.empty()) {
-        std::cout << var_name << " does not contain data, skipping" << std::endl;
-        return matioCpp::Struct(var_name);
+        detached_frames.timestamps.emplace_back(frame_name, frame->m_timestamps.detach(num_samples));
+        for (const auto& buffInfo : frame->m_channels) {
+            detached_frames.channels.emplace(buffInfo.get(), buffInfo->detach());
+        }
     }
+    return detached_frames;
+}
 
-    if (!flush_all && buffInfo->m_buffer.size() < m_bufferConfig.data_threshold) {
-        std::cout << var_name << " does not contain enought data, skipping" << std::endl;
+void robometry::BufferManager::collectLeaves(const std::string &node_name, const std::string &node_path, std::shared_ptr<TreeNode<BufferInfo> > tree_node, Leaves& leaves) const {
+    const auto& children = tree_node->getChildren();
+    if (children.size() == 0) {
+        leaves.push_back({ node_name, node_path, tree_node->getValue() });
+        return;
+    }
+
+    for (const auto& [child_name, child] : children) {
+        collectLeaves(child_name, node_path + TreeNode<BufferInfo>::stringSeparator + child_name, child, leaves);
+    }
+}
+
+matioCpp::Struct robometry::BufferManager::createTreeStruct(const std::string &node_name, std::shared_ptr<TreeNode<BufferInfo> > tree_node, const std::vector<matioCpp::Struct>& elements, size_t& next_element) const {
+    const auto& children = tree_node->getChildren();
+    if (children.size() == 0) {
+        assert(next_element < elements.size());
+        return elements[next_element++];
+    }
+
+    matioCpp::Struct tmp(node_name);
+    for (const auto& [child_name, child] : children) {
+        tmp.setField(this->createTreeStruct(child_name, child, elements, next_element));
+    }
+
+    return tmp;
+}
+
+matioCpp::Struct robometry::BufferManager::createElementStruct(const std::string &var_name, std::shared_ptr<BufferInfo> buffInfo, bool flush_all, DetachedFrames& detached_frames) const {
+
+    assert(buffInfo);
+
+    BufferInfo::DetachedSamples samples;
+    if (!detachSamples(var_name, *buffInfo, flush_all, detached_frames, samples)) {
         return matioCpp::Struct(var_name);
     }
 
     // the number of timesteps is the size of our collection
-    auto num_timesteps = buffInfo->m_buffer.size();
+    auto num_timesteps = samples.size;
 
     assert(buffInfo->m_convert_to_matioCpp);
     // We concatenate all the data of the buffer into a single variable
-    matioCpp::Variable data = buffInfo->m_convert_to_matioCpp("data");
+    matioCpp::Variable data = buffInfo->m_convert_to_matioCpp("data", samples);
 
-    //We construct the timestamp vector
-    matioCpp::Vector<double> timestamps("timestamps", num_timesteps);
-    size_t i = 0;
-    for (auto& _cell : buffInfo->m_buffer) {
-        timestamps[i] = _cell.m_ts;
-        ++i;
+    //We construct the timestamp vector, the channels of a frame refer to the timestamps saved in clock_groups instead
+    matioCpp::Variable timestamps;
+    if (buffInfo->m_frame != nullptr) {
+        timestamps = matioCpp::String("clock_group", buffInfo->m_frame->m_name);
+    }
+    else {
+        std::vector<double> timestampsVector(num_timesteps);
+        copyTimestamps(*buffInfo, samples, timestampsVector.data());
+        timestamps = createTimestampsVariable("timestamps", timestampsVector, buffInfo->m_sampling_period);
     }
-    assert(i == buffInfo->m_buffer.size());
 
-    //Clear the buffer, we don't need it anymore
-    buffInfo->m_buffer.clear();
+    //Give back the storage of the saved samples, we don't need them anymore
+    buffInfo->recycle(std::move(samples));
 
     //Create the set of variables to be used in the output struct
     std::vector<matioCpp::Variable> var_data;
@@ -312,9 +1121,765 @@ matioCpp::Struct robometry::BufferManager::createElementStruct(const std::string
     var_data.emplace_back(matioCpp::String("name", var_name)); // name of the signal
     var_data.emplace_back(timestamps);
 
+    // The samples lost since the beginning because the channel was full
+    var_data.emplace_back(matioCpp::make_variable("overwritten_samples", buffInfo->overwrittenSamples()));
+    var_data.emplace_back(matioCpp::make_variable("dropped_samples", buffInfo->droppedSamples()));
+
+    // The statistics of all the samples pushed so far, with the dimensions of a sample
+    ChannelStatistics statistics;
+    if (buffInfo->m_statistics && buffInfo->m_statistics->get(buffInfo->m_dimensions, statistics)) {
+        auto makeField = [&statistics](const std::string& name, const std::vector<double>& values) {
+            matioCpp::MultiDimensionalArray<double> field(name, statistics.dimensions);
+            std::copy(values.begin(), values.end(), field.toSpan().data());
+            return field;
+        };
+        std::vector<matioCpp::Variable> statistics_data;
+        statistics_data.emplace_back(makeField("count", std::vector<double>(statistics.count.begin(), statistics.count.end())));
+        statistics_data.emplace_back(makeField("min", statistics.min));
+        statistics_data.emplace_back(makeField("max", statistics.max));
+        statistics_data.emplace_back(makeField("mean", statistics.mean));
+        statistics_data.emplace_back(makeField("variance", statistics.variance));
+        var_data.emplace_back(matioCpp::Struct("statistics", statistics_data));
+    }
+
     return matioCpp::Struct(var_name, var_data);
 }
 
+matioCpp::Variable robometry::BufferManager::createTimestampsVariable(const std::string& name,
+                                                                    const std::vector<double>& timestamps,
+                                                                    double sampling_period) const {
+    const size_t num_samples = timestamps.size();
+    if (!m_bufferConfig.implicit_timestamps || num_samples < 2) {
+        return matioCpp::Vector<double>(name, matioCpp::make_span(timestamps));
+    }
+
+    double dt = sampling_period;
+    if (dt <= 0.0) {
+        // The median of the intervals is not affected by a few gaps or delayed samples
+        std::vector<double> intervals(num_samples - 1);
+        for (size_t i = 1; i < num_samples; ++i) {
+            intervals[i - 1] = timestamps[i] - timestamps[i - 1];
+        }
+        auto median = intervals.begin() + intervals.size() / 2;
+        std::nth_element(intervals.begin(), median, intervals.end());
+        dt = *median;
+    }
+    if (!std::isfinite(dt) || dt <= 0.0) {
+        return matioCpp::Vector<double>(name, matioCpp::make_span(timestamps));
+    }
+
+    // Each exception takes two values, hence the struct is worth it only if they are less than half of the samples
+    const size_t max_exceptions = (num_samples - 1) / 2;
+    const double tolerance = m_bufferConfig.implicit_timestamps_tolerance * dt;
+    std::vector<double> exceptions_indices;
+    std::vector<double> exceptions_values;
+    size_t grid_index{ 0 };
+    double grid_start = timestamps.front();
+    for (size_t i = 1; i < num_samples && exceptions_indices.size() <= max_exceptions; ++i) {
+        const double expected = grid_start + static_cast<double>(i - grid_index) * dt;
+        // Written so that a NaN timestamp is an exception
+        if (!(std::abs(timestamps[i] - expected) <= tolerance)) {
+            exceptions_indices.push_back(static_cast<double>(i + 1));
+            exceptions_values.push_back(timestamps[i]);
+            grid_index = i;
+            grid_start = timestamps[i];
+        }
+    }
+    if (exceptions_indices.size() > max_exceptions || !std::isfinite(timestamps.front())) {
+        return matioCpp::Vector<double>(name, matioCpp::make_span(timestamps));
+    }
+
+    std::vector<matioCpp::Variable> fields;
+    fields.emplace_back(matioCpp::Element<double>("t0", timestamps.front()));
+    fields.emplace_back(matioCpp::Element<double>("dt", dt));
+    fields.emplace_back(matioCpp::Element<double>("num_samples", static_cast<double>(num_samples)));
+    fields.emplace_back(matioCpp::Vector<double>("exceptions_indices", matioCpp::make_span(exceptions_indices)));
+    fields.emplace_back(matioCpp::Vector<double>("exceptions_values", matioCpp::make_span(exceptions_values)));
+    return matioCpp::Struct(name, fields);
+}
+
+bool robometry::BufferManager::collectCapture(Capture& capture, const BufferInfo& buffInfo) {
+    const auto& buffer = buffInfo.m_contiguous_buffer;
+    if (!buffInfo.m_use_contiguous_buffer || !buffer.initialized() || !buffer.storeTimestamps()) {
+        return false;
+    }
+    std::scoped_lock<std::mutex> lock{ capture.mutex };
+    auto last = capture.last_timestamps.find(&buffInfo);
+    double last_timestamp = last != capture.last_timestamps.end() ? last->second : -std::numeric_limits<double>::infinity();
+    auto position = capture.channels.find(&buffInfo);
+    if (position == capture.channels.end()) {
+        capture.content.channels.push_back({ buffInfo.schema(), {}, {}, 0 });
+        position = capture.channels.emplace(&buffInfo, capture.content.channels.size() - 1).first;
+    }
+    auto& channel = capture.content.channels[position->second];
+    channel.overwritten_samples = buffInfo.overwrittenSamples();
+    channel.dropped_samples = buffInfo.droppedSamples();
+
+    // Only the samples in the window that have not been collected yet are visited
+    const size_t num_samples = buffer.size();
+    const double from = std::max(std::nextafter(last_timestamp, std::numeric_limits<double>::infinity()), capture.start_time);
+    const size_t first = std::min(buffer.countOlderThan(from), num_samples);
+    const size_t sample_size = buffer.sampleSize();
+    bool ended{ false };
+    buffer.visit(first, num_samples - first, [&](const unsigned char* data, const double* timestamps, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            ended = ended || timestamps[i] > capture.end_time;
+            if (timestamps[i] <= last_timestamp || timestamps[i] < capture.start_time || timestamps[i] > capture.end_time) {
+                continue;
+            }
+            channel.data.insert(channel.data.end(), data + i * sample_size, data + (i + 1) * sample_size);
+            channel.timestamps.push_back(timestamps[i]);
+            ++channel.num_samples;
+            last_timestamp = timestamps[i];
+        }
+    });
+    capture.last_timestamps[&buffInfo] = last_timestamp;
+    return ended;
+}
+
+bool robometry::BufferManager::collectCapture(Capture& capture, const FrameInfo& frame) {
+    if (!frame.m_timestamps.initialized()) {
+        return false;
+    }
+    std::scoped_lock<std::mutex> lock{ capture.mutex };
+    auto last = capture.last_timestamps.find(&frame);
+    double last_timestamp = last != capture.last_timestamps.end() ? last->second : -std::numeric_limits<double>::infinity();
+
+    // The timestamps of the frame are stored as its samples, the first one in the window not collected yet is searched
+    const size_t num_samples = frame.m_timestamps.size();
+    auto timestampAt = [&frame](size_t index) {
+        double ts{ 0.0 };
+        frame.m_timestamps.visit(index, 1, [&ts](const unsigned char* data, const double*, size_t) {
+            std::memcpy(&ts, data, sizeof(double));
+        });
+        return ts;
+    };
+    const double from = std::max(std::nextafter(last_timestamp, std::numeric_limits<double>::infinity()), capture.start_time);
+    size_t first{ 0 };
+    size_t end = num_samples;
+    while (first < end) {
+        const size_t middle = first + (end - first) / 2;
+        if (timestampAt(middle) < from) {
+            first = middle + 1;
+        }
+        else {
+            end = middle;
+        }
+    }
+
+    // The samples of the window are selected by the timestamps of the frame, and the same ones are taken from its channels
+    std::vector<char> selected(num_samples - first, 0);
+    std::vector<double> timestamps;
+    size_t index{ 0 };
+    bool ended{ false };
+    frame.m_timestamps.visit(first, num_samples - first, [&](const unsigned char* data, const double*, size_t count) {
+        for (size_t i = 0; i < count; ++i, ++index) {
+            double ts;
+            std::memcpy(&ts, data + i * sizeof(double), sizeof(double));
+            ended = ended || ts > capture.end_time;
+            if (ts <= last_timestamp || ts < capture.start_time || ts > capture.end_time) {
+                continue;
+            }
+            selected[index] = 1;
+            timestamps.push_back(ts);
+            last_timestamp = ts;
+        }
+    });
+    if (timestamps.empty()) {
+        return ended;
+    }
+    capture.last_timestamps[&frame] = last_timestamp;
+    auto& group = capture.content.clock_groups[frame.m_name];
+    group.insert(group.end(), timestamps.begin(), timestamps.end());
+
+    for (const auto& buffInfo : frame.m_channels) {
+        const auto& buffer = buffInfo->m_contiguous_buffer;
+        // The channels of a frame are pushed together, hence they have the same number of samples of the timestamps
+        if (!buffInfo->m_use_contiguous_buffer || !buffer.initialized() || buffer.size() != num_samples) {
+            continue;
+        }
+        auto position = capture.channels.find(buffInfo.get());
+        if (position == capture.channels.end()) {
+            capture.content.channels.push_back({ buffInfo->schema(), {}, {}, 0 });
+            position = capture.channels.emplace(buffInfo.get(), capture.content.channels.size() - 1).first;
+        }
+        auto& channel = capture.content.channels[position->second];
+        channel.overwritten_samples = buffInfo->overwrittenSamples();
+        channel.dropped_samples = buffInfo->droppedSamples();
+        const size_t sample_size = buffer.sampleSize();
+        index = 0;
+        buffer.visit(first, num_samples - first, [&](const unsigned char* data, const double*, size_t count) {
+            for (size_t i = 0; i < count; ++i, ++index) {
+                if (selected[index]) {
+                    channel.data.insert(channel.data.end(), data + i * sample_size, data + (i + 1) * sample_size);
+                }
+            }
+        });
+        channel.num_samples += timestamps.size();
+    }
+    return ended;
+}
+
+void robometry::BufferManager::collectCaptures(const BufferInfo& buffInfo) const {
+    if (m_capture_history) {
+        collectCapture(*m_capture_history, buffInfo);
+        trimCapture(*m_capture_history, m_bufferConfig.trigger_pre_duration);
+    }
+    if (m_pending_captures.load() == 0) {
+        return;
+    }
+    std::vector<std::shared_ptr<Capture>> captures;
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        captures = m_captures;
+    }
+    for (const auto& capture : captures) {
+        collectCapture(*capture, buffInfo);
+    }
+}
+
+void robometry::BufferManager::collectCaptures(const FrameInfo& frame) const {
+    if (m_capture_history) {
+        collectCapture(*m_capture_history, frame);
+        trimCapture(*m_capture_history, m_bufferConfig.trigger_pre_duration);
+    }
+    if (m_pending_captures.load() == 0) {
+        return;
+    }
+    std::vector<std::shared_ptr<Capture>> captures;
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        captures = m_captures;
+    }
+    for (const auto& capture : captures) {
+        collectCapture(*capture, frame);
+    }
+}
+
+void robometry::BufferManager::collectPushed(const BufferInfo& buffInfo) {
+    bool ended{ false };
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        for (const auto& capture : m_captures) {
+            ended = collectCapture(*capture, buffInfo) || ended;
+        }
+        m_captures_wake = m_captures_wake || ended;
+    }
+    if (ended) {
+        m_captures_cv.notify_one();
+    }
+}
+
+void robometry::BufferManager::collectPushed(const FrameInfo& frame) {
+    bool ended{ false };
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        for (const auto& capture : m_captures) {
+            ended = collectCapture(*capture, frame) || ended;
+        }
+        m_captures_wake = m_captures_wake || ended;
+    }
+    if (ended) {
+        m_captures_cv.notify_one();
+    }
+}
+
+void robometry::BufferManager::collectAll(Capture& capture) const {
+    Leaves leaves;
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        collectLeaves(node_name, node_name, node, leaves);
+    }
+    for (const auto& leaf : leaves) {
+        // The channels of the frames are collected together with their timestamps. The lock-free channels are read
+        // as their consumer, since the mutex serializes the collections with the detaches of the saves.
+        if (leaf.buffer_info->m_frame == nullptr) {
+            std::scoped_lock<std::mutex> lock{ leaf.buffer_info->m_buff_mutex };
+            collectCapture(capture, *leaf.buffer_info);
+        }
+    }
+    for (const auto& [frame_name, frame] : m_frames) {
+        std::scoped_lock<std::mutex> lock{ frame->m_mutex };
+        collectCapture(capture, *frame);
+    }
+}
+
+void robometry::BufferManager::reserveCapture(Capture& capture) {
+    std::scoped_lock<std::mutex> lock{ capture.mutex };
+    const double window = capture.end_time - capture.start_time;
+    auto expectedSamples = [window](double sampling_period, const std::vector<double>& timestamps) -> size_t {
+        if (sampling_period > 0.0) {
+            return static_cast<size_t>(std::ceil(window / sampling_period)) + 1;
+        }
+        if (timestamps.size() < 2 || timestamps.back() <= timestamps.front()) {
+            return timestamps.size();
+        }
+        const double rate = static_cast<double>(timestamps.size() - 1) / (timestamps.back() - timestamps.front());
+        return static_cast<size_t>(std::ceil(window * rate)) + 1;
+    };
+    for (const auto& [buffInfo, position] : capture.channels) {
+        auto& channel = capture.content.channels[position];
+        const auto& timestamps = buffInfo->m_frame != nullptr ? capture.content.clock_groups[buffInfo->m_frame->m_name] : channel.timestamps;
+        const size_t expected = expectedSamples(buffInfo->m_sampling_period, timestamps);
+        channel.data.reserve(expected * channel.schema.sample_size);
+        if (buffInfo->m_frame != nullptr) {
+            capture.content.clock_groups[buffInfo->m_frame->m_name].reserve(expected);
+        }
+        else {
+            channel.timestamps.reserve(expected);
+        }
+    }
+}
+
+void robometry::BufferManager::trimCapture(Capture& capture, double duration) {
+    std::scoped_lock<std::mutex> lock{ capture.mutex };
+    auto countOlder = [duration](const std::vector<double>& timestamps) -> size_t {
+        if (timestamps.empty()) {
+            return 0;
+        }
+        const double oldest = timestamps.back() - duration;
+        return std::find_if(timestamps.begin(), timestamps.end(), [oldest](double ts) { return ts >= oldest; }) - timestamps.begin();
+    };
+    auto eraseOldest = [](BinaryLogChannelSamples& channel, size_t num_samples) {
+        channel.data.erase(channel.data.begin(), channel.data.begin() + num_samples * channel.schema.sample_size);
+        channel.num_samples -= num_samples;
+    };
+
+    for (auto& [group_name, timestamps] : capture.content.clock_groups) {
+        const size_t older = countOlder(timestamps);
+        timestamps.erase(timestamps.begin(), timestamps.begin() + older);
+        for (auto& channel : capture.content.channels) {
+            if (channel.schema.clock_group == group_name) {
+                eraseOldest(channel, older);
+            }
+        }
+    }
+    for (auto& channel : capture.content.channels) {
+        if (channel.schema.clock_group.empty()) {
+            const size_t older = countOlder(channel.timestamps);
+            channel.timestamps.erase(channel.timestamps.begin(), channel.timestamps.begin() + older);
+            eraseOldest(channel, older);
+        }
+    }
+}
+
+void robometry::BufferManager::copyCaptureWindow(Capture& source, Capture& capture) {
+    std::scoped_lock<std::mutex, std::mutex> lock{ source.mutex, capture.mutex };
+    auto inWindow = [&capture](double ts) { return ts >= capture.start_time && ts <= capture.end_time; };
+    auto copySamples = [](const BinaryLogChannelSamples& from, BinaryLogChannelSamples& to, size_t index) {
+        const size_t sample_size = from.schema.sample_size;
+        to.data.insert(to.data.end(), from.data.begin() + index * sample_size, from.data.begin() + (index + 1) * sample_size);
+        ++to.num_samples;
+    };
+
+    capture.channels = source.channels;
+    capture.last_timestamps = source.last_timestamps;
+    for (const auto& from : source.content.channels) {
+        capture.content.channels.push_back({ from.schema, {}, {}, 0 });
+        auto& to = capture.content.channels.back();
+        const std::vector<double>& timestamps = from.schema.clock_group.empty() ? from.timestamps : source.content.clock_groups[from.schema.clock_group];
+        for (size_t i = 0; i < from.num_samples && i < timestamps.size(); ++i) {
+            if (inWindow(timestamps[i])) {
+                copySamples(from, to, i);
+                if (from.schema.clock_group.empty()) {
+                    to.timestamps.push_back(timestamps[i]);
+                }
+            }
+        }
+    }
+    for (const auto& [group_name, timestamps] : source.content.clock_groups) {
+        auto& group = capture.content.clock_groups[group_name];
+        std::copy_if(timestamps.begin(), timestamps.end(), std::back_inserter(group), inWindow);
+    }
+}
+
+void robometry::BufferManager::completeCaptures(bool all) {
+    std::vector<std::shared_ptr<Capture>> completed;
+    const double now = m_nowFunction();
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        for (const auto& capture : m_captures) {
+            if (all || now >= capture->end_time) {
+                completed.push_back(capture);
+            }
+        }
+    }
+    if (completed.empty()) {
+        return;
+    }
+
+    // The last samples are collected while the captures are still pending, so that no sample detached meanwhile is lost
+    for (const auto& capture : completed) {
+        collectAll(*capture);
+    }
+    {
+        std::scoped_lock<std::mutex> lock{ m_captures_mutex };
+        for (const auto& capture : completed) {
+            m_captures.erase(std::find(m_captures.begin(), m_captures.end(), capture));
+        }
+    }
+
+    for (const auto& capture : completed) {
+        if (!logContentToMat(capture->content, capture->file_name + ".mat", m_bufferConfig.mat_file_version)) {
+            std::cout << "Failed to write the capture " << capture->file_name << std::endl;
+        }
+        else if (m_saveCallback) {
+            m_saveCallback(capture->file_name, SaveCallbackSaveMethod::trigger);
+        }
+        --m_pending_captures;
+    }
+}
+
+void robometry::BufferManager::captureThread() {
+    std::unique_lock<std::mutex> lock{ m_captures_mutex };
+    auto wake_up = [this]() { return m_stop_captures || m_captures_wake; };
+    while (!m_stop_captures) {
+        // The thread is woken up by the triggers and by the producers pushing a sample after the end of a window.
+        // The timeout at the end of the earliest window, assuming that the now function measures seconds, covers the
+        // channels that are not pushed anymore and the lock-free ones, whose producers do not collect the samples.
+        double timeout = std::numeric_limits<double>::infinity();
+        const double now = m_nowFunction();
+        for (const auto& capture : m_captures) {
+            timeout = std::min(timeout, capture->end_time - now);
+        }
+        if (std::isinf(timeout)) {
+            m_captures_cv.wait(lock, wake_up);
+        }
+        else {
+            m_captures_cv.wait_for(lock, std::chrono::duration<double>(std::max(timeout, 0.0)), wake_up);
+        }
+        m_captures_wake = false;
+        if (m_stop_captures) {
+            break;
+        }
+        lock.unlock();
+        completeCaptures(false);
+        lock.lock();
+    }
+}
+
+bool robometry::BufferManager::detachSamples(const std::string &var_name, BufferInfo& buffInfo, bool flush_all, DetachedFrames& detached_frames, BufferInfo::DetachedSamples& samples) const {
+    if (buffInfo.m_frame != nullptr) {
+        // The samples of the frames have been already detached
+        auto detached = detached_frames.channels.find(&buffInfo);
+        if (detached == detached_frames.channels.end()) {
+            std::cout << var_name << " does not contain enought data, skipping" << std::endl;
+            return false;
+        }
+        samples = std::move(detached->second);
+        return true;
+    }
+
+    // The samples are detached while holding the lock, and they are converted after releasing it,
+    // so that the producer is not blocked during the conversion
+    std::scoped_lock<std::mutex> lock{ buffInfo.m_buff_mutex };
+    collectCaptures(buffInfo);
+    if (buffInfo.empty()) {
+        std::cout << var_name << " does not contain data, skipping" << std::endl;
+        return false;
+    }
+
+    if (!flush_all && buffInfo.size() < m_bufferConfig.data_threshold) {
+        std::cout << var_name << " does not contain enought data, skipping" << std::endl;
+        return false;
+    }
+
+    samples = buffInfo.detach();
+    const size_t sample_bytes = buffInfo.m_contiguous_buffer.sampleSize() + sizeof(double);
+    buffInfo.adaptRetentionCapacity(m_nowFunction(), m_bufferConfig.memory_budget > 0 ? m_bufferConfig.memory_budget / sample_bytes
+                                                                                     : std::numeric_limits<size_t>::max());
+    return true;
+}
+
+void robometry::BufferManager::copyTimestamps(const BufferInfo& buffInfo, const BufferInfo::DetachedSamples& samples, double* destination) {
+    if (buffInfo.m_use_contiguous_buffer) {
+        samples.chunks.copyTimestamps(destination);
+        return;
+    }
+    size_t i = 0;
+    for (auto& _cell : samples.records) {
+        destination[i] = _cell.m_ts;
+        ++i;
+    }
+    assert(i == samples.size);
+}
+
+std::string robometry::BufferManager::appendVariableName(const std::string &path, const std::string &field) {
+    // The names of the variables cannot contain the separator of the channel names
+    std::string name = path;
+    const auto& separator = TreeNode<BufferInfo>::stringSeparator;
+    for (size_t pos = name.find(separator); pos != std::string::npos; pos = name.find(separator, pos + 2)) {
+        name.replace(pos, separator.size(), "__");
+    }
+    return name + "__" + field;
+}
+
+namespace {
+
+template<typename T>
+bool appendArray(mat_t* file, matioCpp::Variable& variable, matio_classes class_type, matio_types data_type, matio_compression compression)
+{
+    auto array = variable.asMultiDimensionalArray<T>();
+    std::vector<size_t> dimensions(array.dimensions().begin(), array.dimensions().end());
+    matvar_t* matvar = Mat_VarCreate(variable.name().c_str(), class_type, data_type, static_cast<int>(dimensions.size()),
+                                     dimensions.data(), array.toSpan().data(), MAT_F_DONT_COPY_DATA);
+    if (matvar == nullptr) {
+        return false;
+    }
+    // The samples are always along the last dimension
+    const bool ok = Mat_VarWriteAppend(file, matvar, compression, matvar->rank) == 0;
+    Mat_VarFree(matvar);
+    return ok;
+}
+
+// The matio variable is created here, so that appending relies on the matio API and not on matioCpp::Variable::toMatio
+bool appendVariable(mat_t* file, matioCpp::Variable& variable, matio_compression compression)
+{
+    switch (variable.valueType()) {
+    case matioCpp::ValueType::DOUBLE: return appendArray<double>(file, variable, MAT_C_DOUBLE, MAT_T_DOUBLE, compression);
+    case matioCpp::ValueType::SINGLE: return appendArray<float>(file, variable, MAT_C_SINGLE, MAT_T_SINGLE, compression);
+    case matioCpp::ValueType::INT8: return appendArray<int8_t>(file, variable, MAT_C_INT8, MAT_T_INT8, compression);
+    case matioCpp::ValueType::UINT8: return appendArray<uint8_t>(file, variable, MAT_C_UINT8, MAT_T_UINT8, compression);
+    case matioCpp::ValueType::INT16: return appendArray<int16_t>(file, variable, MAT_C_INT16, MAT_T_INT16, compression);
+    case matioCpp::ValueType::UINT16: return appendArray<uint16_t>(file, variable, MAT_C_UINT16, MAT_T_UINT16, compression);
+    case matioCpp::ValueType::INT32: return appendArray<int32_t>(file, variable, MAT_C_INT32, MAT_T_INT32, compression);
+    case matioCpp::ValueType::UINT32: return appendArray<uint32_t>(file, variable, MAT_C_UINT32, MAT_T_UINT32, compression);
+    case matioCpp::ValueType::INT64: return appendArray<int64_t>(file, variable, MAT_C_INT64, MAT_T_INT64, compression);
+    case matioCpp::ValueType::UINT64: return appendArray<uint64_t>(file, variable, MAT_C_UINT64, MAT_T_UINT64, compression);
+    case matioCpp::ValueType::UTF8: return appendArray<char>(file, variable, MAT_C_CHAR, MAT_T_UTF8, compression);
+    default: return false;
+    }
+}
+
+} // namespace
+
+bool robometry::BufferManager::appendToFile(std::string &file_name_path, bool flush_all) {
+    std::scoped_lock<std::mutex> lock{ m_append_mutex };
+    if (m_append_file_name.empty()) {
+        std::string new_file_name_path = m_bufferConfig.filename + "_" + this->fileIndex();
+        if (!m_bufferConfig.path.empty()) {
+            new_file_name_path = m_bufferConfig.path + new_file_name_path;
+        }
+        if (!createAppendFile(new_file_name_path + ".mat")) {
+            return false;
+        }
+        m_append_file_name = new_file_name_path;
+    }
+    file_name_path = m_append_file_name;
+
+    auto detached_frames = detachFrames(flush_all);
+
+    // As in the usual save, the channels are converted independently, possibly in parallel, while the file is written serially
+    Leaves leaves;
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        collectLeaves(node_name, node_name, node, leaves);
+    }
+    std::vector<std::vector<matioCpp::Variable>> variables(leaves.size());
+    auto convertLeaf = [&](size_t i) {
+        variables[i] = createAppendVariables(leaves[i], flush_all, detached_frames);
+    };
+    if (m_save_thread_pool) {
+        m_save_thread_pool->parallelFor(leaves.size(), convertLeaf);
+    }
+    else {
+        for (size_t i = 0; i < leaves.size(); ++i) {
+            convertLeaf(i);
+        }
+    }
+
+    // The timestamps of the frames are appended once for the whole frame, as a row vector, e.g. clock_groups__joints
+    std::vector<matioCpp::Variable> frameTimestamps;
+    for (const auto& [frame_name, timestamps] : detached_frames.timestamps) {
+        matioCpp::MultiDimensionalArray<double> frameTimestampsArray(appendVariableName("clock_groups", frame_name), { 1, timestamps.size() });
+        timestamps.copyData(frameTimestampsArray.toSpan().data());
+        frameTimestamps.emplace_back(frameTimestampsArray);
+    }
+    variables.push_back(std::move(frameTimestamps));
+
+    const std::string file_name = m_append_file_name + ".mat";
+    mat_t* file = Mat_Open(file_name.c_str(), MAT_ACC_RDWR);
+    if (file == nullptr) {
+        std::cout << "Failed to open " << file_name << " for appending the data." << std::endl;
+        return false;
+    }
+
+    const auto compression = m_bufferConfig.enable_compression ? MAT_COMPRESSION_ZLIB : MAT_COMPRESSION_NONE;
+    bool ok{ true };
+    for (auto& channelVariables : variables) {
+        for (auto& variable : channelVariables) {
+            if (!appendVariable(file, variable, compression)) {
+                std::cout << "Failed to append " << variable.name() << " to " << file_name << "." << std::endl;
+                ok = false;
+            }
+        }
+    }
+    Mat_Close(file);
+
+    return ok;
+}
+
+bool robometry::BufferManager::writeBinaryLog(std::string &file_name_path, bool flush_all) {
+    std::scoped_lock<std::mutex> lock{ m_append_mutex };
+    if (!m_binary_log) {
+        std::string new_file_name_path = m_bufferConfig.filename + "_" + this->fileIndex();
+        if (!m_bufferConfig.path.empty()) {
+            new_file_name_path = m_bufferConfig.path + new_file_name_path;
+        }
+        auto binary_log = std::make_unique<BinaryLogWriter>();
+        if (!binary_log->open(new_file_name_path + ".rblog", m_bufferConfig)) {
+            return false;
+        }
+        m_binary_log = std::move(binary_log);
+        m_binary_log_file_name = new_file_name_path;
+    }
+    file_name_path = m_binary_log_file_name;
+
+    auto detached_frames = detachFrames(flush_all);
+    bool ok{ true };
+
+    // The clock groups are written first, since the channels refer to them
+    for (const auto& [frame_name, timestamps] : detached_frames.timestamps) {
+        auto clock_group = m_binary_log_clock_groups.find(frame_name);
+        if (clock_group == m_binary_log_clock_groups.end()) {
+            const auto id = static_cast<uint32_t>(m_binary_log_clock_groups.size());
+            ok = m_binary_log->writeClockGroupSchema(id, frame_name) && ok;
+            clock_group = m_binary_log_clock_groups.emplace(frame_name, id).first;
+        }
+        // The timestamps are compressed together with the channels of the clock group
+        bool encode_timestamps{ false };
+        auto frame = m_frames.find(frame_name);
+        if (frame != m_frames.end()) {
+            for (const auto& channel : frame->second->m_channels) {
+                encode_timestamps = encode_timestamps || channel->m_codec != ChannelCodec::None;
+            }
+        }
+        ok = m_binary_log->writeClockGroupBlock(clock_group->second, timestamps, encode_timestamps) && ok;
+    }
+
+    // The samples are written directly from the detached chunks, without converting them
+    Leaves leaves;
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        collectLeaves(node_name, node_name, node, leaves);
+    }
+    for (const auto& leaf : leaves) {
+        auto& buffInfo = *leaf.buffer_info;
+        BufferInfo::DetachedSamples samples;
+        if (!detachSamples(leaf.path, buffInfo, flush_all, detached_frames, samples)) {
+            continue;
+        }
+
+        if (!buffInfo.m_use_contiguous_buffer || buffInfo.m_element_type.empty()) {
+            std::cout << leaf.path << " does not contain numeric data, it cannot be written to the binary log, skipping" << std::endl;
+            buffInfo.recycle(std::move(samples));
+            continue;
+        }
+
+        auto channel = m_binary_log_channels.find(&buffInfo);
+        if (channel == m_binary_log_channels.end()) {
+            const BinaryLogChannelSchema schema = buffInfo.schema();
+            const auto id = static_cast<uint32_t>(m_binary_log_channels.size());
+            ok = m_binary_log->writeChannelSchema(id, schema) && ok;
+            channel = m_binary_log_channels.emplace(&buffInfo, id).first;
+        }
+        ok = m_binary_log->writeChannelBlock(channel->second, samples.chunks, buffInfo.m_frame == nullptr) && ok;
+        ok = m_binary_log->writeChannelCounters(channel->second, buffInfo.overwrittenSamples(), buffInfo.droppedSamples()) && ok;
+        buffInfo.recycle(std::move(samples));
+    }
+
+    ok = m_binary_log->flush() && ok;
+    if (!ok) {
+        std::cout << "An error occurred while writing the data to the binary log." << std::endl;
+    }
+    return ok;
+}
+
+bool robometry::BufferManager::createAppendFile(const std::string &file_name) {
+    std::vector<matioCpp::Variable> signalsVect;
+    if (m_description_cell_array.isValid()) {
+        signalsVect.emplace_back(m_description_cell_array);
+    }
+    signalsVect.emplace_back(matioCpp::String("yarp_robot_name", m_bufferConfig.yarp_robot_name));
+    for (auto& [node_name, node] : m_tree->getChildren()) {
+        signalsVect.emplace_back(this->createAppendTreeStruct(node_name, node_name, node));
+    }
+
+    assert(!matioCpp::File::Exists(file_name) && "A file with the same name already exists.");
+    matioCpp::File file = matioCpp::File::Create(file_name, matioCpp::FileVersion::MAT7_3);
+    if (!file.isOpen()) {
+        std::cout << "Failed to create " << file_name << "." << std::endl;
+        return false;
+    }
+    bool ok = file.write(matioCpp::Struct(m_bufferConfig.filename, signalsVect),
+                         m_bufferConfig.enable_compression ? matioCpp::Compression::zlib : matioCpp::Compression::None);
+    if (!ok) {
+        std::cout << "An error occurred while writing the description of the channels to " << file_name << "." << std::endl;
+    }
+    return ok;
+}
+
+matioCpp::Struct robometry::BufferManager::createAppendTreeStruct(const std::string &node_name, const std::string &node_path, std::shared_ptr<TreeNode<BufferInfo> > tree_node) const {
+    const auto& children = tree_node->getChildren();
+    if (children.size() != 0) {
+        matioCpp::Struct tmp(node_name);
+        for (const auto& [child_name, child] : children) {
+            tmp.setField(this->createAppendTreeStruct(child_name, node_path + TreeNode<BufferInfo>::stringSeparator + child_name, child));
+        }
+        return tmp;
+    }
+
+    auto buffInfo = tree_node->getValue();
+    assert(buffInfo);
+    std::vector<matioCpp::Variable> var_data;
+    var_data.emplace_back(matioCpp::make_variable("dimensions", buffInfo->m_dimensions));
+    var_data.emplace_back(matioCpp::make_variable("elements_names", buffInfo->m_elements_names));
+    var_data.emplace_back(matioCpp::make_variable("units_of_measure", buffInfo->m_units_of_measure));
+    var_data.emplace_back(matioCpp::String("name", node_name));
+    var_data.emplace_back(matioCpp::String("data_variable", appendVariableName(node_path, "data")));
+    const std::string timestamps_variable = buffInfo->m_frame != nullptr ? appendVariableName("clock_groups", buffInfo->m_frame->m_name)
+                                                                         : appendVariableName(node_path, "timestamps");
+    var_data.emplace_back(matioCpp::String("timestamps_variable", timestamps_variable));
+    var_data.emplace_back(matioCpp::String("overwritten_samples_variable", appendVariableName(node_path, "overwritten_samples")));
+    var_data.emplace_back(matioCpp::String("dropped_samples_variable", appendVariableName(node_path, "dropped_samples")));
+    return matioCpp::Struct(node_name, var_data);
+}
+
+std::vector<matioCpp::Variable> robometry::BufferManager::createAppendVariables(const Leaf& leaf, bool flush_all, DetachedFrames& detached_frames) const {
+    auto& buffInfo = *leaf.buffer_info;
+    std::vector<matioCpp::Variable> variables;
+
+    BufferInfo::DetachedSamples samples;
+    if (!detachSamples(leaf.path, buffInfo, flush_all, detached_frames, samples)) {
+        return variables;
+    }
+
+    assert(buffInfo.m_convert_to_matioCpp);
+    matioCpp::Variable data = buffInfo.m_convert_to_matioCpp(appendVariableName(leaf.path, "data"), samples);
+    if (data.variableType() != matioCpp::VariableType::MultiDimensionalArray) {
+        std::cout << leaf.path << " does not contain numeric data, it cannot be appended to the file, its "
+                  << samples.size << " samples are discarded" << std::endl;
+        buffInfo.recycle(std::move(samples));
+        return variables;
+    }
+    variables.emplace_back(data);
+
+    // The channels of a frame use the timestamps of the frame
+    if (buffInfo.m_frame == nullptr) {
+        matioCpp::MultiDimensionalArray<double> timestamps(appendVariableName(leaf.path, "timestamps"), { 1, samples.size });
+        copyTimestamps(buffInfo, samples, timestamps.toSpan().data());
+        variables.emplace_back(timestamps);
+    }
+
+    // The counters since the beginning are appended at each save, hence the last column holds the final ones
+    matioCpp::MultiDimensionalArray<size_t> overwritten(appendVariableName(leaf.path, "overwritten_samples"), { 1, 1 });
+    overwritten[0] = buffInfo.overwrittenSamples();
+    variables.emplace_back(overwritten);
+    matioCpp::MultiDimensionalArray<size_t> dropped(appendVariableName(leaf.path, "dropped_samples"), { 1, 1 });
+    dropped[0] = buffInfo.droppedSamples();
+    variables.emplace_back(dropped);
+
+    buffInfo.recycle(std::move(samples));
+    return variables;
+}
+
 std::string robometry::BufferManager::fileIndex() const {
     if (m_bufferConfig.file_indexing == "time_since_epoch") {
         return std::to_string(m_nowFunction());
@@ -326,6 +1891,12 @@ std::string robometry::BufferManager::fileIndex() const {
     return time.str();
 }
 
+std::string robometry::BufferManager::flightRecorderRingFileName(const std::string& prefix) {
+    std::stringstream file_name;
+    file_name << prefix << "_" << std::setw(6) << std::setfill('0') << m_flight_recorder_rings++ << ".rbring";
+    return (robometry_fs::path(m_flight_recorder_directory) / file_name.str()).string();
+}
+
 void robometry::BufferManager::populateDescriptionCellArray() {
     if (m_bufferConfig.description_list.empty())
         return;
@@ -342,7 +1913,7 @@ void robometry::BufferManager::resize(size_t new_size, std::shared_ptr<TreeNode<
     // resize the variable
     auto variable = node->getValue();
     if (variable != nullptr) {
-        variable->m_buffer.resize(new_size);
+        variable->resize(new_size);
     }
 
     for (auto& [var_name, child] : node->getChildren()) {
@@ -355,7 +1926,7 @@ void robometry::BufferManager::set_capacity(size_t new_size, std::shared_ptr<Tre
     // resize the variable
     auto variable = node->getValue();
     if (variable != nullptr) {
-        variable->m_buffer.set_capacity(new_size);
+        variable->set_capacity(new_size);
     }
 
     for (auto& [var_name, child] : node->getChildren()) {
@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/Codec.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// The size in bytes of the elements of an integer type, 0 if the type is not an integer
+size_t integerSize(const std::string& element_type, bool& is_signed)
+{
+    is_signed = true;
+    if (element_type == "char" || element_type == "int8") return 1;
+    if (element_type == "int16") return 2;
+    if (element_type == "int32") return 4;
+    if (element_type == "int64") return 8;
+    is_signed = false;
+    if (element_type == "logical" || element_type == "uint8") return 1;
+    if (element_type == "uint16") return 2;
+    if (element_type == "uint32") return 4;
+    if (element_type == "uint64") return 8;
+    return 0;
+}
+
+// The size in bytes of the elements of a floating point type, 0 if the type is not floating point
+size_t floatingPointSize(const std::string& element_type)
+{
+    if (element_type == "double") return sizeof(double);
+    if (element_type == "single") return sizeof(float);
+    return 0;
+}
+
+// Load an integer element, extending its sign if needed
+uint64_t loadInteger(const unsigned char* in, size_t size, bool is_signed)
+{
+    switch (size) {
+    case 1: { uint8_t v; std::memcpy(&v, in, 1); return is_signed ? static_cast<uint64_t>(static_cast<int64_t>(static_cast<int8_t>(v))) : v; }
+    case 2: { uint16_t v; std::memcpy(&v, in, 2); return is_signed ? static_cast<uint64_t>(static_cast<int64_t>(static_cast<int16_t>(v))) : v; }
+    case 4: { uint32_t v; std::memcpy(&v, in, 4); return is_signed ? static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(v))) : v; }
+    default: { uint64_t v; std::memcpy(&v, in, 8); return v; }
+    }
+}
+
+// Store the lowest bits of an integer element
+void storeInteger(uint64_t value, size_t size, unsigned char* out)
+{
+    switch (size) {
+    case 1: { const auto v = static_cast<uint8_t>(value); std::memcpy(out, &v, 1); break; }
+    case 2: { const auto v = static_cast<uint16_t>(value); std::memcpy(out, &v, 2); break; }
+    case 4: { const auto v = static_cast<uint32_t>(value); std::memcpy(out, &v, 4); break; }
+    default: std::memcpy(out, &value, 8); break;
+    }
+}
+
+uint64_t loadBits(const unsigned char* in, size_t size)
+{
+    if (size == sizeof(uint32_t)) {
+        uint32_t v;
+        std::memcpy(&v, in, sizeof(v));
+        return v;
+    }
+    uint64_t v;
+    std::memcpy(&v, in, sizeof(v));
+    return v;
+}
+
+void storeBits(uint64_t bits, size_t size, unsigned char* out)
+{
+    if (size == sizeof(uint32_t)) {
+        const auto v = static_cast<uint32_t>(bits);
+        std::memcpy(out, &v, sizeof(v));
+        return;
+    }
+    std::memcpy(out, &bits, sizeof(bits));
+}
+
+uint64_t zigzag(uint64_t value)
+{
+    return (value << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+}
+
+uint64_t unzigzag(uint64_t value)
+{
+    return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+void writeVarint(uint64_t value, std::vector<unsigned char>& out)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+bool readVarint(const unsigned char* in, size_t in_size, size_t& position, uint64_t& value)
+{
+    value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (position >= in_size) {
+            return false;
+        }
+        const unsigned char byte = in[position++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned leadingZeros(uint64_t value, unsigned width)
+{
+    unsigned count = 0;
+    for (uint64_t mask = uint64_t(1) << (width - 1); mask != 0 && (value & mask) == 0; mask >>= 1) {
+        ++count;
+    }
+    return count;
+}
+
+unsigned trailingZeros(uint64_t value)
+{
+    unsigned count = 0;
+    while (count < 64 && (value & (uint64_t(1) << count)) == 0) {
+        ++count;
+    }
+    return count;
+}
+
+// Writes the bits most significant first
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : m_out(out) {}
+
+    void write(uint64_t value, unsigned num_bits)
+    {
+        while (num_bits > 0) {
+            if (m_free == 0) {
+                m_out.push_back(0);
+                m_free = 8;
+            }
+            const unsigned take = std::min(num_bits, m_free);
+            const auto part = static_cast<unsigned char>((value >> (num_bits - take)) & ((1u << take) - 1));
+            m_out.back() |= static_cast<unsigned char>(part << (m_free - take));
+            m_free -= take;
+            num_bits -= take;
+        }
+    }
+
+private:
+    std::vector<unsigned char>& m_out;
+    unsigned m_free{ 0 }; // The bits still free in the last byte
+};
+
+class BitReader {
+public:
+    BitReader(const unsigned char* in, size_t in_size) : m_in(in), m_size(in_size) {}
+
+    bool read(unsigned num_bits, uint64_t& value)
+    {
+        value = 0;
+        while (num_bits > 0) {
+            if (m_position >= m_size) {
+                return false;
+            }
+            const unsigned available = 8 - m_used;
+            const unsigned take = std::min(num_bits, available);
+            const unsigned part = (m_in[m_position] >> (available - take)) & ((1u << take) - 1);
+            value = (value << take) | part;
+            m_used += take;
+            num_bits -= take;
+            if (m_used == 8) {
+                m_used = 0;
+                ++m_position;
+            }
+        }
+        return true;
+    }
+
+private:
+    const unsigned char* m_in;
+    size_t m_size;
+    size_t m_position{ 0 };
+    unsigned m_used{ 0 }; // The bits already read in the current byte
+};
+
+// The state of the XOR encoding of an element
+struct XorState {
+    uint64_t previous{ 0 };
+    unsigned leading{ 0 };
+    unsigned trailing{ 0 };
+    bool has_window{ false };
+};
+
+} // namespace
+
+std::string robometry::channelCodecName(ChannelCodec codec)
+{
+    switch (codec) {
+    case ChannelCodec::Delta:
+        return "delta";
+    case ChannelCodec::Xor:
+        return "xor";
+    default:
+        return "none";
+    }
+}
+
+bool robometry::channelCodecFromName(const std::string& name, ChannelCodec& codec)
+{
+    for (auto candidate : { ChannelCodec::None, ChannelCodec::Delta, ChannelCodec::Xor }) {
+        if (channelCodecName(candidate) == name) {
+            codec = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool robometry::channelCodecSupports(ChannelCodec codec, const std::string& element_type)
+{
+    bool is_signed{ false };
+    switch (codec) {
+    case ChannelCodec::None:
+        return true;
+    case ChannelCodec::Delta:
+        return integerSize(element_type, is_signed) != 0;
+    case ChannelCodec::Xor:
+        return floatingPointSize(element_type) != 0;
+    }
+    return false;
+}
+
+bool robometry::encodeSamples(ChannelCodec codec, const std::string& element_type, const unsigned char* data,
+                              size_t num_samples, size_t sample_size, std::vector<unsigned char>& out)
+{
+    if (codec == ChannelCodec::Delta) {
+        bool is_signed{ false };
+        const size_t element_size = integerSize(element_type, is_signed);
+        if (element_size == 0) {
+            return false;
+        }
+        const size_t num_elements = sample_size / element_size;
+        std::vector<uint64_t> previous(num_elements, 0);
+        for (size_t i = 0; i < num_samples; ++i) {
+            for (size_t j = 0; j < num_elements; ++j) {
+                const uint64_t value = loadInteger(data + i * sample_size + j * element_size, element_size, is_signed);
+                writeVarint(zigzag(value - previous[j]), out);
+                previous[j] = value;
+            }
+        }
+        return true;
+    }
+
+    if (codec == ChannelCodec::Xor) {
+        const size_t element_size = floatingPointSize(element_type);
+        if (element_size == 0) {
+            return false;
+        }
+        const unsigned width = static_cast<unsigned>(8 * element_size);
+        const size_t num_elements = sample_size / element_size;
+        std::vector<XorState> states(num_elements);
+        BitWriter writer(out);
+        for (size_t i = 0; i < num_samples; ++i) {
+            for (size_t j = 0; j < num_elements; ++j) {
+                auto& state = states[j];
+                const uint64_t value = loadBits(data + i * sample_size + j * element_size, element_size);
+                const uint64_t x = value ^ state.previous;
+                state.previous = value;
+                if (x == 0) {
+                    writer.write(0, 1);
+                    continue;
+                }
+                const unsigned leading = std::min(leadingZeros(x, width), 31u);
+                const unsigned trailing = trailingZeros(x);
+                if (state.has_window && leading >= state.leading && trailing >= state.trailing) {
+                    // The meaningful bits fit in the window of the previous value
+                    writer.write(0b10, 2);
+                    writer.write(x >> state.trailing, width - state.leading - state.trailing);
+                }
+                else {
+                    const unsigned length = width - leading - trailing;
+                    writer.write(0b11, 2);
+                    writer.write(leading, 5);
+                    writer.write(length & 63, 6); // A length of 64 is written as 0
+                    writer.write(x >> trailing, length);
+                    state.leading = leading;
+                    state.trailing = trailing;
+                    state.has_window = true;
+                }
+            }
+        }
+        return true;
+    }
+
+    out.insert(out.end(), data, data + num_samples * sample_size);
+    return true;
+}
+
+bool robometry::decodeSamples(ChannelCodec codec, const std::string& element_type, const unsigned char* in, size_t in_size,
+                              size_t num_samples, size_t sample_size, unsigned char* data)
+{
+    if (codec == ChannelCodec::Delta) {
+        bool is_signed{ false };
+        const size_t element_size = integerSize(element_type, is_signed);
+        if (element_size == 0) {
+            return false;
+        }
+        const size_t num_elements = sample_size / element_size;
+        std::vector<uint64_t> previous(num_elements, 0);
+        size_t position = 0;
+        for (size_t i = 0; i < num_samples; ++i) {
+            for (size_t j = 0; j < num_elements; ++j) {
+                uint64_t delta{ 0 };
+                if (!readVarint(in, in_size, position, delta)) {
+                    return false;
+                }
+                previous[j] += unzigzag(delta);
+                storeInteger(previous[j], element_size, data + i * sample_size + j * element_size);
+            }
+        }
+        return position == in_size;
+    }
+
+    if (codec == ChannelCodec::Xor) {
+        const size_t element_size = floatingPointSize(element_type);
+        if (element_size == 0) {
+            return false;
+        }
+        const unsigned width = static_cast<unsigned>(8 * element_size);
+        const size_t num_elements = sample_size / element_size;
+        std::vector<XorState> states(num_elements);
+        BitReader reader(in, in_size);
+        for (size_t i = 0; i < num_samples; ++i) {
+            for (size_t j = 0; j < num_elements; ++j) {
+                auto& state = states[j];
+                uint64_t control{ 0 };
+                if (!reader.read(1, control)) {
+                    return false;
+                }
+                if (control == 1) {
+                    if (!reader.read(1, control)) {
+                        return false;
+                    }
+                    if (control == 1) {
+                        uint64_t leading{ 0 }, length{ 0 };
+                        if (!reader.read(5, leading) || !reader.read(6, length)) {
+                            return false;
+                        }
+                        length = length == 0 ? 64 : length;
+                        if (leading + length > width) {
+                            return false;
+                        }
+                        state.leading = static_cast<unsigned>(leading);
+                        state.trailing = static_cast<unsigned>(width - leading - length);
+                        state.has_window = true;
+                    }
+                    else if (!state.has_window) {
+                        return false;
+                    }
+                    uint64_t meaningful{ 0 };
+                    if (!reader.read(width - state.leading - state.trailing, meaningful)) {
+                        return false;
+                    }
+                    state.previous ^= meaningful << state.trailing;
+                }
+                storeBits(state.previous, element_size, data + i * sample_size + j * element_size);
+            }
+        }
+        return true;
+    }
+
+    if (in_size != num_samples * sample_size) {
+        return false;
+    }
+    if (in_size > 0) {
+        std::memcpy(data, in, in_size);
+    }
+    return true;
+}
+
+void robometry::encodeTimestamps(const double* timestamps, size_t num_samples, std::vector<unsigned char>& out)
+{
+    uint64_t previous{ 0 }, previous_delta{ 0 };
+    for (size_t i = 0; i < num_samples; ++i) {
+        uint64_t bits;
+        std::memcpy(&bits, timestamps + i, sizeof(bits));
+        const uint64_t delta = bits - previous;
+        writeVarint(zigzag(delta - previous_delta), out);
+        previous = bits;
+        previous_delta = delta;
+    }
+}
+
+bool robometry::decodeTimestamps(const unsigned char* in, size_t in_size, size_t num_samples, double* timestamps)
+{
+    uint64_t previous{ 0 }, previous_delta{ 0 };
+    size_t position = 0;
+    for (size_t i = 0; i < num_samples; ++i) {
+        uint64_t delta_of_delta{ 0 };
+        if (!readVarint(in, in_size, position, delta_of_delta)) {
+            return false;
+        }
+        previous_delta += unzigzag(delta_of_delta);
+        previous += previous_delta;
+        std::memcpy(timestamps + i, &previous, sizeof(previous));
+    }
+    return position == in_size;
+}
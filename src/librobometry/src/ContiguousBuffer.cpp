@@ -0,0 +1,517 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/ContiguousBuffer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+std::unique_ptr<robometry::ContiguousBuffer::Chunk> robometry::ContiguousBuffer::ChunkPool::acquire()
+{
+    {
+        std::scoped_lock<std::mutex> lock{ mutex };
+        if (!chunks.empty()) {
+            auto chunk = std::move(chunks.back());
+            chunks.pop_back();
+            return chunk;
+        }
+    }
+    auto chunk = std::make_unique<Chunk>();
+    // The data is followed by the timestamps, aligned to double
+    const size_t timestamps_offset = (chunk_size * sample_size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+    const size_t bytes = timestamps_offset + (store_timestamps ? chunk_size * sizeof(double) : 0);
+    void* storage = mapped_file != nullptr ? mapped_file->map(bytes) : nullptr;
+    if (storage == nullptr) {
+        if (mapped_file != nullptr) {
+            std::cout << "Failed to extend the memory-mapped storage, the chunk is allocated on the heap." << std::endl;
+        }
+        chunk->heap_storage.resize(std::max<size_t>(bytes / sizeof(double), 1), 0.0);
+        storage = chunk->heap_storage.data();
+    }
+    chunk->data = static_cast<unsigned char*>(storage);
+    if (store_timestamps) {
+        chunk->timestamps = reinterpret_cast<double*>(chunk->data + timestamps_offset);
+    }
+    return chunk;
+}
+
+robometry::ContiguousBuffer::DetachedSamples& robometry::ContiguousBuffer::DetachedSamples::operator=(DetachedSamples&& _other) noexcept
+{
+    release();
+    m_segments = std::move(_other.m_segments);
+    m_pool = std::move(_other.m_pool);
+    m_size = _other.m_size;
+    return *this;
+}
+
+robometry::ContiguousBuffer::DetachedSamples::~DetachedSamples()
+{
+    release();
+}
+
+size_t robometry::ContiguousBuffer::DetachedSamples::size() const {
+    return m_size;
+}
+
+size_t robometry::ContiguousBuffer::DetachedSamples::sampleSize() const {
+    return m_pool != nullptr ? m_pool->sample_size : 0;
+}
+
+void robometry::ContiguousBuffer::DetachedSamples::copyData(void* destination) const
+{
+    if (m_pool == nullptr) {
+        return;
+    }
+    auto out = static_cast<unsigned char*>(destination);
+    const size_t sample_size = m_pool->sample_size;
+    for (const auto& segment : m_segments) {
+        const size_t bytes = (segment.end - segment.begin) * sample_size;
+        std::memcpy(out, segment.chunk->data + segment.begin * sample_size, bytes);
+        out += bytes;
+    }
+}
+
+void robometry::ContiguousBuffer::DetachedSamples::copyTimestamps(double* destination) const
+{
+    if (m_pool == nullptr || !m_pool->store_timestamps) {
+        return;
+    }
+    for (const auto& segment : m_segments) {
+        destination = std::copy(segment.chunk->timestamps + segment.begin,
+                                segment.chunk->timestamps + segment.end,
+                                destination);
+    }
+}
+
+void robometry::ContiguousBuffer::DetachedSamples::visit(const std::function<void(const unsigned char*, const double*, size_t)>& visitor) const
+{
+    if (m_pool == nullptr) {
+        return;
+    }
+    const size_t sample_size = m_pool->sample_size;
+    for (const auto& segment : m_segments) {
+        const double* timestamps = m_pool->store_timestamps ? segment.chunk->timestamps + segment.begin : nullptr;
+        visitor(segment.chunk->data + segment.begin * sample_size, timestamps, segment.end - segment.begin);
+    }
+}
+
+void robometry::ContiguousBuffer::DetachedSamples::release()
+{
+    if (m_pool != nullptr) {
+        std::scoped_lock<std::mutex> lock{ m_pool->mutex };
+        for (auto& segment : m_segments) {
+            m_pool->chunks.push_back(std::move(segment.chunk));
+        }
+    }
+    m_segments.clear();
+    m_pool.reset();
+    m_size = 0;
+}
+
+robometry::ContiguousBuffer::ContiguousBuffer(size_t num_elements, size_t chunk_size_bytes) : m_capacity(num_elements),
+                                                                                               m_chunk_size_bytes(chunk_size_bytes)
+{
+
+}
+
+robometry::ContiguousBuffer::ContiguousBuffer(ContiguousBuffer&& _other) noexcept
+{
+    *this = std::move(_other);
+}
+
+robometry::ContiguousBuffer& robometry::ContiguousBuffer::operator=(ContiguousBuffer&& _other) noexcept
+{
+    m_chunks = std::move(_other.m_chunks);
+    m_pool = std::move(_other.m_pool);
+    m_sample_size = _other.m_sample_size;
+    m_capacity = _other.m_capacity;
+    m_chunk_size_bytes = _other.m_chunk_size_bytes;
+    m_chunk_size = _other.m_chunk_size;
+    m_slots = _other.m_slots;
+    m_lock_free = _other.m_lock_free;
+    m_drop_when_full = _other.m_drop_when_full;
+    m_store_timestamps = _other.m_store_timestamps;
+    m_mapped_storage = std::move(_other.m_mapped_storage);
+    m_write_index = _other.m_write_index.load();
+    m_read_index = _other.m_read_index.load();
+    m_overwritten = _other.m_overwritten.load();
+    m_dropped = _other.m_dropped.load();
+    return *this;
+}
+
+void robometry::ContiguousBuffer::initialize(size_t sample_size)
+{
+    m_sample_size = sample_size;
+    m_chunk_size = std::clamp<size_t>(m_chunk_size_bytes / std::max<size_t>(m_sample_size, 1), 1, std::max<size_t>(m_capacity, 1));
+
+    // A new pool is created, the chunks of a different size that are still detached will not come back
+    m_pool = std::make_shared<ChunkPool>();
+    m_pool->chunk_size = m_chunk_size;
+    m_pool->sample_size = m_sample_size;
+    m_pool->store_timestamps = m_store_timestamps;
+    if (!m_mapped_storage.empty()) {
+        m_pool->mapped_file = std::make_unique<MappedFile>();
+        if (!m_pool->mapped_file->create(m_mapped_storage)) {
+            std::cout << "The samples are stored on the heap." << std::endl;
+            m_pool->mapped_file.reset();
+        }
+    }
+
+    const size_t num_chunks = (m_capacity + m_chunk_size - 1) / m_chunk_size;
+    m_slots = num_chunks * m_chunk_size;
+    m_chunks.clear();
+    for (size_t i = 0; i < num_chunks; ++i) {
+        m_chunks.push_back(m_pool->acquire());
+    }
+    m_write_index = 0;
+    m_read_index = 0;
+}
+
+bool robometry::ContiguousBuffer::initialized() const {
+    return m_sample_size != 0;
+}
+
+size_t robometry::ContiguousBuffer::sampleSize() const {
+    return m_sample_size;
+}
+
+size_t robometry::ContiguousBuffer::chunkSize() const {
+    return m_chunk_size;
+}
+
+void robometry::ContiguousBuffer::setLockFree(bool lock_free) {
+    m_lock_free = lock_free;
+}
+
+bool robometry::ContiguousBuffer::lockFree() const {
+    return m_lock_free;
+}
+
+void robometry::ContiguousBuffer::setDropWhenFull(bool drop_when_full) {
+    m_drop_when_full = drop_when_full;
+}
+
+bool robometry::ContiguousBuffer::dropWhenFull() const {
+    return m_lock_free || m_drop_when_full;
+}
+
+void robometry::ContiguousBuffer::setStoreTimestamps(bool store_timestamps) {
+    m_store_timestamps = store_timestamps;
+}
+
+bool robometry::ContiguousBuffer::storeTimestamps() const {
+    return m_store_timestamps;
+}
+
+void robometry::ContiguousBuffer::setMappedStorage(const std::string& directory) {
+    m_mapped_storage = directory;
+}
+
+const std::string& robometry::ContiguousBuffer::mappedStorage() const {
+    return m_mapped_storage;
+}
+
+bool robometry::ContiguousBuffer::push_back(const void* data, size_t size, double ts)
+{
+    if (m_capacity == 0 || !initialized()) {
+        return false;
+    }
+
+    // Only the producer writes the write index
+    const size_t write_index = m_write_index.load(std::memory_order_relaxed);
+    const size_t read_index = m_read_index.load(std::memory_order_acquire);
+    if (write_index - read_index >= m_capacity) {
+        if (dropWhenFull()) {
+            // In lock-free mode the read index belongs to the consumer, we cannot free a slot
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        // Overwrite the oldest sample, as boost::circular_buffer does
+        m_read_index.store(read_index + 1, std::memory_order_relaxed);
+        m_overwritten.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    store(write_index, data, size, ts);
+
+    // Publish the sample to the consumer
+    m_write_index.store(write_index + 1, std::memory_order_release);
+    return true;
+}
+
+size_t robometry::ContiguousBuffer::push_back(const void* data, const double* timestamps, size_t num_samples)
+{
+    if (m_capacity == 0 || !initialized()) {
+        return 0;
+    }
+
+    auto in = static_cast<const unsigned char*>(data);
+    const size_t write_index = m_write_index.load(std::memory_order_relaxed);
+    const size_t read_index = m_read_index.load(std::memory_order_acquire);
+    const size_t free_space = m_capacity - (write_index - read_index);
+    if (dropWhenFull()) {
+        // The samples that do not fit are dropped
+        if (num_samples > free_space) {
+            m_dropped.fetch_add(num_samples - free_space, std::memory_order_relaxed);
+            num_samples = free_space;
+        }
+    }
+    else {
+        // Only the newest capacity samples would survive, the others are skipped
+        if (num_samples > m_capacity) {
+            const size_t skipped = num_samples - m_capacity;
+            in += skipped * m_sample_size;
+            timestamps += skipped;
+            num_samples = m_capacity;
+            m_overwritten.fetch_add(skipped, std::memory_order_relaxed);
+        }
+        if (num_samples > free_space) {
+            m_read_index.store(read_index + num_samples - free_space, std::memory_order_relaxed);
+            m_overwritten.fetch_add(num_samples - free_space, std::memory_order_relaxed);
+        }
+    }
+
+    // Copy the samples in blocks, splitting them where a chunk ends or the ring wraps around
+    size_t index = write_index;
+    size_t remaining = num_samples;
+    while (remaining > 0) {
+        size_t offset{ 0 };
+        Chunk& chunk = locate(index, offset);
+        const size_t count = std::min(remaining, m_chunk_size - offset);
+        std::memcpy(chunk.data + offset * m_sample_size, in, count * m_sample_size);
+        if (m_store_timestamps) {
+            std::copy_n(timestamps, count, chunk.timestamps + offset);
+        }
+        in += count * m_sample_size;
+        timestamps += count;
+        index += count;
+        remaining -= count;
+    }
+
+    // Publish the samples to the consumer
+    m_write_index.store(write_index + num_samples, std::memory_order_release);
+    return num_samples;
+}
+
+void robometry::ContiguousBuffer::copyData(void* destination, size_t num_samples) const
+{
+    auto out = static_cast<unsigned char*>(destination);
+    size_t index = m_read_index.load(std::memory_order_acquire);
+    while (num_samples > 0) {
+        size_t offset{ 0 };
+        const Chunk& chunk = locate(index, offset);
+        const size_t count = std::min(num_samples, m_chunk_size - offset);
+        std::memcpy(out, chunk.data + offset * m_sample_size, count * m_sample_size);
+        out += count * m_sample_size;
+        index += count;
+        num_samples -= count;
+    }
+}
+
+void robometry::ContiguousBuffer::copyData(void* destination) const
+{
+    copyData(destination, size());
+}
+
+void robometry::ContiguousBuffer::copyTimestamps(double* destination, size_t num_samples) const
+{
+    if (!m_store_timestamps) {
+        return;
+    }
+    size_t index = m_read_index.load(std::memory_order_acquire);
+    while (num_samples > 0) {
+        size_t offset{ 0 };
+        const Chunk& chunk = locate(index, offset);
+        const size_t count = std::min(num_samples, m_chunk_size - offset);
+        destination = std::copy_n(chunk.timestamps + offset, count, destination);
+        index += count;
+        num_samples -= count;
+    }
+}
+
+void robometry::ContiguousBuffer::copyTimestamps(double* destination) const
+{
+    copyTimestamps(destination, size());
+}
+
+robometry::ContiguousBuffer::DetachedSamples robometry::ContiguousBuffer::detach(size_t num_samples)
+{
+    DetachedSamples detached;
+    detached.m_pool = m_pool;
+    detached.m_size = num_samples;
+
+    size_t index = m_read_index.load(std::memory_order_acquire);
+    const size_t end = index + num_samples;
+    while (index < end) {
+        const size_t slot = index % m_slots;
+        const size_t offset = slot % m_chunk_size;
+        const size_t count = std::min(end - index, m_chunk_size - offset);
+        auto& chunk = m_chunks[slot / m_chunk_size];
+        auto detached_chunk = m_pool->acquire();
+        if (count == m_chunk_size) {
+            // The whole chunk is going to be detached, the producer cannot write in it until we move the read index
+            std::swap(chunk, detached_chunk);
+        }
+        else {
+            // The producer may be writing in the rest of the chunk, hence we copy only the samples to be detached
+            std::memcpy(detached_chunk->data + offset * m_sample_size,
+                        chunk->data + offset * m_sample_size,
+                        count * m_sample_size);
+            if (m_store_timestamps) {
+                std::copy_n(chunk->timestamps + offset, count, detached_chunk->timestamps + offset);
+            }
+        }
+        detached.m_segments.push_back({ std::move(detached_chunk), offset, offset + count });
+        index += count;
+    }
+
+    // Release the slots to the producer, publishing also the swapped chunks
+    pop_front(num_samples);
+    return detached;
+}
+
+void robometry::ContiguousBuffer::pop_front(size_t num_samples)
+{
+    // Release the slots to the producer
+    m_read_index.fetch_add(num_samples, std::memory_order_release);
+}
+
+void robometry::ContiguousBuffer::discardOldest(size_t num_samples)
+{
+    m_read_index.fetch_add(num_samples, std::memory_order_release);
+    m_overwritten.fetch_add(num_samples, std::memory_order_relaxed);
+}
+
+size_t robometry::ContiguousBuffer::countOlderThan(double ts) const
+{
+    if (!m_store_timestamps || !initialized()) {
+        return 0;
+    }
+    const size_t read_index = m_read_index.load(std::memory_order_acquire);
+    size_t first{ 0 };
+    size_t last = size();
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        size_t offset{ 0 };
+        const Chunk& chunk = locate(read_index + middle, offset);
+        if (chunk.timestamps[offset] < ts) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+size_t robometry::ContiguousBuffer::overwrittenSamples() const {
+    return m_overwritten.load(std::memory_order_relaxed);
+}
+
+size_t robometry::ContiguousBuffer::droppedSamples() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+size_t robometry::ContiguousBuffer::getBufferFreeSpace() const {
+    return m_capacity - size();
+}
+
+size_t robometry::ContiguousBuffer::size() const {
+    // Load the read index first, so that the difference is never negative
+    const size_t read_index = m_read_index.load(std::memory_order_acquire);
+    const size_t write_index = m_write_index.load(std::memory_order_acquire);
+    return std::min(write_index - read_index, m_capacity);
+}
+
+size_t robometry::ContiguousBuffer::capacity() const {
+    return m_capacity;
+}
+
+size_t robometry::ContiguousBuffer::memoryUsage() const {
+    return m_capacity * (m_sample_size + (m_store_timestamps && initialized() ? sizeof(double) : 0));
+}
+
+bool robometry::ContiguousBuffer::empty() const {
+    return size() == 0;
+}
+
+bool robometry::ContiguousBuffer::full() const {
+    return size() == m_capacity;
+}
+
+void robometry::ContiguousBuffer::resize(size_t new_size)
+{
+    if (new_size > m_capacity) {
+        set_capacity(new_size);
+    }
+
+    if (!initialized()) {
+        return;
+    }
+
+    const size_t read_index = m_read_index.load();
+    for (size_t index = m_write_index.load(); index < read_index + new_size; ++index) {
+        store(index, nullptr, 0, 0.0);
+    }
+    m_write_index = read_index + new_size;
+}
+
+void robometry::ContiguousBuffer::set_capacity(size_t new_size)
+{
+    if (new_size == m_capacity) {
+        return;
+    }
+
+    if (!initialized()) {
+        m_capacity = new_size;
+        return;
+    }
+
+    // Copy the content in the new storage, keeping the oldest samples
+    const size_t new_buffer_size = std::min(size(), new_size);
+    std::vector<unsigned char> data(new_buffer_size * m_sample_size);
+    std::vector<double> timestamps(new_buffer_size);
+    copyData(data.data(), new_buffer_size);
+    copyTimestamps(timestamps.data(), new_buffer_size);
+
+    m_capacity = new_size;
+    initialize(m_sample_size);
+    for (size_t i = 0; i < new_buffer_size; ++i) {
+        store(i, data.data() + i * m_sample_size, m_sample_size, timestamps[i]);
+    }
+    m_write_index = new_buffer_size;
+}
+
+void robometry::ContiguousBuffer::clear() noexcept
+{
+    m_read_index = m_write_index.load();
+}
+
+robometry::ContiguousBuffer::Chunk& robometry::ContiguousBuffer::locate(size_t index, size_t& offset) const
+{
+    const size_t slot = index % m_slots;
+    offset = slot % m_chunk_size;
+    return *m_chunks[slot / m_chunk_size];
+}
+
+void robometry::ContiguousBuffer::store(size_t index, const void* data, size_t size, double ts)
+{
+    size_t offset{ 0 };
+    Chunk& chunk = locate(index, offset);
+    unsigned char* destination = chunk.data + offset * m_sample_size;
+    const size_t bytes_to_copy = std::min(size, m_sample_size);
+    if (bytes_to_copy > 0) {
+        std::memcpy(destination, data, bytes_to_copy);
+    }
+    if (bytes_to_copy < m_sample_size) {
+        std::memset(destination + bytes_to_copy, 0, m_sample_size - bytes_to_copy);
+    }
+    if (m_store_timestamps) {
+        chunk.timestamps[offset] = ts;
+    }
+}
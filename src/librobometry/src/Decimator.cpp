@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/Decimator.h>
+
+#include <algorithm>
+#include <cmath>
+
+robometry::Decimator::Decimator(size_t factor, bool filter)
+    : m_factor(std::max<size_t>(factor, 1))
+    , m_filter(filter && factor > 1)
+{
+    if (!m_filter) {
+        return;
+    }
+
+    // Butterworth low-pass designed with the bilinear transform, the cutoff is sampling_frequency / (4 * factor)
+    const double pi = std::acos(-1.0);
+    const double k = std::tan(pi / (4.0 * static_cast<double>(m_factor)));
+    const double q = 1.0 / std::sqrt(2.0);
+    const double norm = 1.0 / (1.0 + k / q + k * k);
+    m_b0 = k * k * norm;
+    m_b1 = 2.0 * m_b0;
+    m_b2 = m_b0;
+    m_a1 = 2.0 * (k * k - 1.0) * norm;
+    m_a2 = (1.0 - k / q + k * k) * norm;
+}
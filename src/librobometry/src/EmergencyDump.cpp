@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/EmergencyDump.h>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct robometry::EmergencyDump::Entry {
+    const ContiguousBuffer* buffer{ nullptr };
+    std::string schema_record; // The complete schema record, written before the block
+    BinaryLogWriter::RecordKind block_kind{ BinaryLogWriter::RecordKind::ChannelBlock };
+    uint32_t id{ 0 };
+    bool with_timestamps{ false };
+    Entry* clock_group{ nullptr };
+    Entry* next{ nullptr };
+    size_t num_samples{ 0 }; // The number of samples to dump, computed by the signal handler
+};
+
+namespace {
+
+using RecordKind = robometry::BinaryLogWriter::RecordKind;
+
+constexpr size_t record_header_size = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint64_t);
+
+void appendRecordHeader(char* out, RecordKind kind, uint32_t id, uint64_t payload_size)
+{
+    const auto kind_value = static_cast<uint8_t>(kind);
+    std::memcpy(out, &kind_value, sizeof(kind_value));
+    std::memcpy(out + sizeof(kind_value), &id, sizeof(id));
+    std::memcpy(out + sizeof(kind_value) + sizeof(id), &payload_size, sizeof(payload_size));
+}
+
+std::string makeRecord(RecordKind kind, uint32_t id, const std::string& payload)
+{
+    std::string record(record_header_size, '\0');
+    appendRecordHeader(record.data(), kind, id, payload.size());
+    return record + payload;
+}
+
+#ifndef _WIN32
+
+constexpr int dumped_signals[] = { SIGSEGV, SIGABRT, SIGTERM };
+constexpr size_t max_dumps{ 16 };
+
+// The dumps written by the signal handler
+std::atomic<robometry::EmergencyDump*> registered_dumps[max_dumps];
+struct sigaction previous_actions[std::size(dumped_signals)];
+std::once_flag handlers_installed;
+
+// Only async-signal-safe calls
+bool writeAll(int file, const void* data, size_t size)
+{
+    auto bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        const ssize_t written = ::write(file, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void signalHandler(int signal_number)
+{
+    const int saved_errno = errno;
+    for (auto& registered : registered_dumps) {
+        auto dump = registered.load(std::memory_order_acquire);
+        if (dump != nullptr) {
+            dump->dump();
+        }
+    }
+
+    // The signal is raised again with the previous handler, it is delivered when this handler returns
+    for (size_t i = 0; i < std::size(dumped_signals); ++i) {
+        if (dumped_signals[i] == signal_number) {
+            sigaction(signal_number, &previous_actions[i], nullptr);
+        }
+    }
+    raise(signal_number);
+    errno = saved_errno;
+}
+
+void installHandlers()
+{
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_ONSTACK;
+    for (size_t i = 0; i < std::size(dumped_signals); ++i) {
+        sigaction(dumped_signals[i], &action, &previous_actions[i]);
+    }
+}
+
+#endif
+
+} // namespace
+
+robometry::EmergencyDump::~EmergencyDump()
+{
+    close();
+    auto entry = m_entries.exchange(nullptr);
+    while (entry != nullptr) {
+        auto next = entry->next;
+        delete entry;
+        entry = next;
+    }
+}
+
+bool robometry::EmergencyDump::open(const std::string& file_name, const BufferConfig& config)
+{
+#ifdef _WIN32
+    std::cout << "The emergency dump is not supported on Windows." << std::endl;
+    static_cast<void>(file_name);
+    static_cast<void>(config);
+    return false;
+#else
+    if (isOpen()) {
+        std::cout << "The emergency dump is already open." << std::endl;
+        return false;
+    }
+    m_file = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_file < 0) {
+        std::cout << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    m_file_name = file_name;
+
+    m_header.assign(BinaryLogWriter::magic, sizeof(BinaryLogWriter::magic));
+    m_header.append(reinterpret_cast<const char*>(&BinaryLogWriter::version), sizeof(BinaryLogWriter::version));
+    m_header += makeRecord(RecordKind::Header, 0, nlohmann::json{ {"filename", config.filename},
+                                                                  {"yarp_robot_name", config.yarp_robot_name},
+                                                                  {"description_list", config.description_list} }.dump());
+
+    std::call_once(handlers_installed, installHandlers);
+    for (auto& registered : registered_dumps) {
+        EmergencyDump* expected{ nullptr };
+        if (registered.compare_exchange_strong(expected, this, std::memory_order_acq_rel)) {
+            return true;
+        }
+    }
+    std::cout << "Too many emergency dumps are open, at most " << max_dumps << " are supported." << std::endl;
+    close();
+    return false;
+#endif
+}
+
+bool robometry::EmergencyDump::isOpen() const
+{
+    return m_file >= 0;
+}
+
+void robometry::EmergencyDump::close()
+{
+#ifndef _WIN32
+    for (auto& registered : registered_dumps) {
+        EmergencyDump* expected{ this };
+        registered.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+    }
+    if (m_file >= 0) {
+        ::close(m_file);
+        // The file is kept only if the dump has been written
+        if (!m_dumped) {
+            ::unlink(m_file_name.c_str());
+        }
+        m_file = -1;
+    }
+#endif
+}
+
+robometry::EmergencyDump::Entry* robometry::EmergencyDump::addClockGroup(const std::string& name, const ContiguousBuffer& timestamps)
+{
+    if (!isOpen()) {
+        return nullptr;
+    }
+    auto entry = new Entry();
+    entry->buffer = &timestamps;
+    entry->block_kind = BinaryLogWriter::RecordKind::ClockGroupBlock;
+    std::scoped_lock<std::mutex> lock{ m_mutex };
+    entry->id = m_clock_groups++;
+    entry->schema_record = makeRecord(RecordKind::ClockGroupSchema, entry->id, nlohmann::json{ {"name", name} }.dump());
+    return add(entry);
+}
+
+robometry::EmergencyDump::Entry* robometry::EmergencyDump::addChannel(const BinaryLogChannelSchema& schema,
+                                                                      const ContiguousBuffer& buffer,
+                                                                      Entry* clock_group)
+{
+    if (!isOpen()) {
+        return nullptr;
+    }
+    auto entry = new Entry();
+    entry->buffer = &buffer;
+    entry->with_timestamps = clock_group == nullptr && buffer.storeTimestamps();
+    entry->clock_group = clock_group;
+    std::scoped_lock<std::mutex> lock{ m_mutex };
+    entry->id = m_channels++;
+    entry->schema_record = makeRecord(RecordKind::ChannelSchema, entry->id, channelSchemaToJson(schema));
+    return add(entry);
+}
+
+robometry::EmergencyDump::Entry* robometry::EmergencyDump::add(Entry* entry)
+{
+    // The entry is published only once it is complete
+    entry->next = m_entries.load(std::memory_order_relaxed);
+    m_entries.store(entry, std::memory_order_release);
+    return entry;
+}
+
+bool robometry::EmergencyDump::dump()
+{
+#ifdef _WIN32
+    return false;
+#else
+    if (!isOpen() || m_dumped.exchange(true)) {
+        return false;
+    }
+
+    // The channels of a clock group are dumped with the number of samples available in all of them
+    Entry* first = m_entries.load(std::memory_order_acquire);
+    for (Entry* entry = first; entry != nullptr; entry = entry->next) {
+        entry->num_samples = entry->buffer->size();
+    }
+    for (Entry* entry = first; entry != nullptr; entry = entry->next) {
+        if (entry->clock_group != nullptr) {
+            entry->clock_group->num_samples = std::min(entry->clock_group->num_samples, entry->num_samples);
+        }
+    }
+    for (Entry* entry = first; entry != nullptr; entry = entry->next) {
+        if (entry->clock_group != nullptr) {
+            entry->num_samples = entry->clock_group->num_samples;
+        }
+    }
+
+    bool ok = writeAll(m_file, m_header.data(), m_header.size());
+    // The schemas of the clock groups are written before the ones of the channels referring to them
+    for (const bool clock_groups : { true, false }) {
+        for (Entry* entry = first; entry != nullptr; entry = entry->next) {
+            if ((entry->block_kind == RecordKind::ClockGroupBlock) != clock_groups) {
+                continue;
+            }
+            const uint64_t num_samples = entry->num_samples;
+            const size_t sample_size = entry->buffer->sampleSize();
+            uint64_t payload_size = sizeof(num_samples) + num_samples * sample_size;
+            if (entry->with_timestamps) {
+                payload_size += num_samples * sizeof(double);
+            }
+            char record_header[record_header_size];
+            appendRecordHeader(record_header, entry->block_kind, entry->id, payload_size);
+
+            ok = writeAll(m_file, entry->schema_record.data(), entry->schema_record.size()) && ok;
+            ok = writeAll(m_file, record_header, sizeof(record_header)) && ok;
+            ok = writeAll(m_file, &num_samples, sizeof(num_samples)) && ok;
+            entry->buffer->visitNewest(num_samples, [this, sample_size, &ok](const unsigned char* data, const double*, size_t count) {
+                ok = writeAll(m_file, data, count * sample_size) && ok;
+            });
+            if (entry->with_timestamps) {
+                entry->buffer->visitNewest(num_samples, [this, &ok](const unsigned char*, const double* timestamps, size_t count) {
+                    ok = writeAll(m_file, timestamps, count * sizeof(double)) && ok;
+                });
+            }
+        }
+    }
+    return ok;
+#endif
+}
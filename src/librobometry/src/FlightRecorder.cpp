@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/FlightRecorder.h>
+#include <robometry/BufferManager.h> // robometry_fs
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <new>
+
+struct robometry::FlightRecorderRing::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint64_t capacity;
+    uint64_t sample_size;
+    uint64_t schema_size;
+    uint64_t data_offset;
+    uint64_t timestamps_offset; // 0 if the timestamps are not stored
+    std::atomic<uint64_t> write_index;
+};
+
+namespace {
+
+constexpr const char* session_file_name = "session.json";
+constexpr const char* ring_extension = ".rbring";
+
+size_t alignTo(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+bool robometry::FlightRecorderRing::open(const std::string& file_name, Kind kind, const BinaryLogChannelSchema& schema, size_t capacity)
+{
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "The write index has to be lock free to be shared through the file.");
+    static_assert(sizeof(Header) == sizeof(magic) + 2 * sizeof(uint32_t) + 6 * sizeof(uint64_t), "The header cannot have padding.");
+    close();
+    if (capacity == 0 || schema.sample_size == 0) {
+        std::cout << "The flight recorder ring of " << schema.name << " cannot be empty." << std::endl;
+        return false;
+    }
+
+    const std::string json = channelSchemaToJson(schema);
+    const bool store_timestamps = kind == Kind::Channel && schema.clock_group.empty();
+    const size_t data_offset = alignTo(sizeof(Header) + json.size(), alignof(std::max_align_t));
+    const size_t timestamps_offset = store_timestamps ? alignTo(data_offset + capacity * schema.sample_size, sizeof(double)) : 0;
+    const size_t file_size = store_timestamps ? timestamps_offset + capacity * sizeof(double) : data_offset + capacity * schema.sample_size;
+
+    auto file = std::make_unique<MappedFile>();
+    void* address = file->createPersistent(file_name) ? file->map(file_size) : nullptr;
+    if (address == nullptr) {
+        std::cout << "Failed to create the flight recorder ring of " << schema.name << " in " << file_name << std::endl;
+        return false;
+    }
+
+    auto bytes = static_cast<unsigned char*>(address);
+    m_header = new (address) Header();
+    m_header->version = version;
+    m_header->kind = static_cast<uint32_t>(kind);
+    m_header->capacity = capacity;
+    m_header->sample_size = schema.sample_size;
+    m_header->schema_size = json.size();
+    m_header->data_offset = data_offset;
+    m_header->timestamps_offset = timestamps_offset;
+    m_header->write_index.store(0, std::memory_order_relaxed);
+    std::memcpy(bytes + sizeof(Header), json.data(), json.size());
+    // The magic is written last, so that a ring whose header is incomplete is not recognized
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(m_header->magic, magic, sizeof(magic));
+
+    m_file = std::move(file);
+    m_data = bytes + data_offset;
+    m_timestamps = store_timestamps ? reinterpret_cast<double*>(bytes + timestamps_offset) : nullptr;
+    m_capacity = capacity;
+    m_sample_size = schema.sample_size;
+    m_write_index = 0;
+    return true;
+}
+
+bool robometry::FlightRecorderRing::isOpen() const
+{
+    return m_header != nullptr;
+}
+
+void robometry::FlightRecorderRing::close()
+{
+    m_header = nullptr;
+    m_data = nullptr;
+    m_timestamps = nullptr;
+    m_file.reset();
+}
+
+void robometry::FlightRecorderRing::push_back(const void* data, size_t size, double ts)
+{
+    const size_t slot = m_write_index % m_capacity;
+    unsigned char* destination = m_data + slot * m_sample_size;
+    const size_t bytes_to_copy = std::min(size, m_sample_size);
+    if (bytes_to_copy > 0) {
+        std::memcpy(destination, data, bytes_to_copy);
+    }
+    if (bytes_to_copy < m_sample_size) {
+        std::memset(destination + bytes_to_copy, 0, m_sample_size - bytes_to_copy);
+    }
+    if (m_timestamps != nullptr) {
+        m_timestamps[slot] = ts;
+    }
+    m_header->write_index.store(++m_write_index, std::memory_order_release);
+}
+
+void robometry::FlightRecorderRing::push_back(const void* data, const double* timestamps, size_t num_samples)
+{
+    auto in = static_cast<const unsigned char*>(data);
+    size_t remaining = num_samples;
+    while (remaining > 0) {
+        const size_t slot = m_write_index % m_capacity;
+        const size_t count = std::min(remaining, m_capacity - slot);
+        std::memcpy(m_data + slot * m_sample_size, in, count * m_sample_size);
+        if (m_timestamps != nullptr) {
+            std::copy_n(timestamps, count, m_timestamps + slot);
+        }
+        in += count * m_sample_size;
+        timestamps += count;
+        remaining -= count;
+        m_write_index += count;
+    }
+    m_header->write_index.store(m_write_index, std::memory_order_release);
+}
+
+bool robometry::createFlightRecorderSession(const std::string& directory, const BufferConfig& config)
+{
+    std::error_code ec;
+    robometry_fs::create_directories(directory, ec);
+    std::ofstream session((robometry_fs::path(directory) / session_file_name).string(), std::ios::trunc);
+    if (!session.is_open()) {
+        std::cout << "Failed to create the flight recorder session in " << directory << std::endl;
+        return false;
+    }
+    session << nlohmann::json{ {"filename", config.filename},
+                               {"yarp_robot_name", config.yarp_robot_name},
+                               {"description_list", config.description_list} }.dump(4);
+    return session.good();
+}
+
+namespace {
+
+// The content of a ring read back from its file
+struct RecoveredRing {
+    robometry::FlightRecorderRing::Kind kind{ robometry::FlightRecorderRing::Kind::Channel };
+    robometry::BinaryLogChannelSchema schema;
+    uint64_t capacity{ 0 };
+    uint64_t write_index{ 0 };
+    std::vector<unsigned char> data; // In the order of the slots
+    std::vector<double> timestamps; // Empty if not stored
+
+    // The monotonic index of the oldest sample available
+    uint64_t begin() const
+    {
+        return write_index - std::min(write_index, capacity);
+    }
+
+    // Copy the samples with the monotonic indices in [first, last)
+    robometry::BinaryLogChannelSamples extract(uint64_t first, uint64_t last) const
+    {
+        robometry::BinaryLogChannelSamples samples;
+        samples.schema = schema;
+        samples.num_samples = last - first;
+        samples.data.reserve(samples.num_samples * schema.sample_size);
+        for (uint64_t i = first; i < last; ++i) {
+            const size_t slot = i % capacity;
+            const unsigned char* sample = data.data() + slot * schema.sample_size;
+            samples.data.insert(samples.data.end(), sample, sample + schema.sample_size);
+            if (!timestamps.empty()) {
+                samples.timestamps.push_back(timestamps[slot]);
+            }
+        }
+        return samples;
+    }
+};
+
+bool readRing(const std::string& file_name, RecoveredRing& ring)
+{
+    using Ring = robometry::FlightRecorderRing;
+    std::ifstream input(file_name, std::ios::binary | std::ios::ate);
+    if (!input.is_open()) {
+        std::cout << "Failed to open " << file_name << std::endl;
+        return false;
+    }
+    const uint64_t file_size = static_cast<uint64_t>(input.tellg());
+    input.seekg(0, std::ios::beg);
+
+    // The header is read field by field, it has no padding and it is followed by the description of the channel
+    char magic[sizeof(Ring::magic)];
+    uint32_t version{ 0 }, kind{ 0 };
+    uint64_t sample_size{ 0 }, schema_size{ 0 }, data_offset{ 0 }, timestamps_offset{ 0 };
+    input.read(magic, sizeof(magic));
+    input.read(reinterpret_cast<char*>(&version), sizeof(version));
+    input.read(reinterpret_cast<char*>(&kind), sizeof(kind));
+    input.read(reinterpret_cast<char*>(&ring.capacity), sizeof(ring.capacity));
+    input.read(reinterpret_cast<char*>(&sample_size), sizeof(sample_size));
+    input.read(reinterpret_cast<char*>(&schema_size), sizeof(schema_size));
+    input.read(reinterpret_cast<char*>(&data_offset), sizeof(data_offset));
+    input.read(reinterpret_cast<char*>(&timestamps_offset), sizeof(timestamps_offset));
+    input.read(reinterpret_cast<char*>(&ring.write_index), sizeof(ring.write_index));
+    if (!input || std::memcmp(magic, Ring::magic, sizeof(magic)) != 0 || version != Ring::version) {
+        std::cout << file_name << " is not a flight recorder ring of version " << Ring::version << ", skipping" << std::endl;
+        return false;
+    }
+    const uint64_t header_size = static_cast<uint64_t>(input.tellg());
+    const uint64_t data_size = ring.capacity * sample_size;
+    const uint64_t end = timestamps_offset != 0 ? timestamps_offset + ring.capacity * sizeof(double) : data_offset + data_size;
+    if (ring.capacity == 0 || sample_size == 0 || data_offset < header_size + schema_size ||
+        (timestamps_offset != 0 && timestamps_offset < data_offset + data_size) || end > file_size) {
+        std::cout << file_name << " is malformed, skipping" << std::endl;
+        return false;
+    }
+
+    std::string json(schema_size, '\0');
+    input.read(json.data(), schema_size);
+    if (!input || !robometry::channelSchemaFromJson(json, ring.schema) || ring.schema.sample_size != sample_size) {
+        std::cout << "The description of the channel in " << file_name << " is malformed, skipping" << std::endl;
+        return false;
+    }
+    ring.kind = static_cast<Ring::Kind>(kind);
+
+    ring.data.resize(data_size);
+    input.seekg(static_cast<std::streamoff>(data_offset), std::ios::beg);
+    input.read(reinterpret_cast<char*>(ring.data.data()), data_size);
+    if (timestamps_offset != 0) {
+        ring.timestamps.resize(ring.capacity);
+        input.seekg(static_cast<std::streamoff>(timestamps_offset), std::ios::beg);
+        input.read(reinterpret_cast<char*>(ring.timestamps.data()), ring.capacity * sizeof(double));
+    }
+    if (!input) {
+        std::cout << "Failed to read the samples of " << file_name << ", skipping" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool robometry::flightRecorderToMat(const std::string& directory,
+                                    const std::string& mat_file_name,
+                                    matioCpp::FileVersion mat_file_version)
+{
+    BinaryLogContent content;
+    std::ifstream session((robometry_fs::path(directory) / session_file_name).string());
+    if (!session.is_open()) {
+        std::cout << directory << " is not a flight recorder session, " << session_file_name << " is missing." << std::endl;
+        return false;
+    }
+    try {
+        const auto header = nlohmann::json::parse(session);
+        content.filename = header.value("filename", content.filename);
+        content.yarp_robot_name = header.value("yarp_robot_name", std::string());
+        content.description_list = header.value("description_list", std::vector<std::string>());
+    }
+    catch (const nlohmann::json::exception& e) {
+        std::cout << "Failed to parse " << session_file_name << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    // The rings are sorted by file name, i.e. in the order they have been created
+    std::map<std::string, RecoveredRing> rings;
+    std::error_code ec;
+    for (const auto& entry : robometry_fs::directory_iterator(directory, ec)) {
+        if (entry.path().extension() != ring_extension) {
+            continue;
+        }
+        RecoveredRing ring;
+        if (readRing(entry.path().string(), ring)) {
+            rings.emplace(entry.path().filename().string(), std::move(ring));
+        }
+    }
+    if (ec) {
+        std::cout << "Failed to list the content of " << directory << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    // The samples of a clock group are aligned by their monotonic index, hence the channels of the group
+    // and its timestamps are cut to the indices available in all of them
+    struct Range {
+        uint64_t begin{ 0 };
+        uint64_t end{ std::numeric_limits<uint64_t>::max() };
+    };
+    std::map<std::string, Range> clock_group_ranges;
+    for (const auto& [file_name, ring] : rings) {
+        const bool is_group = ring.kind == FlightRecorderRing::Kind::ClockGroup;
+        if (!is_group && ring.schema.clock_group.empty()) {
+            continue;
+        }
+        auto& range = clock_group_ranges[is_group ? ring.schema.name : ring.schema.clock_group];
+        range.begin = std::max(range.begin, ring.begin());
+        range.end = std::min(range.end, ring.write_index);
+    }
+
+    for (const auto& [file_name, ring] : rings) {
+        if (ring.kind == FlightRecorderRing::Kind::ClockGroup) {
+            const auto& range = clock_group_ranges[ring.schema.name];
+            const auto samples = ring.extract(range.begin, std::max(range.begin, range.end));
+            auto& timestamps = content.clock_groups[ring.schema.name];
+            timestamps.resize(samples.num_samples);
+            std::memcpy(timestamps.data(), samples.data.data(), samples.data.size());
+        }
+        else if (ring.schema.clock_group.empty()) {
+            content.channels.push_back(ring.extract(ring.begin(), ring.write_index));
+        }
+        else {
+            const auto& range = clock_group_ranges[ring.schema.clock_group];
+            content.channels.push_back(ring.extract(range.begin, std::max(range.begin, range.end)));
+        }
+    }
+
+    for (const auto& channel : content.channels) {
+        if (!channel.schema.clock_group.empty() && content.clock_groups.count(channel.schema.clock_group) == 0) {
+            std::cout << "The timestamps of the clock group " << channel.schema.clock_group << " are missing." << std::endl;
+        }
+    }
+    return logContentToMat(content, mat_file_name, mat_file_version);
+}
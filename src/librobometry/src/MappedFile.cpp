@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/MappedFile.h>
+#include <robometry/BufferManager.h> // robometry_fs
+
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+size_t allocationGranularity()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+}
+
+robometry::MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    for (auto& region : m_regions) {
+        UnmapViewOfFile(region.address);
+        CloseHandle(region.mapping);
+    }
+    if (m_file != nullptr) {
+        CloseHandle(m_file);
+    }
+#else
+    for (auto& region : m_regions) {
+        munmap(region.address, region.size);
+    }
+    if (m_file >= 0) {
+        close(m_file);
+    }
+#endif
+}
+
+bool robometry::MappedFile::create(const std::string& directory)
+{
+#ifdef _WIN32
+    char file_name[MAX_PATH];
+    if (GetTempFileNameA(directory.c_str(), "rbm", 0, file_name) == 0) {
+        std::cout << "Failed to create a temporary file in " << directory << std::endl;
+        return false;
+    }
+    // The file is deleted by the system when the handle is closed, also if the process crashes
+    HANDLE file = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cout << "Failed to open the temporary file " << file_name << std::endl;
+        DeleteFileA(file_name);
+        return false;
+    }
+    m_file = file;
+#else
+    std::string file_name = (robometry_fs::path(directory) / "robometry_XXXXXX").string();
+    m_file = mkstemp(file_name.data());
+    if (m_file < 0) {
+        std::cout << "Failed to create a temporary file in " << directory << std::endl;
+        return false;
+    }
+    // The file is removed from the file system now, the space on disk is released when the descriptor is closed
+    unlink(file_name.c_str());
+#endif
+    return true;
+}
+
+bool robometry::MappedFile::createPersistent(const std::string& file_name)
+{
+#ifdef _WIN32
+    // The file can be read and removed while it is mapped
+    HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                              nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cout << "Failed to create " << file_name << std::endl;
+        return false;
+    }
+    m_file = file;
+#else
+    m_file = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_file < 0) {
+        std::cout << "Failed to create " << file_name << std::endl;
+        return false;
+    }
+#endif
+    return true;
+}
+
+void* robometry::MappedFile::map(size_t size)
+{
+    std::scoped_lock<std::mutex> lock{ m_mutex };
+    const size_t granularity = allocationGranularity();
+    Region region;
+    region.size = (size + granularity - 1) / granularity * granularity;
+    const size_t offset = m_file_size;
+    const size_t new_file_size = offset + region.size;
+
+#ifdef _WIN32
+    if (m_file == nullptr) {
+        return nullptr;
+    }
+    const DWORD size_high = static_cast<DWORD>(static_cast<unsigned long long>(new_file_size) >> 32);
+    const DWORD size_low = static_cast<DWORD>(new_file_size & 0xFFFFFFFF);
+    // Creating the mapping extends the file to the requested size
+    region.mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, size_high, size_low, nullptr);
+    if (region.mapping == nullptr) {
+        return nullptr;
+    }
+    const DWORD offset_high = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+    const DWORD offset_low = static_cast<DWORD>(offset & 0xFFFFFFFF);
+    region.address = MapViewOfFile(region.mapping, FILE_MAP_ALL_ACCESS, offset_high, offset_low, region.size);
+    if (region.address == nullptr) {
+        CloseHandle(region.mapping);
+        return nullptr;
+    }
+#else
+    if (m_file < 0) {
+        return nullptr;
+    }
+    // The space is reserved on disk, so that running out of space is detected here and not when writing the memory
+#ifdef __linux__
+    if (posix_fallocate(m_file, static_cast<off_t>(offset), static_cast<off_t>(region.size)) != 0) {
+        return nullptr;
+    }
+#else
+    if (ftruncate(m_file, static_cast<off_t>(new_file_size)) != 0) {
+        return nullptr;
+    }
+#endif
+    region.address = mmap(nullptr, region.size, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, static_cast<off_t>(offset));
+    if (region.address == MAP_FAILED) {
+        return nullptr;
+    }
+#endif
+
+    m_file_size = new_file_size;
+    m_regions.push_back(region);
+    return region.address;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/ThreadPool.h>
+
+robometry::ThreadPool::ThreadPool(size_t num_threads)
+{
+    for (size_t i = 1; i < num_threads; ++i) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+robometry::ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock<std::mutex> lock{ m_mutex };
+        m_stop = true;
+    }
+    m_cv_start.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+size_t robometry::ThreadPool::size() const
+{
+    return m_workers.size() + 1;
+}
+
+void robometry::ThreadPool::parallelFor(size_t num_tasks, const std::function<void(size_t)>& task)
+{
+    std::scoped_lock<std::mutex> loop_lock{ m_loop_mutex };
+    {
+        std::scoped_lock<std::mutex> lock{ m_mutex };
+        m_task = &task;
+        m_num_tasks = num_tasks;
+        m_next_task = 0;
+        m_exception = nullptr;
+        m_active_workers = m_workers.size();
+        ++m_generation;
+    }
+    m_cv_start.notify_all();
+
+    runTasks();
+
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    m_cv_done.wait(lock, [this]() { return m_active_workers == 0; });
+    m_task = nullptr;
+    if (m_exception) {
+        std::rethrow_exception(m_exception);
+    }
+}
+
+void robometry::ThreadPool::workerLoop()
+{
+    size_t generation{ 0 };
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{ m_mutex };
+            m_cv_start.wait(lock, [this, generation]() { return m_stop || m_generation != generation; });
+            if (m_stop) {
+                return;
+            }
+            generation = m_generation;
+        }
+
+        runTasks();
+
+        {
+            std::scoped_lock<std::mutex> lock{ m_mutex };
+            --m_active_workers;
+        }
+        m_cv_done.notify_one();
+    }
+}
+
+void robometry::ThreadPool::runTasks()
+{
+    for (size_t i = m_next_task++; i < m_num_tasks; i = m_next_task++) {
+        try {
+            (*m_task)(i);
+        }
+        catch (...) {
+            std::scoped_lock<std::mutex> lock{ m_mutex };
+            if (!m_exception) {
+                m_exception = std::current_exception();
+            }
+        }
+    }
+}
@@ -9,6 +9,7 @@
 #include <array>
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <string>
 
 using namespace robometry;
@@ -23,6 +24,17 @@ void convertVectorFromDegreesToRadians(std::vector<double>& inVec) {
     std::transform(inVec.begin(), inVec.end(), inVec.begin(), [](double el) -> double { return el * M_PI / 180.0; });
 }
 
+// Used for the readings that failed, since all the channels of a frame have to be pushed together
+void fillVectorWithNaN(std::vector<double>& inVec) {
+    std::fill(inVec.begin(), inVec.end(), std::numeric_limits<double>::quiet_NaN());
+}
+
+void setInFrame(FrameHandle& frame, const ChannelHandle& channel, const std::vector<double>& inVec) {
+    if (!frame.set(channel, inVec)) {
+        yWarning() << "telemetryDeviceDumper warning : the channel" << channel.name() << "cannot be set in the frame of the sensors";
+    }
+}
+
 void addVectorOfStringToProperty(yarp::os::Property& prop, std::string key, std::vector<std::string>& list)
 {
     prop.addGroup(key);
@@ -460,6 +472,53 @@ bool TelemetryDeviceDumper::configBufferManager(yarp::os::Searchable& conf) {
     return ok;
 }
 
+void TelemetryDeviceDumper::getChannelHandles() {
+    // The handles of the channels that have not been added are not valid, but they are never used
+    channelHandles.jointPos = bufferManager.getChannelHandle("joints_state::positions");
+    channelHandles.jointVel = bufferManager.getChannelHandle("joints_state::velocities");
+    channelHandles.jointAcc = bufferManager.getChannelHandle("joints_state::accelerations");
+    channelHandles.jointPosErr = bufferManager.getChannelHandle("PIDs::position_error");
+    channelHandles.jointPosRef = bufferManager.getChannelHandle("PIDs::position_reference");
+    channelHandles.jointTrqErr = bufferManager.getChannelHandle("PIDs::torque_error");
+    channelHandles.jointTrqRef = bufferManager.getChannelHandle("PIDs::torque_reference");
+    channelHandles.jointPWM = bufferManager.getChannelHandle("motors_state::PWM");
+    channelHandles.jointCurr = bufferManager.getChannelHandle("motors_state::currents");
+    channelHandles.jointTrq = bufferManager.getChannelHandle("joints_state::torques");
+    channelHandles.motorEnc = bufferManager.getChannelHandle("motors_state::positions");
+    channelHandles.motorVel = bufferManager.getChannelHandle("motors_state::velocities");
+    channelHandles.motorAcc = bufferManager.getChannelHandle("motors_state::accelerations");
+    channelHandles.motorTemp = bufferManager.getChannelHandle("motors_state::temperatures");
+    channelHandles.controlModes = bufferManager.getChannelHandle("joints_state::control_mode");
+    channelHandles.interactionModes = bufferManager.getChannelHandle("joints_state::interaction_mode");
+    channelHandles.odometryData = bufferManager.getChannelHandle("odometry_data");
+}
+
+bool TelemetryDeviceDumper::addSensorsFrame() {
+    // The channels read in readSensors are pushed all together, with a single timestamp
+    std::vector<std::string> channelNames;
+    for (const auto* handle : { &channelHandles.jointPos, &channelHandles.jointVel, &channelHandles.jointAcc,
+                                &channelHandles.jointPosErr, &channelHandles.jointPosRef, &channelHandles.jointTrqErr,
+                                &channelHandles.jointTrqRef, &channelHandles.jointPWM, &channelHandles.jointCurr,
+                                &channelHandles.jointTrq, &channelHandles.motorEnc, &channelHandles.motorVel,
+                                &channelHandles.motorAcc, &channelHandles.motorTemp, &channelHandles.controlModes,
+                                &channelHandles.interactionModes }) {
+        if (handle->isValid()) {
+            channelNames.push_back(handle->name());
+        }
+    }
+
+    if (channelNames.empty()) {
+        return true;
+    }
+
+    if (!bufferManager.addFrame("sensors", channelNames)) {
+        yError() << "telemetryDeviceDumper: failed to add the frame of the sensors";
+        return false;
+    }
+    sensorsFrame = bufferManager.getFrameHandle("sensors");
+    return true;
+}
+
 bool TelemetryDeviceDumper::attachAll(const yarp::dev::PolyDriverList& device2attach) {
     std::lock_guard<std::mutex> guard(this->deviceMutex);
 
@@ -474,11 +533,21 @@ bool TelemetryDeviceDumper::attachAll(const yarp::dev::PolyDriverList& device2at
         for (auto [k, m] : metadata.metadataMap)
         {
             ok = ok && bufferManager.addChannel({ "raw_data_values::"+k, {static_cast<uint16_t>(m.size), 1}, m.rawValueNames });
+            if (ok)
+            {
+                rawDataValuesHandles[k] = bufferManager.getChannelHandle("raw_data_values::"+k);
+            }
         }
     }
     
     ok = ok && bufferManager.configure(m_bufferConfig);
     
+    if (ok)
+    {
+        this->getChannelHandles();
+        ok = this->addSensorsFrame();
+    }
+
     if (ok)
     {
         correctlyConfigured = true;
@@ -531,11 +600,9 @@ void TelemetryDeviceDumper::readSensors()
         if (!sensorsReadCorrectly)
         {
             yWarning() << "telemetryDeviceDumper warning : joint positions was not read correctly";
+            fillVectorWithNaN(jointPos);
         }
-        else
-        {
-            bufferManager.push_back(jointPos, "joints_state::positions");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointPos, jointPos);
     }
 
     // At the moment we are assuming that all joints are revolute
@@ -547,11 +614,9 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : joint velocities was not read correctly";
+            fillVectorWithNaN(jointVel);
         }
-        else
-        {
-            bufferManager.push_back(jointVel , "joints_state::velocities");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointVel, jointVel);
 
     }
 
@@ -562,11 +627,9 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : joint accelerations was not read correctly";
+            fillVectorWithNaN(jointAcc);
         }
-        else
-        {
-            bufferManager.push_back(jointAcc, "joints_state::accelerations");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointAcc, jointAcc);
 
 
     }
@@ -578,22 +641,18 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : joint position errors was not read correctly";
+            fillVectorWithNaN(jointPosErr);
         }
-        else
-        {
-            bufferManager.push_back(jointPosErr, "PIDs::position_error");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointPosErr, jointPosErr);
 
         ok = remappedControlBoardInterfaces.pid->getPidReferences(VOCAB_PIDTYPE_POSITION, jointPosRef.data());
         sensorsReadCorrectly = sensorsReadCorrectly && ok;
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : joint position references was not read correctly";
+            fillVectorWithNaN(jointPosRef);
         }
-        else
-        {
-            bufferManager.push_back(jointPosRef, "PIDs::position_reference");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointPosRef, jointPosRef);
 
 
         ok = remappedControlBoardInterfaces.pid->getPidErrors(VOCAB_PIDTYPE_TORQUE, jointTrqErr.data());
@@ -601,22 +660,18 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : joint torque errors was not read correctly";
+            fillVectorWithNaN(jointTrqErr);
         }
-        else
-        {
-            bufferManager.push_back(jointPosErr, "PIDs::torque_error");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointTrqErr, jointTrqErr);
 
         ok = remappedControlBoardInterfaces.pid->getPidReferences(VOCAB_PIDTYPE_TORQUE, jointTrqRef.data());
         sensorsReadCorrectly = sensorsReadCorrectly && ok;
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : joint torque references was not read correctly";
+            fillVectorWithNaN(jointTrqRef);
         }
-        else
-        {
-            bufferManager.push_back(jointTrqRef, "PIDs::torque_reference");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointTrqRef, jointTrqRef);
     }
     // Read amplifier
     if (settings.logIAmplifierControl || settings.logControlBoardQuantities) {
@@ -628,22 +683,18 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : voltage PWM was not read correctly";
+            fillVectorWithNaN(jointPWM);
         }
-        else
-        {
-            bufferManager.push_back(jointPWM, "motors_state::PWM");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointPWM, jointPWM);
 
         ok = remappedControlBoardInterfaces.amp->getCurrents(jointCurr.data());
         sensorsReadCorrectly = sensorsReadCorrectly && ok;
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : current was not read correctly";
+            fillVectorWithNaN(jointCurr);
         }
-        else
-        {
-            bufferManager.push_back(jointCurr, "motors_state::currents");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointCurr, jointCurr);
     }
     // Read torque
     if (settings.logITorqueControl || settings.logControlBoardQuantities) {
@@ -652,11 +703,9 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : torque was not read correctly";
+            fillVectorWithNaN(jointTrq);
         }
-        else
-        {
-            bufferManager.push_back(jointTrq, "joints_state::torques");
-        }
+        setInFrame(sensorsFrame, channelHandles.jointTrq, jointTrq);
     }
 
     // Read motor
@@ -666,33 +715,27 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : motor encoder was not read correctly";
+            fillVectorWithNaN(motorEnc);
         }
-        else
-        {
-            bufferManager.push_back(motorEnc, "motors_state::positions");
-        }
+        setInFrame(sensorsFrame, channelHandles.motorEnc, motorEnc);
 
         ok = remappedControlBoardInterfaces.imotenc->getMotorEncoderSpeeds(motorVel.data());
         sensorsReadCorrectly = sensorsReadCorrectly && ok;
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : motor velocity was not read correctly";
+            fillVectorWithNaN(motorVel);
         }
-        else
-        {
-            bufferManager.push_back(motorVel, "motors_state::velocities");
-        }
+        setInFrame(sensorsFrame, channelHandles.motorVel, motorVel);
 
         ok = remappedControlBoardInterfaces.imotenc->getMotorEncoderAccelerations(motorAcc.data());
         sensorsReadCorrectly = sensorsReadCorrectly && ok;
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : motor acceleration was not read correctly";
+            fillVectorWithNaN(motorAcc);
         }
-        else
-        {
-            bufferManager.push_back(motorAcc, "motors_state::accelerations");
-        }
+        setInFrame(sensorsFrame, channelHandles.motorAcc, motorAcc);
     }
 
     // Read motor temperatures
@@ -702,11 +745,9 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : motor temperature was not read correctly";
+            fillVectorWithNaN(motorTemp);
         }
-        else
-        {
-            bufferManager.push_back(motorTemp, "motors_state::temperatures");
-        }
+        setInFrame(sensorsFrame, channelHandles.motorTemp, motorTemp);
     }
 
     // Read modes
@@ -721,11 +762,9 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : control modes wa not read correctly";
+            fillVectorWithNaN(controlModes);
         }
-        else
-        {
-            bufferManager.push_back(controlModes, "joints_state::control_mode");
-        }
+        setInFrame(sensorsFrame, channelHandles.controlModes, controlModes);
     }
 
     if (settings.logIInteractionMode || settings.logControlBoardQuantities) {
@@ -744,11 +783,13 @@ void TelemetryDeviceDumper::readSensors()
         if (!ok)
         {
             yWarning() << "telemetryDeviceDumper warning : interaction mode was not read correctly";
+            fillVectorWithNaN(interactionModes);
         }
-        else
-        {
-            bufferManager.push_back(interactionModes, "joints_state::interaction_mode");
-        }
+        setInFrame(sensorsFrame, channelHandles.interactionModes, interactionModes);
+    }
+
+    if (sensorsFrame.isValid()) {
+        bufferManager.push_back(sensorsFrame);
     }
 
     if (settings.useRadians) {
@@ -775,7 +816,7 @@ void TelemetryDeviceDumper::readOdometryData() {
         odometryData[0] = yarpOdomData.odom_x;     odometryData[1] = yarpOdomData.odom_y;     odometryData[2] = yarpOdomData.odom_theta;
         odometryData[3] = yarpOdomData.base_vel_x; odometryData[4] = yarpOdomData.base_vel_y; odometryData[5] = yarpOdomData.base_vel_theta;
         odometryData[6] = yarpOdomData.odom_vel_x; odometryData[7] = yarpOdomData.odom_vel_y; odometryData[8] = yarpOdomData.odom_vel_theta;
-        bufferManager.push_back(odometryData, "odometry_data");
+        bufferManager.push_back(channelHandles.odometryData, odometryData);
     }
 }
 
@@ -791,7 +832,15 @@ void TelemetryDeviceDumper::readRawValuesData()
     {
         for (auto [key,value] : rawDataValuesMap)
         {
-            bufferManager.push_back(value, "raw_data_values::"+key);
+            auto handle = rawDataValuesHandles.find(key);
+            if (handle != rawDataValuesHandles.end())
+            {
+                bufferManager.push_back(handle->second, value);
+            }
+            else
+            {
+                bufferManager.push_back(value, "raw_data_values::"+key);
+            }
         }
     }
 
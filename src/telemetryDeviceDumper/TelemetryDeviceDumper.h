@@ -199,6 +199,8 @@ private:
     void readRawValuesData();
     void resizeBuffers(int size);
     bool configBufferManager(yarp::os::Searchable& config);
+    void getChannelHandles();
+    bool addSensorsFrame();
     /** Remapped controlboard containg the axes for which the joint torques are estimated */
     yarp::dev::PolyDriver remappedControlBoard, localization2DClient, rawValuesPublisherClient;
     struct
@@ -227,6 +229,20 @@ private:
 
     std::map<std::string, std::vector<std::int32_t>> rawDataValuesMap;
 
+    /** Handles to the channels, resolved once after the configuration for avoiding the name lookup at each push */
+    struct
+    {
+        robometry::ChannelHandle jointPos, jointVel, jointAcc, jointPosErr, jointPosRef,
+                                 jointTrqErr, jointTrqRef, jointPWM, jointCurr, jointTrq,
+                                 motorEnc, motorVel, motorAcc, motorTemp, controlModes, interactionModes,
+                                 odometryData;
+    } channelHandles;
+
+    std::map<std::string, robometry::ChannelHandle> rawDataValuesHandles;
+
+    /** Frame grouping the channels pushed in readSensors */
+    robometry::FrameHandle sensorsFrame;
+
     std::vector<std::string> jointNames;
     TelemetryDeviceDumperSettings settings;
     robometry::BufferConfig m_bufferConfig;
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/FlightRecorder.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 4) {
+        std::cout << "Usage: " << argv[0] << " <session_directory> [<output.mat>] [v4|v5|v7_3]" << std::endl;
+        std::cout << "Recover the samples of a flight recorder session left by a process that crashed, and save them to a .mat file." << std::endl;
+        std::cout << "By default the output file has the name of the session directory." << std::endl;
+        return 1;
+    }
+
+    const std::string session_directory = argv[1];
+    std::string mat_file_name = argc > 2 ? argv[2] : "";
+    if (argc == 2) {
+        auto session_path = std::filesystem::path(session_directory);
+        if (!session_path.has_filename()) {
+            session_path = session_path.parent_path();
+        }
+        mat_file_name = session_path.string() + ".mat";
+    }
+
+    auto version = matioCpp::FileVersion::Default;
+    if (argc > 3) {
+        const std::string version_name = argv[3];
+        if (version_name == "v4") {
+            version = matioCpp::FileVersion::MAT4;
+        }
+        else if (version_name == "v5") {
+            version = matioCpp::FileVersion::MAT5;
+        }
+        else if (version_name == "v7_3") {
+            version = matioCpp::FileVersion::MAT7_3;
+        }
+        else {
+            std::cout << "Unknown mat file version " << version_name << std::endl;
+            return 1;
+        }
+    }
+
+    if (!robometry::flightRecorderToMat(session_directory, mat_file_name, version)) {
+        return 1;
+    }
+    std::cout << "Saved " << mat_file_name << std::endl;
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2006-2024 Istituto Italiano di Tecnologia (IIT)
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms of the
+ * BSD-3-Clause license. See the accompanying LICENSE file for details.
+ */
+
+#include <robometry/BinaryLog.h>
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 4) {
+        std::cout << "Usage: " << argv[0] << " <log.rblog> [<output.mat>] [v4|v5|v7_3]" << std::endl;
+        std::cout << "Convert a robometry binary log to a .mat file. By default the output file has the name of the log." << std::endl;
+        return 1;
+    }
+
+    const std::string log_file_name = argv[1];
+    std::string mat_file_name = argc > 2 ? argv[2] : log_file_name;
+    if (argc == 2) {
+        const auto extension = mat_file_name.rfind(".rblog");
+        if (extension != std::string::npos) {
+            mat_file_name.erase(extension);
+        }
+        mat_file_name += ".mat";
+    }
+
+    auto version = matioCpp::FileVersion::Default;
+    if (argc > 3) {
+        const std::string version_name = argv[3];
+        if (version_name == "v4") {
+            version = matioCpp::FileVersion::MAT4;
+        }
+        else if (version_name == "v5") {
+            version = matioCpp::FileVersion::MAT5;
+        }
+        else if (version_name == "v7_3") {
+            version = matioCpp::FileVersion::MAT7_3;
+        }
+        else {
+            std::cout << "Unknown mat file version " << version_name << std::endl;
+            return 1;
+        }
+    }
+
+    if (!robometry::binaryLogToMat(log_file_name, mat_file_name, version)) {
+        return 1;
+    }
+    std::cout << "Saved " << mat_file_name << std::endl;
+    return 0;
+}
@@ -14,6 +14,8 @@
 #include <mutex>
 #include <thread>
 #include <chrono>
+#include <cmath>
+#include <limits>
 
 constexpr size_t n_samples{ 3 };
 
@@ -37,6 +39,12 @@ struct testStruct
 };
 VISITABLE_STRUCT(testStruct, a, b);
 
+// True if a temporary T can be set in a frame, that would dangle when the frame is pushed
+template<typename T, typename = void>
+struct canSetTemporary : std::false_type {};
+template<typename T>
+struct canSetTemporary<T, std::void_t<decltype(std::declval<robometry::FrameHandle&>().set(std::declval<const robometry::ChannelHandle&>(), std::declval<T>()))>> : std::true_type {};
+
 TEST_CASE("Buffer Manager Test")
 {
     SECTION("Test scalar")
@@ -494,6 +502,1555 @@ TEST_CASE("Buffer Manager Test")
 
     }
 
+    SECTION("Contiguous buffer") {
+        robometry::ContiguousBuffer cb(3);
+        REQUIRE(!cb.initialized());
+        cb.initialize(2 * sizeof(double));
+        REQUIRE(cb.initialized());
+        REQUIRE(cb.empty());
+
+        for (int i = 0; i < 5; i++) {
+            std::vector<double> sample{ i * 1.0, i * 2.0 };
+            cb.push_back(sample.data(), sample.size() * sizeof(double), i);
+        }
+        // The oldest samples have been overwritten
+        REQUIRE(cb.full());
+        REQUIRE(cb.size() == 3);
+
+        std::vector<double> data(cb.size() * 2);
+        std::vector<double> timestamps(cb.size());
+        cb.copyData(data.data());
+        cb.copyTimestamps(timestamps.data());
+        REQUIRE(data == std::vector<double>{ 2.0, 4.0, 3.0, 6.0, 4.0, 8.0 });
+        REQUIRE(timestamps == std::vector<double>{ 2.0, 3.0, 4.0 });
+
+        // A shorter sample is padded with zeros
+        double shortSample{ 5.0 };
+        cb.push_back(&shortSample, sizeof(double), 5);
+        cb.copyData(data.data());
+        REQUIRE(data == std::vector<double>{ 3.0, 6.0, 4.0, 8.0, 5.0, 0.0 });
+
+        cb.set_capacity(5);
+        REQUIRE(cb.size() == 3);
+        REQUIRE(cb.capacity() == 5);
+        cb.copyTimestamps(timestamps.data());
+        REQUIRE(timestamps == std::vector<double>{ 3.0, 4.0, 5.0 });
+
+        cb.clear();
+        REQUIRE(cb.empty());
+    }
+
+    SECTION("Detach contiguous buffer chunks") {
+        robometry::ContiguousBuffer cb(8, 3 * sizeof(double));
+        cb.initialize(sizeof(double));
+        REQUIRE(cb.chunkSize() == 3);
+
+        for (int i = 0; i < 7; i++) {
+            double sample = i;
+            cb.push_back(&sample, sizeof(double), i);
+        }
+
+        // Two chunks are moved, the last sample is copied
+        auto detached = cb.detach(cb.size());
+        REQUIRE(cb.empty());
+        REQUIRE(detached.size() == 7);
+
+        // The producer keeps writing in the recycled chunks, without touching the detached samples
+        for (int i = 7; i < 12; i++) {
+            double sample = i;
+            cb.push_back(&sample, sizeof(double), i);
+        }
+
+        std::vector<double> data(detached.size());
+        std::vector<double> timestamps(detached.size());
+        detached.copyData(data.data());
+        detached.copyTimestamps(timestamps.data());
+        REQUIRE(data == std::vector<double>{ 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 });
+        REQUIRE(timestamps == std::vector<double>{ 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 });
+
+        detached = robometry::ContiguousBuffer::DetachedSamples();
+        detached = cb.detach(cb.size());
+        data.resize(detached.size());
+        detached.copyData(data.data());
+        REQUIRE(data == std::vector<double>{ 7.0, 8.0, 9.0, 10.0, 11.0 });
+    }
+
+    SECTION("Batch push") {
+        robometry::ContiguousBuffer cb(5, 2 * sizeof(double));
+        cb.initialize(sizeof(double));
+        std::vector<double> samples{ 0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+        REQUIRE(cb.push_back(samples.data(), samples.data(), 3) == 3);
+        cb.pop_front(2);
+        // The batch is split at the end of the chunks and where the ring wraps around
+        REQUIRE(cb.push_back(samples.data() + 3, samples.data() + 3, 4) == 4);
+        std::vector<double> data(cb.size());
+        cb.copyData(data.data());
+        REQUIRE(data == std::vector<double>{ 2.0, 3.0, 4.0, 5.0, 6.0 });
+        // Only the newest samples are kept
+        REQUIRE(cb.push_back(samples.data(), samples.data(), 7) == 5);
+        cb.copyTimestamps(data.data());
+        REQUIRE(data == std::vector<double>{ 2.0, 3.0, 4.0, 5.0, 6.0 });
+        REQUIRE(cb.overwrittenSamples() == 7);
+
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_batch";
+        bufferConfig.channels = { {"scalar", {1, 1}}, {"vector", {2, 1}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+
+        std::vector<double> timestamps{ 0.0, 0.1, 0.2, 0.3, 0.4 };
+        bm.push_back_batch("scalar", std::vector<double>{ 1.0, 2.0, 3.0, 4.0, 5.0 }, timestamps);
+        bm.push_back_batch(bm.getChannelHandle("vector"),
+                           std::vector<std::vector<double>>{ {1.0, 2.0}, {3.0, 4.0} },
+                           matioCpp::make_span(timestamps).subspan(0, 2));
+
+        robometry::ChannelCounters counters;
+        REQUIRE(bm.getChannelCounters("scalar", counters));
+        REQUIRE(counters.overwritten == 2);
+
+        // The number of timestamps has to match the number of elements
+        bm.push_back_batch("vector", std::vector<std::vector<double>>{ {5.0, 6.0}, {7.0, 8.0} }, timestamps);
+        REQUIRE(bm.getChannelCounters("vector", counters));
+        REQUIRE(counters.overwritten == 0);
+
+        REQUIRE_THROWS_AS(bm.push_back_batch("three", samples, timestamps), std::invalid_argument);
+        REQUIRE(bm.saveToFile());
+    }
+
+    SECTION("Numeric channels in contiguous buffers") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_contiguous";
+        bufferConfig.channels = { {"vector", {23, 1}}, {"scalar", {1, 1}}, {"matrix", {2, 2}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+
+        std::vector<double> joints(23);
+        for (int i = 0; i < 10; i++) {
+            std::fill(joints.begin(), joints.end(), i);
+            bm.push_back(joints, i, "vector");
+            bm.push_back(i, i, "scalar");
+            bm.push_back({ i, i + 1, i + 2, i + 3 }, i, "matrix");
+        }
+
+        REQUIRE(bm.saveToFile());
+    }
+
+    SECTION("Channel handles") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_handles";
+        bufferConfig.channels = { {"struct1::one", {4, 1}}, {"two", {1, 1}}, {"string_channel", {1}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+
+        auto one = bm.getChannelHandle("struct1::one");
+        auto two = bm.getChannelHandle("two");
+        auto string_channel = bm.getChannelHandle("string_channel");
+        REQUIRE(one.isValid());
+        REQUIRE(one.name() == "struct1::one");
+        REQUIRE(two.isValid());
+        REQUIRE(string_channel.isValid());
+        // Only leaves can be addressed
+        REQUIRE(!bm.getChannelHandle("struct1").isValid());
+        REQUIRE(!bm.getChannelHandle("three").isValid());
+
+        for (int i = 0; i < 10; i++) {
+            bm.push_back(one, { i + 1.0, i + 2.0, i + 3.0, i + 4.0 }, i);
+            bm.push_back(two, i);
+            bm.push_back(string_channel, std::string("iter") + std::to_string(i), i);
+        }
+        // The channels can be still addressed by name
+        bm.push_back({ 0.0, 0.0, 0.0, 0.0 }, "struct1::one");
+
+        REQUIRE_THROWS_AS(bm.push_back(robometry::ChannelHandle(), 1.0), std::invalid_argument);
+        REQUIRE(bm.saveToFile());
+    }
+
+    SECTION("Frames") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_frames";
+        bufferConfig.channels = { {"joints::positions", {3, 1}}, {"joints::velocities", {3, 1}}, {"temperature", {1, 1}}, {"other", {1, 1}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        REQUIRE(bm.addFrame("state", { "joints::positions", "joints::velocities", "temperature" }));
+        REQUIRE(!bm.addFrame("state", { "other" }));
+        REQUIRE(!bm.addFrame("other_state", { "other", "temperature" }));
+        REQUIRE(!bm.addFrame("other_state", { "three" }));
+
+        auto frame = bm.getFrameHandle("state");
+        REQUIRE(frame.isValid());
+        REQUIRE(frame.name() == "state");
+        REQUIRE(!bm.getFrameHandle("other_state").isValid());
+
+        auto positions = bm.getChannelHandle("joints::positions");
+        auto velocities = bm.getChannelHandle("joints::velocities");
+        auto temperature = bm.getChannelHandle("temperature");
+        double other{ 1.0 };
+        REQUIRE(!frame.set(bm.getChannelHandle("other"), other));
+        static_assert(!canSetTemporary<double>::value && !canSetTemporary<std::vector<double>>::value);
+
+        std::vector<double> q(3), dq(3);
+        double temp{ 0.0 };
+        for (int i = 0; i < 5; i++) {
+            std::fill(q.begin(), q.end(), i);
+            std::fill(dq.begin(), dq.end(), 2 * i);
+            temp = 30.0 + i;
+            REQUIRE(frame.set(positions, q));
+            REQUIRE(frame.set(velocities, dq));
+            REQUIRE(frame.set(temperature, temp));
+            bm.push_back(frame, i);
+        }
+
+        robometry::ChannelCounters counters;
+        REQUIRE(bm.getChannelCounters("temperature", counters));
+        REQUIRE(counters.overwritten == 2);
+
+        // An incomplete frame is not pushed
+        REQUIRE(frame.set(positions, q));
+        bm.push_back(frame, 5);
+        REQUIRE(bm.getChannelCounters("joints::positions", counters));
+        REQUIRE(counters.overwritten == 2);
+
+        // The channels of a frame cannot be pushed alone
+        bm.push_back(1.0, "temperature");
+        REQUIRE(bm.getChannelCounters("temperature", counters));
+        REQUIRE(counters.overwritten == 2);
+
+        REQUIRE_THROWS_AS(bm.push_back(robometry::FrameHandle(), 1.0), std::invalid_argument);
+        REQUIRE(bm.saveToFile());
+    }
+
+    SECTION("Clock groups") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_clock_groups";
+        robometry::ChannelInfo positions{ "positions", {2, 1} }, currents{ "currents", {2, 1} };
+        positions.clock_group = "joints";
+        currents.clock_group = "joints";
+        bufferConfig.channels = { positions, currents, {"other", {1, 1}} };
+
+        REQUIRE(bufferConfigToJson(bufferConfig, "test_json_clock_groups.json"));
+        REQUIRE(bufferConfigFromJson(bufferConfig, "test_json_clock_groups.json"));
+        REQUIRE(bufferConfig.channels[0].clock_group == "joints");
+        REQUIRE(bufferConfig.channels[2].clock_group.empty());
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        auto frame = bm.getFrameHandle("joints");
+        REQUIRE(frame.isValid());
+        REQUIRE(!bm.getFrameHandle("other").isValid());
+
+        auto positionsHandle = bm.getChannelHandle("positions");
+        auto currentsHandle = bm.getChannelHandle("currents");
+        for (int i = 0; i < 3; i++) {
+            std::vector<double> q{ i * 1.0, i * 2.0 }, c{ i * 3.0, i * 4.0 };
+            REQUIRE(frame.set(positionsHandle, q));
+            REQUIRE(frame.set(currentsHandle, c));
+            bm.push_back(frame, i);
+            bm.push_back(i, i, "other");
+        }
+        REQUIRE(bm.saveToFile());
+    }
+
+    SECTION("Parallel save") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_parallel_save";
+        bufferConfig.save_threads = 4;
+        for (int i = 0; i < 20; i++) {
+            bufferConfig.channels.push_back({ "group_" + std::to_string(i % 4) + "::channel_" + std::to_string(i), {2, 1} });
+        }
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        for (int i = 0; i < 20; i++) {
+            for (int j = 0; j < 3; j++) {
+                bm.push_back({ i * 1.0, j * 1.0 }, j, bufferConfig.channels[i].name);
+            }
+        }
+        REQUIRE(bm.saveToFile());
+
+        // The tasks are all run, and the exceptions are forwarded to the caller
+        robometry::ThreadPool pool(4);
+        REQUIRE(pool.size() == 4);
+        std::vector<int> results(100, 0);
+        pool.parallelFor(results.size(), [&results](size_t i) { results[i] = static_cast<int>(i); });
+        for (size_t i = 0; i < results.size(); i++) {
+            REQUIRE(results[i] == static_cast<int>(i));
+        }
+        REQUIRE_THROWS_AS(pool.parallelFor(10, [](size_t i) { if (i == 5) throw std::runtime_error("failure"); }), std::runtime_error);
+    }
+
+    SECTION("Append to file") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_append";
+        bufferConfig.channels = { {"joints::positions", {2, 1}}, {"temperature", {1, 1}}, {"counter", {1, 1}}, {"label", {1, 1}} };
+        bufferConfig.append_to_file = true;
+
+        robometry::BufferManager bm;
+        // Only the v7.3 files can be extended
+        REQUIRE(!bm.configure(bufferConfig));
+        bufferConfig.mat_file_version = matioCpp::FileVersion::MAT7_3;
+        REQUIRE(bm.configure(bufferConfig));
+
+        std::string firstFile, secondFile;
+        for (int i = 0; i < 2; i++) {
+            bm.push_back({ i * 1.0, i * 2.0 }, i, "joints::positions");
+            bm.push_back(i * 3.0, i, "temperature");
+            bm.push_back(static_cast<int16_t>(i), i, "counter");
+            // The samples of the channels that are not numeric cannot be appended, they are discarded
+            bm.push_back(std::string("label"), i, "label");
+        }
+        REQUIRE(bm.saveToFile(firstFile));
+        bm.push_back({ 2.0, 4.0 }, 2, "joints::positions");
+        bm.push_back(static_cast<int16_t>(2), 2, "counter");
+        REQUIRE(bm.saveToFile(secondFile));
+        REQUIRE(firstFile == secondFile);
+        REQUIRE(matioCpp::File::Exists(firstFile + ".mat"));
+
+        matioCpp::File file(firstFile + ".mat");
+        auto positions = file.read("joints__positions__data").asMultiDimensionalArray<double>();
+        REQUIRE(positions.numberOfElements() == 6);
+        REQUIRE(positions[5] == 4.0);
+        auto counter = file.read("counter__data").asMultiDimensionalArray<int16_t>();
+        REQUIRE(counter.numberOfElements() == 3);
+        REQUIRE(counter[2] == 2);
+        REQUIRE(file.read("counter__timestamps").asMultiDimensionalArray<double>()[2] == 2.0);
+        REQUIRE(!file.read("label__data").isValid());
+    }
+
+    SECTION("Binary log") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_binary_log";
+        bufferConfig.save_format = robometry::SaveFormat::BinaryLog;
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} }, currents{ "joints::currents", {2, 1} };
+        positions.clock_group = "joints";
+        currents.clock_group = "joints";
+        bufferConfig.channels = { positions, currents, {"temperature", {1, 1}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        auto frame = bm.getFrameHandle("joints");
+        auto positionsHandle = bm.getChannelHandle("joints::positions");
+        auto currentsHandle = bm.getChannelHandle("joints::currents");
+
+        std::string firstLog, secondLog;
+        for (int i = 0; i < 4; i++) {
+            std::vector<double> q{ i * 1.0, i * 2.0 }, c{ i * 3.0, i * 4.0 };
+            REQUIRE(frame.set(positionsHandle, q));
+            REQUIRE(frame.set(currentsHandle, c));
+            bm.push_back(frame, i);
+            bm.push_back(i, i, "temperature");
+            if (i == 1) {
+                REQUIRE(bm.saveToFile(firstLog));
+            }
+        }
+        REQUIRE(bm.saveToFile(secondLog));
+        REQUIRE(firstLog == secondLog);
+
+        REQUIRE(!robometry::binaryLogToMat("not_existing.rblog", "not_existing.mat"));
+        REQUIRE(robometry::binaryLogToMat(firstLog + ".rblog", firstLog + ".mat"));
+
+        matioCpp::File file(firstLog + ".mat");
+        auto log = file.read("buffer_manager_test_binary_log").asStruct();
+        auto temperature = log("temperature").asStruct();
+        auto temperatureData = temperature("data").asMultiDimensionalArray<int>();
+        REQUIRE(temperatureData.numberOfElements() == 4);
+        REQUIRE(temperatureData[3] == 3);
+        REQUIRE(temperature("timestamps").asVector<double>()[2] == 2.0);
+
+        auto joints = log("joints").asStruct();
+        auto currentsData = joints("currents").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(currentsData.numberOfElements() == 8);
+        REQUIRE(currentsData[7] == 12.0);
+        REQUIRE(joints("currents").asStruct()("clock_group").asString()() == "joints");
+        REQUIRE(log("clock_groups").asStruct()("joints").asVector<double>().size() == 4);
+
+        // The blocks whose number of samples would overflow the size of the payload are ignored
+        const std::string malformedLog = "buffer_manager_test_binary_log_malformed";
+        {
+            std::ifstream input(firstLog + ".rblog", std::ios::binary);
+            std::ofstream output(malformedLog + ".rblog", std::ios::binary | std::ios::trunc);
+            output << input.rdbuf();
+            auto writeRecord = [&output](robometry::BinaryLogWriter::RecordKind kind, uint32_t id, uint64_t num_samples,
+                                         uint64_t payload_size) {
+                const auto kindValue = static_cast<uint8_t>(kind);
+                output.write(reinterpret_cast<const char*>(&kindValue), sizeof(kindValue));
+                output.write(reinterpret_cast<const char*>(&id), sizeof(id));
+                output.write(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+                output.write(reinterpret_cast<const char*>(&num_samples), sizeof(num_samples));
+                const std::vector<char> padding(payload_size - sizeof(num_samples), 0);
+                output.write(padding.data(), padding.size());
+            };
+            // num_samples * sizeof(double) wraps around to 8 bytes
+            writeRecord(robometry::BinaryLogWriter::RecordKind::ClockGroupBlock, 0, (uint64_t{ 1 } << 61) + 1, 16);
+            // num_samples * sample_size wraps around to 0 bytes for the 2x1 channels of the clock group
+            for (uint32_t id = 0; id < 3; ++id) {
+                writeRecord(robometry::BinaryLogWriter::RecordKind::ChannelBlock, id, uint64_t{ 1 } << 60, 8);
+            }
+        }
+        REQUIRE(robometry::binaryLogToMat(malformedLog + ".rblog", malformedLog + ".mat"));
+        matioCpp::File malformedFile(malformedLog + ".mat");
+        auto malformed = malformedFile.read("buffer_manager_test_binary_log").asStruct();
+        REQUIRE(malformed("joints").asStruct()("currents").asStruct()("data").asMultiDimensionalArray<double>().numberOfElements() == 8);
+        REQUIRE(malformed("clock_groups").asStruct()("joints").asVector<double>().size() == 4);
+        REQUIRE(malformed("temperature").asStruct()("data").asMultiDimensionalArray<int>().numberOfElements() == 4);
+    }
+
+    SECTION("Binary log codecs") {
+        auto writeLog = [](bool with_codecs, std::string& log_file) {
+            robometry::BufferConfig bufferConfig;
+            bufferConfig.n_samples = 200;
+            bufferConfig.filename = with_codecs ? "buffer_manager_test_codecs" : "buffer_manager_test_no_codecs";
+            bufferConfig.save_format = robometry::SaveFormat::BinaryLog;
+            robometry::ChannelInfo positions{ "joints::positions", {2, 1} }, encoders{ "joints::encoders", {2, 1} };
+            robometry::ChannelInfo counter{ "counter", {1, 1} };
+            positions.clock_group = "joints";
+            encoders.clock_group = "joints";
+            if (with_codecs) {
+                positions.codec = robometry::ChannelCodec::Xor;
+                encoders.codec = robometry::ChannelCodec::Delta;
+                counter.codec = robometry::ChannelCodec::Delta;
+            }
+            bufferConfig.channels = { positions, encoders, counter };
+
+            robometry::BufferManager bm;
+            REQUIRE(bm.configure(bufferConfig));
+            auto frame = bm.getFrameHandle("joints");
+            auto positionsHandle = bm.getChannelHandle("joints::positions");
+            auto encodersHandle = bm.getChannelHandle("joints::encoders");
+            for (int i = 0; i < 200; i++) {
+                std::vector<double> q{ i < 100 ? 1.5 : -0.1 * i, i == 7 ? std::numeric_limits<double>::quiet_NaN() : 1e300 };
+                std::vector<int64_t> e{ 1000 + i, i == 100 ? std::numeric_limits<int64_t>::min() : std::numeric_limits<int64_t>::max() - i };
+                REQUIRE(frame.set(positionsHandle, q));
+                REQUIRE(frame.set(encodersHandle, e));
+                bm.push_back(frame, 0.001 * i);
+                bm.push_back(static_cast<int16_t>(i % 2 == 0 ? -i : i), 10.0 + 0.01 * i, "counter");
+            }
+            REQUIRE(bm.saveToFile(log_file));
+        };
+
+        std::string compressedLog, uncompressedLog;
+        writeLog(true, compressedLog);
+        writeLog(false, uncompressedLog);
+        REQUIRE(robometry_fs::file_size(compressedLog + ".rblog") < robometry_fs::file_size(uncompressedLog + ".rblog") / 2);
+
+        REQUIRE(robometry::binaryLogToMat(compressedLog + ".rblog", compressedLog + ".mat"));
+        matioCpp::File file(compressedLog + ".mat");
+        auto log = file.read("buffer_manager_test_codecs").asStruct();
+        auto joints = log("joints").asStruct();
+        auto positionsData = joints("positions").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(positionsData.numberOfElements() == 400);
+        REQUIRE(positionsData[0] == 1.5);
+        REQUIRE(std::isnan(positionsData[15]));
+        REQUIRE(positionsData[17] == 1e300);
+        REQUIRE(positionsData[398] == -0.1 * 199);
+        auto encodersData = joints("encoders").asStruct()("data").asMultiDimensionalArray<int64_t>();
+        REQUIRE(encodersData[200] == 1100);
+        REQUIRE(encodersData[201] == std::numeric_limits<int64_t>::min());
+        REQUIRE(encodersData[203] == std::numeric_limits<int64_t>::max() - 101);
+        auto counter = log("counter").asStruct();
+        auto counterData = counter("data").asMultiDimensionalArray<int16_t>();
+        REQUIRE(counterData[198] == -198);
+        REQUIRE(counterData[199] == 199);
+        REQUIRE(counter("timestamps").asVector<double>()[123] == 10.0 + 0.01 * 123);
+        REQUIRE(log("clock_groups").asStruct()("joints").asVector<double>()[57] == 0.001 * 57);
+    }
+
+    SECTION("Implicit timestamps") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 100;
+        bufferConfig.filename = "buffer_manager_test_implicit_timestamps";
+        bufferConfig.implicit_timestamps = true;
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} };
+        positions.clock_group = "joints";
+        positions.sampling_period = 0.01;
+        bufferConfig.channels = { positions, {"regular", {1, 1}}, {"irregular", {1, 1}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        auto frame = bm.getFrameHandle("joints");
+        auto positionsHandle = bm.getChannelHandle("joints::positions");
+        std::vector<double> regularTimestamps;
+        for (int i = 0; i < 100; i++) {
+            // A sample arriving late and a gap restarting the grid
+            double ts = 1.0 + 0.01 * i + (i == 20 ? 0.004 : 0.0) + (i >= 50 ? 0.5 : 0.0);
+            regularTimestamps.push_back(ts);
+            std::vector<double> q{ i * 1.0, i * 2.0 };
+            REQUIRE(frame.set(positionsHandle, q));
+            bm.push_back(frame, ts + 0.0001 * (i % 3));
+            bm.push_back(i, ts, "regular");
+            bm.push_back(i, i * i * 0.01, "irregular");
+        }
+        std::string fileName;
+        REQUIRE(bm.saveToFile(fileName));
+
+        matioCpp::File file(fileName + ".mat");
+        auto log = file.read("buffer_manager_test_implicit_timestamps").asStruct();
+        auto timestamps = log("regular").asStruct()("timestamps").asStruct();
+        const double t0 = timestamps("t0").asElement<double>()();
+        const double dt = timestamps("dt").asElement<double>()();
+        REQUIRE(t0 == 1.0);
+        REQUIRE(std::abs(dt - 0.01) < 1e-9);
+        REQUIRE(timestamps("num_samples").asElement<double>()() == 100.0);
+        auto indices = timestamps("exceptions_indices").asVector<double>();
+        auto values = timestamps("exceptions_values").asVector<double>();
+        REQUIRE(indices.size() == 3);
+        REQUIRE(indices[0] == 21.0);
+        REQUIRE(indices[2] == 51.0);
+        REQUIRE(values[2] == regularTimestamps[50]);
+        // The timestamps are reconstructed from the last exception before each sample
+        for (size_t i = 0; i < regularTimestamps.size(); i++) {
+            double start = t0;
+            size_t start_index = 0;
+            for (size_t e = 0; e < indices.size(); e++) {
+                if (static_cast<size_t>(indices[e]) - 1 <= i) {
+                    start = values[e];
+                    start_index = static_cast<size_t>(indices[e]) - 1;
+                }
+            }
+            REQUIRE(std::abs(start + (i - start_index) * dt - regularTimestamps[i]) <= 0.1 * dt);
+        }
+
+        auto jointsTimestamps = log("clock_groups").asStruct()("joints").asStruct();
+        REQUIRE(jointsTimestamps("dt").asElement<double>()() == 0.01);
+        REQUIRE(jointsTimestamps("exceptions_indices").asVector<double>().size() == 3);
+        REQUIRE(log("irregular").asStruct()("timestamps").asVector<double>().size() == 100);
+    }
+
+    SECTION("Decimation") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 100;
+        bufferConfig.filename = "buffer_manager_test_decimation";
+        robometry::ChannelInfo decimated{ "decimated", {2, 1} }, filtered{ "filtered", {1, 1} }, counter{ "counter", {1, 1} };
+        robometry::ChannelInfo faulty{ "faulty", {2, 1} };
+        decimated.decimation = 10;
+        filtered.decimation = 10;
+        filtered.decimation_filter = true;
+        counter.decimation = 3;
+        counter.decimation_filter = true;
+        faulty.decimation = 10;
+        faulty.decimation_filter = true;
+        bufferConfig.channels = { decimated, filtered, counter, faulty };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        const double pi = std::acos(-1.0);
+        for (int i = 0; i < 1000; i++) {
+            bm.push_back(std::vector<double>{ i * 1.0, -i * 1.0 }, i * 0.001, "decimated");
+            // A slow component that is kept and a fast one above the Nyquist frequency of the stored samples
+            bm.push_back(1.0 + std::sin(2 * pi * i / 500.0) + std::sin(2 * pi * i * 0.4), i * 0.001, "filtered");
+            bm.push_back(i, i * 0.001, "counter");
+            // The failed readings of the first element, one kept and one dropped
+            const double nan = std::numeric_limits<double>::quiet_NaN();
+            bm.push_back(std::vector<double>{ i == 500 || i == 733 ? nan : 2.0, 3.0 }, i * 0.001, "faulty");
+        }
+        std::string fileName;
+        REQUIRE(bm.saveToFile(fileName));
+
+        matioCpp::File file(fileName + ".mat");
+        auto log = file.read("buffer_manager_test_decimation").asStruct();
+
+        // The not finite elements are passed through, and they do not affect the following samples
+        auto faultyData = log("faulty").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(faultyData.numberOfElements() == 200);
+        REQUIRE(std::isnan(faultyData[100]));
+        REQUIRE(std::abs(faultyData[101] - 3.0) < 1e-12);
+        for (size_t i = 51; i < 100; i++) {
+            REQUIRE(std::abs(faultyData[2 * i] - 2.0) < 1e-12);
+        }
+        auto decimatedData = log("decimated").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(decimatedData.numberOfElements() == 200);
+        REQUIRE(decimatedData[0] == 0.0);
+        REQUIRE(decimatedData[2] == 10.0);
+        REQUIRE(decimatedData[199] == -990.0);
+        REQUIRE(log("decimated").asStruct()("timestamps").asVector<double>()[99] == 0.99);
+
+        auto filteredData = log("filtered").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(filteredData.numberOfElements() == 100);
+        REQUIRE(std::abs(filteredData[0] - 1.0) < 1e-12);
+        for (size_t i = 10; i < 100; i++) {
+            // The filtered samples follow the slow component with a delay, and the fast one is attenuated
+            const double slow = 1.0 + std::sin(2 * pi * (10.0 * i - 9.0) / 500.0);
+            REQUIRE(std::abs(filteredData[i] - slow) < 0.15);
+        }
+
+        auto counterData = log("counter").asStruct()("data").asMultiDimensionalArray<int>();
+        REQUIRE(counterData.numberOfElements() == 100);
+        REQUIRE(counterData[99] == 999);
+
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} };
+        positions.clock_group = "joints";
+        positions.decimation = 2;
+        bufferConfig.channels = { positions };
+        robometry::BufferManager bmFrame;
+        REQUIRE(!bmFrame.configure(bufferConfig));
+        bufferConfig.channels = { {"zero", {1, 1}} };
+        bufferConfig.channels.back().decimation = 0;
+        robometry::BufferManager bmZero;
+        REQUIRE(!bmZero.configure(bufferConfig));
+    }
+
+    SECTION("On-change channels") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 100;
+        bufferConfig.filename = "buffer_manager_test_on_change";
+        robometry::ChannelInfo controlMode{ "control_mode", {2, 1} }, temperature{ "temperature", {1, 1} }, counter{ "counter", {1, 1} };
+        controlMode.on_change = true;
+        temperature.on_change = true;
+        temperature.deadband = 0.5;
+        counter.on_change = true;
+        bufferConfig.channels = { controlMode, temperature, counter };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        for (int i = 0; i < 1000; i++) {
+            std::vector<double> mode{ i < 300 ? 1.0 : 2.0, i == 700 ? 5.0 : (i > 900 ? nan : 1.0) };
+            bm.push_back(mode, i * 0.01, "control_mode");
+            // A slow ramp is stored when it moves away from the last stored value by more than the deadband
+            bm.push_back(20.0 + 0.01 * i, i * 0.01, "temperature");
+            bm.push_back(static_cast<int64_t>(i / 250) + (int64_t{ 1 } << 60), i * 0.01, "counter");
+        }
+        std::string fileName;
+        REQUIRE(bm.saveToFile(fileName));
+
+        matioCpp::File file(fileName + ".mat");
+        auto log = file.read("buffer_manager_test_on_change").asStruct();
+        auto mode = log("control_mode").asStruct();
+        auto modeData = mode("data").asMultiDimensionalArray<double>();
+        auto modeTimestamps = mode("timestamps").asVector<double>();
+        // The first sample, the change of the first element, the spike of the second one, its end and the NaN
+        REQUIRE(modeTimestamps.size() == 5);
+        REQUIRE(modeTimestamps[1] == 3.0);
+        REQUIRE(modeData[2] == 2.0);
+        REQUIRE(modeData[5] == 5.0);
+        REQUIRE(modeTimestamps[3] == 7.01);
+        REQUIRE(modeData[7] == 1.0);
+        REQUIRE(std::isnan(modeData[9]));
+
+        auto temperatureTimestamps = log("temperature").asStruct()("timestamps").asVector<double>();
+        REQUIRE(temperatureTimestamps.size() == 20);
+        REQUIRE(temperatureTimestamps[1] == 0.51);
+
+        auto counterData = log("counter").asStruct()("data").asMultiDimensionalArray<int64_t>();
+        REQUIRE(counterData.numberOfElements() == 4);
+        REQUIRE(counterData[3] == 3 + (int64_t{ 1 } << 60));
+
+        // The next file starts with the first sample pushed after the save, even if the channels did not change
+        for (int i = 1000; i < 1010; i++) {
+            bm.push_back(int64_t{ 3 } + (int64_t{ 1 } << 60), i * 0.01, "counter");
+        }
+        REQUIRE(bm.saveToFile(fileName));
+        matioCpp::File nextFile(fileName + ".mat");
+        auto nextCounter = nextFile.read("buffer_manager_test_on_change").asStruct()("counter").asStruct();
+        REQUIRE(nextCounter("data").asMultiDimensionalArray<int64_t>().numberOfElements() == 1);
+        REQUIRE(nextCounter("data").asMultiDimensionalArray<int64_t>()[0] == 3 + (int64_t{ 1 } << 60));
+        REQUIRE(nextCounter("timestamps").asVector<double>()[0] == 10.0);
+
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} };
+        positions.clock_group = "joints";
+        positions.on_change = true;
+        bufferConfig.channels = { positions };
+        robometry::BufferManager bmFrame;
+        REQUIRE(!bmFrame.configure(bufferConfig));
+    }
+
+    SECTION("Online statistics") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 10;
+        bufferConfig.filename = "buffer_manager_test_statistics";
+        robometry::ChannelInfo currents{ "currents", {2, 1} }, counter{ "counter", {1, 1} }, lockFree{ "lock_free", {1, 1} };
+        currents.statistics = true;
+        currents.decimation = 10;
+        counter.statistics = true;
+        lockFree.statistics = true;
+        lockFree.lock_free = true;
+        bufferConfig.channels = { currents, counter, {"plain", {1, 1}}, lockFree };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        robometry::ChannelStatistics statistics;
+        REQUIRE(!bm.getStatistics("currents", statistics));
+        REQUIRE(!bm.getStatistics("plain", statistics));
+        REQUIRE(!bm.getStatistics("not_existing", statistics));
+
+        for (int i = 0; i < 100; i++) {
+            // The peak is not stored because of the decimation, but it is in the statistics
+            std::vector<double> c{ i == 55 ? 50.0 : 1.0 * (i % 2), i < 50 ? std::numeric_limits<double>::quiet_NaN() : 2.0 };
+            bm.push_back(c, i * 0.01, "currents");
+            bm.push_back(i, i * 0.01, "counter");
+            bm.push_back(i, i * 0.01, "plain");
+        }
+        REQUIRE(bm.getStatistics("currents", statistics));
+        REQUIRE(statistics.dimensions == robometry::dimensions_t{ 2, 1 });
+        REQUIRE(statistics.count == std::vector<size_t>{ 100, 50 });
+        REQUIRE(statistics.max[0] == 50.0);
+        REQUIRE(statistics.min[0] == 0.0);
+        REQUIRE(statistics.mean[1] == 2.0);
+        REQUIRE(statistics.variance[1] == 0.0);
+
+        REQUIRE(bm.getStatistics("counter", statistics));
+        REQUIRE(std::abs(statistics.mean[0] - 49.5) < 1e-12);
+        REQUIRE(std::abs(statistics.variance[0] - 841.6666666666666) < 1e-9);
+
+        std::string fileName;
+        REQUIRE(bm.saveToFile(fileName));
+        matioCpp::File file(fileName + ".mat");
+        auto log = file.read("buffer_manager_test_statistics").asStruct();
+        auto currentsStatistics = log("currents").asStruct()("statistics").asStruct();
+        REQUIRE(currentsStatistics("max").asMultiDimensionalArray<double>()[0] == 50.0);
+        REQUIRE(currentsStatistics("count").asMultiDimensionalArray<double>()[1] == 50.0);
+        REQUIRE(log("counter").asStruct()("statistics").asStruct()("min").asMultiDimensionalArray<double>()[0] == 0.0);
+        REQUIRE(!log("plain").asStruct().isFieldExisting("statistics"));
+
+        // The statistics of a lock-free channel are read while its producer pushes, and the last read sees all the samples
+        auto lockFreeHandle = bm.getChannelHandle("lock_free");
+        std::thread producer([&]() {
+            for (int i = 0; i < 10000; i++) {
+                bm.push_back(lockFreeHandle, i, i * 0.001);
+            }
+        });
+        size_t lastCount{ 0 };
+        for (int i = 0; i < 1000; i++) {
+            if (bm.getStatistics("lock_free", statistics)) {
+                REQUIRE(statistics.count[0] >= lastCount);
+                lastCount = statistics.count[0];
+            }
+        }
+        producer.join();
+        REQUIRE(bm.getStatistics("lock_free", statistics));
+        REQUIRE(statistics.count[0] == 10000);
+        REQUIRE(statistics.max[0] == 9999.0);
+    }
+
+    SECTION("Triggered capture") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 50;
+        bufferConfig.filename = "buffer_manager_test_trigger";
+        bufferConfig.trigger_pre_duration = 0.5;
+        bufferConfig.trigger_post_duration = 0.2;
+        bufferConfig.data_threshold = 10;
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} };
+        positions.clock_group = "joints";
+        bufferConfig.channels = { positions, {"temperature", {1, 1}}, {"label", {1, 1}} };
+
+        std::atomic<double> now{ 0.0 };
+        std::vector<std::string> captures;
+        std::mutex capturesMutex;
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        REQUIRE(bm.setNowFunction([&now]() { return now.load(); }));
+        REQUIRE(bm.setSaveCallback([&](const std::string& fileName, const robometry::SaveCallbackSaveMethod& method) {
+            std::scoped_lock<std::mutex> lock{ capturesMutex };
+            if (method == robometry::SaveCallbackSaveMethod::trigger) {
+                captures.push_back(fileName);
+            }
+            return true;
+        }));
+        REQUIRE(!bm.trigger(""));
+
+        auto frame = bm.getFrameHandle("joints");
+        auto positionsHandle = bm.getChannelHandle("joints::positions");
+        std::string fileName;
+        for (int i = 0; i < 200; i++) {
+            const double ts = i * 0.01;
+            now = ts;
+            std::vector<double> q{ ts, -ts };
+            REQUIRE(frame.set(positionsHandle, q));
+            bm.push_back(frame, ts);
+            bm.push_back(ts, ts, "temperature");
+            bm.push_back(std::string("label"), ts, "label");
+            if (i == 100) {
+                REQUIRE(bm.trigger("fault"));
+                REQUIRE(bm.pendingCaptures() == 1);
+            }
+            // The usual saves detach the samples while the capture is collecting them
+            if (i % 15 == 0) {
+                bm.saveToFile(fileName, false);
+            }
+        }
+        for (int i = 0; i < 500 && bm.pendingCaptures() > 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(bm.pendingCaptures() == 0);
+        std::string captureFile;
+        {
+            std::scoped_lock<std::mutex> lock{ capturesMutex };
+            REQUIRE(captures.size() == 1);
+            captureFile = captures.front();
+        }
+        REQUIRE(captureFile.find("_fault") != std::string::npos);
+
+        // The samples before the trigger are limited by the 50 samples kept in the buffers
+        matioCpp::File file(captureFile + ".mat");
+        auto log = file.read("buffer_manager_test_trigger").asStruct();
+        auto temperature = log("temperature").asStruct();
+        auto temperatureTimestamps = temperature("timestamps").asVector<double>();
+        REQUIRE(temperatureTimestamps.size() == 71);
+        REQUIRE(std::abs(temperatureTimestamps[0] - 0.5) < 1e-9);
+        REQUIRE(std::abs(temperatureTimestamps[70] - 1.2) < 1e-9);
+        REQUIRE(temperature("data").asMultiDimensionalArray<double>()[70] == temperatureTimestamps[70]);
+        auto jointsTimestamps = log("clock_groups").asStruct()("joints").asVector<double>();
+        REQUIRE(jointsTimestamps.size() == 71);
+        auto positionsData = log("joints").asStruct()("positions").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(positionsData.numberOfElements() == 142);
+        REQUIRE(positionsData[140] == jointsTimestamps[70]);
+        REQUIRE(positionsData[141] == -jointsTimestamps[70]);
+        REQUIRE(!log.isFieldExisting("label"));
+    }
+
+    SECTION("Triggered capture longer than the buffers") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 10;
+        bufferConfig.filename = "buffer_manager_test_long_trigger";
+        bufferConfig.trigger_pre_duration = 0.055;
+        bufferConfig.trigger_post_duration = 0.505;
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} };
+        positions.clock_group = "joints";
+        bufferConfig.channels = { positions, {"temperature", {1, 1}} };
+
+        std::atomic<double> now{ 0.0 };
+        std::vector<std::string> captures;
+        std::mutex capturesMutex;
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        REQUIRE(bm.setNowFunction([&now]() { return now.load(); }));
+        REQUIRE(bm.setSaveCallback([&](const std::string& fileName, const robometry::SaveCallbackSaveMethod& method) {
+            std::scoped_lock<std::mutex> lock{ capturesMutex };
+            if (method == robometry::SaveCallbackSaveMethod::trigger) {
+                captures.push_back(fileName);
+            }
+            return true;
+        }));
+
+        auto frame = bm.getFrameHandle("joints");
+        auto positionsHandle = bm.getChannelHandle("joints::positions");
+        // The post-trigger window spans 50 samples, while the buffers keep 10 of them
+        for (int i = 0; i < 80; i++) {
+            const double ts = i * 0.01;
+            now = ts;
+            std::vector<double> q{ ts, -ts };
+            REQUIRE(frame.set(positionsHandle, q));
+            bm.push_back(frame, ts);
+            bm.push_back(ts, ts, "temperature");
+            if (i == 20) {
+                REQUIRE(bm.trigger("long"));
+            }
+        }
+        for (int i = 0; i < 500 && bm.pendingCaptures() > 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(bm.pendingCaptures() == 0);
+        std::string captureFile;
+        {
+            std::scoped_lock<std::mutex> lock{ capturesMutex };
+            REQUIRE(captures.size() == 1);
+            captureFile = captures.front();
+        }
+        matioCpp::File file(captureFile + ".mat");
+        auto log = file.read("buffer_manager_test_long_trigger").asStruct();
+        auto temperatureTimestamps = log("temperature").asStruct()("timestamps").asVector<double>();
+        REQUIRE(temperatureTimestamps.size() == 56);
+        REQUIRE(std::abs(temperatureTimestamps[0] - 0.15) < 1e-9);
+        REQUIRE(std::abs(temperatureTimestamps[55] - 0.7) < 1e-9);
+        // The capture reports the samples overwritten in the short buffers
+        REQUIRE(log("temperature").asStruct()("overwritten_samples").asElement<size_t>()() > 0);
+        auto jointsTimestamps = log("clock_groups").asStruct()("joints").asVector<double>();
+        REQUIRE(jointsTimestamps.size() == 56);
+        auto positionsData = log("joints").asStruct()("positions").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(positionsData.numberOfElements() == 112);
+        REQUIRE(positionsData[110] == jointsTimestamps[55]);
+    }
+
+    SECTION("Triggered capture of lock-free channels") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 100;
+        bufferConfig.filename = "buffer_manager_test_lock_free_trigger";
+        bufferConfig.trigger_pre_duration = 0.055;
+        bufferConfig.trigger_post_duration = 0.105;
+        robometry::ChannelInfo lockFree{ "lock_free", {1, 1} };
+        lockFree.lock_free = true;
+        bufferConfig.channels = { lockFree };
+
+        std::atomic<double> now{ 0.0 };
+        std::vector<std::string> captures;
+        std::mutex capturesMutex;
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        REQUIRE(bm.setNowFunction([&now]() { return now.load(); }));
+        REQUIRE(bm.setSaveCallback([&](const std::string& fileName, const robometry::SaveCallbackSaveMethod& method) {
+            std::scoped_lock<std::mutex> lock{ capturesMutex };
+            if (method == robometry::SaveCallbackSaveMethod::trigger) {
+                captures.push_back(fileName);
+            }
+            return true;
+        }));
+
+        // The producer does not collect the samples after the trigger, the capture thread collects them at the end of the window
+        for (int i = 0; i < 40; i++) {
+            const double ts = i * 0.01;
+            now = ts;
+            bm.push_back(ts, ts, "lock_free");
+            if (i == 20) {
+                REQUIRE(bm.trigger("lock_free"));
+            }
+        }
+        for (int i = 0; i < 500 && bm.pendingCaptures() > 0; i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(bm.pendingCaptures() == 0);
+        std::string captureFile;
+        {
+            std::scoped_lock<std::mutex> lock{ capturesMutex };
+            REQUIRE(captures.size() == 1);
+            captureFile = captures.front();
+        }
+        matioCpp::File file(captureFile + ".mat");
+        auto log = file.read("buffer_manager_test_lock_free_trigger").asStruct();
+        auto timestamps = log("lock_free").asStruct()("timestamps").asVector<double>();
+        REQUIRE(timestamps.size() == 16);
+        REQUIRE(std::abs(timestamps[0] - 0.15) < 1e-9);
+        REQUIRE(std::abs(timestamps[15] - 0.3) < 1e-9);
+    }
+
+    SECTION("Memory budget") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 1000;
+        bufferConfig.filename = "buffer_manager_test_memory_budget";
+        bufferConfig.memory_budget = 16000;
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} };
+        positions.clock_group = "joints";
+        bufferConfig.channels = { {"scalar", {1, 1}}, {"matrix", {4, 4}}, positions };
+
+        double now{ 0.0 };
+        robometry::BufferManager bm;
+        REQUIRE(bm.setNowFunction([&now]() { return now; }));
+        REQUIRE(bm.configure(bufferConfig));
+
+        auto frame = bm.getFrameHandle("joints");
+        auto positionsHandle = bm.getChannelHandle("joints::positions");
+        std::vector<double> matrix(16, 1.0);
+        auto pushSecond = [&](double start) {
+            // 100 Hz, 10 Hz and 50 Hz
+            for (int i = 0; i < 100; i++) {
+                now = start + i * 0.01;
+                bm.push_back(now, now, "scalar");
+                if (i % 10 == 0) {
+                    bm.push_back(matrix, now, "matrix");
+                }
+                if (i % 2 == 0) {
+                    std::vector<double> q{ now, -now };
+                    REQUIRE(frame.set(positionsHandle, q));
+                    bm.push_back(frame, now);
+                }
+            }
+            now = start + 1.0;
+        };
+
+        // Until the rates are known, the channels and the clock group hold the same number of samples
+        pushSecond(0.0);
+        size_t bytes{ 0 };
+        REQUIRE(bm.getMemoryUsage("scalar", bytes));
+        REQUIRE(bytes == 90 * 16);
+        REQUIRE(bm.getMemoryUsage("matrix", bytes));
+        REQUIRE(bytes == 90 * 136);
+        REQUIRE(bm.getMemoryUsage("joints::positions", bytes));
+        REQUIRE(bytes == 90 * 16);
+        REQUIRE(!bm.getMemoryUsage("not_existing", bytes));
+        REQUIRE(bm.getMemoryUsage() == 90 * (16 + 136 + 24));
+
+        // After the save they hold the same time span, according to their rates
+        REQUIRE(bm.saveToFile());
+        REQUIRE(bm.getMemoryUsage("scalar", bytes));
+        REQUIRE(bytes == 384 * 16);
+        REQUIRE(bm.getMemoryUsage("matrix", bytes));
+        REQUIRE(bytes == 38 * 136);
+        REQUIRE(bm.getMemoryUsage("joints::positions", bytes));
+        REQUIRE(bytes == 192 * 16);
+        REQUIRE(bm.getMemoryUsage() == 384 * 16 + 38 * 136 + 192 * 24);
+        REQUIRE(bm.getMemoryUsage() <= bufferConfig.memory_budget);
+
+        // The same rates do not change the capacities, and no sample is lost anymore
+        pushSecond(1.0);
+        std::string fileName;
+        REQUIRE(bm.saveToFile(fileName));
+        REQUIRE(bm.getMemoryUsage() == 384 * 16 + 38 * 136 + 192 * 24);
+        matioCpp::File file(fileName + ".mat");
+        auto log = file.read("buffer_manager_test_memory_budget").asStruct();
+        REQUIRE(log("scalar").asStruct()("timestamps").asVector<double>().size() == 100);
+        REQUIRE(log("clock_groups").asStruct()("joints").asVector<double>().size() == 50);
+
+        // A channel added while the others hold samples gets its share at the next save, and nothing is lost meanwhile
+        robometry::ChannelCounters counters;
+        REQUIRE(bm.getChannelCounters("scalar", counters));
+        const size_t overwritten = counters.overwritten;
+        pushSecond(2.0);
+        REQUIRE(bm.addChannel({ "late", {1, 1} }));
+        REQUIRE(bm.getMemoryUsage() == 384 * 16 + 38 * 136 + 192 * 24);
+        REQUIRE(bm.getChannelCounters("scalar", counters));
+        REQUIRE(counters.overwritten == overwritten);
+        REQUIRE(bm.saveToFile(fileName));
+        matioCpp::File lateFile(fileName + ".mat");
+        REQUIRE(lateFile.read("buffer_manager_test_memory_budget").asStruct()("scalar").asStruct()("timestamps").asVector<double>().size() == 100);
+        REQUIRE(bm.getMemoryUsage() <= bufferConfig.memory_budget);
+
+        // When a channel shrinks while holding samples, the newest ones are kept and the others are counted as overwritten
+        robometry::BufferConfig shrinkConfig;
+        shrinkConfig.n_samples = 10;
+        shrinkConfig.filename = "buffer_manager_test_memory_budget_shrink";
+        shrinkConfig.memory_budget = 20 * 16;
+        shrinkConfig.channels = { {"fast", {1, 1}}, {"slow", {1, 1}} };
+        now = 0.0;
+        robometry::BufferManager shrinkBm;
+        REQUIRE(shrinkBm.setNowFunction([&now]() { return now; }));
+        REQUIRE(shrinkBm.configure(shrinkConfig));
+        for (int i = 0; i < 20; i++) {
+            now = i * 0.05;
+            shrinkBm.push_back(now, now, "fast");
+            if (i % 2 == 0) {
+                shrinkBm.push_back(now, now, "slow");
+            }
+        }
+        now = 1.0;
+        REQUIRE(shrinkBm.rebalanceMemory());
+        REQUIRE(shrinkBm.getMemoryUsage("slow", bytes));
+        REQUIRE(bytes == 6 * 16);
+        REQUIRE(shrinkBm.getChannelCounters("slow", counters));
+        REQUIRE(counters.overwritten == 4);
+        REQUIRE(shrinkBm.saveToFile(fileName));
+        matioCpp::File shrinkFile(fileName + ".mat");
+        auto slowTimestamps = shrinkFile.read("buffer_manager_test_memory_budget_shrink").asStruct()("slow").asStruct()("timestamps").asVector<double>();
+        REQUIRE(slowTimestamps.size() == 6);
+        REQUIRE(std::abs(slowTimestamps[0] - 0.4) < 1e-9);
+        REQUIRE(std::abs(slowTimestamps[5] - 0.9) < 1e-9);
+    }
+
+    SECTION("Retention") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 10;
+        bufferConfig.filename = "buffer_manager_test_retention";
+        robometry::ChannelInfo fast{ "fast", {1, 1} }, slow{ "slow", {1, 1} }, unknownRate{ "unknown_rate", {1, 1} };
+        fast.retention = 0.5;
+        fast.sampling_period = 0.01;
+        slow.retention = 0.5;
+        slow.sampling_period = 0.1;
+        unknownRate.retention = 0.5;
+        bufferConfig.channels = { fast, slow, unknownRate, {"plain", {1, 1}} };
+
+        double now{ 0.0 };
+        robometry::BufferManager bm;
+        REQUIRE(bm.setNowFunction([&now]() { return now; }));
+        REQUIRE(bm.configure(bufferConfig));
+        robometry::ChannelInfo negative{ "negative", {1, 1} }, lockFree{ "lock_free", {1, 1} };
+        negative.retention = -1.0;
+        lockFree.retention = 1.0;
+        lockFree.lock_free = true;
+        REQUIRE(!bm.addChannel(negative));
+        REQUIRE(!bm.addChannel(lockFree));
+
+        // The capacities hold the retention at the nominal rates with a 25% headroom, and they do not change when pushing
+        size_t bytes{ 0 };
+        for (int i = 0; i < 200; i++) {
+            now = i * 0.01;
+            bm.push_back(now, now, "fast");
+            bm.push_back(now, now, "plain");
+            bm.push_back(now, now, "unknown_rate");
+            if (i % 10 == 0) {
+                bm.push_back(now, now, "slow");
+            }
+        }
+        REQUIRE(bm.getMemoryUsage("fast", bytes));
+        REQUIRE(bytes == 63 * 16);
+        REQUIRE(bm.getMemoryUsage("slow", bytes));
+        REQUIRE(bytes == 7 * 16);
+        REQUIRE(bm.getMemoryUsage("unknown_rate", bytes));
+        REQUIRE(bytes == 10 * 16);
+
+        now = 2.0;
+        std::string fileName;
+        REQUIRE(bm.saveToFile(fileName));
+        matioCpp::File file(fileName + ".mat");
+        auto log = file.read("buffer_manager_test_retention").asStruct();
+        auto fastTimestamps = log("fast").asStruct()("timestamps").asVector<double>();
+        REQUIRE(fastTimestamps.size() == 51);
+        REQUIRE(std::abs(fastTimestamps[0] - 1.49) < 1e-9);
+        REQUIRE(std::abs(fastTimestamps[fastTimestamps.size() - 1] - 1.99) < 1e-9);
+        auto slowTimestamps = log("slow").asStruct()("timestamps").asVector<double>();
+        REQUIRE(slowTimestamps.size() == 6);
+        REQUIRE(std::abs(slowTimestamps[0] - 1.4) < 1e-9);
+        // Without the nominal rate the channel is limited by its capacity as well
+        REQUIRE(log("unknown_rate").asStruct()("timestamps").asVector<double>().size() == 10);
+        REQUIRE(log("plain").asStruct()("timestamps").asVector<double>().size() == 10);
+
+        // Without the nominal rate, the capacity follows the rate measured between the saves
+        for (int i = 0; i < 100; i++) {
+            now = 2.0 + i * 0.01;
+            bm.push_back(now, now, "unknown_rate");
+        }
+        now = 3.0;
+        REQUIRE(bm.saveToFile(fileName));
+        REQUIRE(bm.getMemoryUsage("unknown_rate", bytes));
+        REQUIRE(bytes == 63 * 16);
+        for (int i = 0; i < 100; i++) {
+            now = 3.0 + i * 0.01;
+            bm.push_back(now, now, "unknown_rate");
+        }
+        now = 4.0;
+        REQUIRE(bm.saveToFile(fileName));
+        matioCpp::File measuredFile(fileName + ".mat");
+        auto unknownRateTimestamps = measuredFile.read("buffer_manager_test_retention").asStruct()("unknown_rate").asStruct()("timestamps").asVector<double>();
+        REQUIRE(unknownRateTimestamps.size() == 51);
+        REQUIRE(std::abs(unknownRateTimestamps[0] - 3.49) < 1e-9);
+
+        // A timestamp far in the future removes all the older samples with a single cut
+        now = 10.0;
+        bm.push_back(now, now, "fast");
+        REQUIRE(bm.saveToFile(fileName));
+        matioCpp::File lastFile(fileName + ".mat");
+        REQUIRE(lastFile.read("buffer_manager_test_retention").asStruct()("fast").asStruct()("timestamps").asVector<double>().size() == 1);
+
+        // The capacity is limited by the memory budget
+        robometry::BufferConfig budgetConfig;
+        budgetConfig.n_samples = 10;
+        budgetConfig.filename = "buffer_manager_test_retention_budget";
+        budgetConfig.memory_budget = 32 * 16;
+        fast.retention = 1000.0;
+        budgetConfig.channels = { fast };
+        robometry::BufferManager budgetBm;
+        REQUIRE(budgetBm.configure(budgetConfig));
+        budgetBm.push_back(1.0, 1.0, "fast");
+        REQUIRE(budgetBm.getMemoryUsage("fast", bytes));
+        REQUIRE(bytes == 32 * 16);
+    }
+
+    SECTION("Overflow policy") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 10;
+        bufferConfig.filename = "buffer_manager_test_overflow_policy";
+        bufferConfig.flush_watermark = 0.5;
+        robometry::ChannelInfo drop{ "drop", {1, 1} }, text{ "text", {1, 1} }, flushed{ "flushed", {2, 1} };
+        drop.overflow_policy = robometry::OverflowPolicy::DropNewest;
+        text.overflow_policy = robometry::OverflowPolicy::DropNewest;
+        flushed.overflow_policy = robometry::OverflowPolicy::Flush;
+        bufferConfig.channels = { {"overwrite", {1, 1}}, drop, text, flushed };
+
+        std::vector<std::string> flushes;
+        std::mutex flushesMutex;
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        REQUIRE(bm.setSaveCallback([&](const std::string& fileName, const robometry::SaveCallbackSaveMethod& method) {
+            std::scoped_lock<std::mutex> lock{ flushesMutex };
+            if (method == robometry::SaveCallbackSaveMethod::flush) {
+                flushes.push_back(fileName);
+            }
+            return true;
+        }));
+
+        for (int i = 0; i < 15; i++) {
+            bm.push_back(i * 1.0, i * 0.01, "overwrite");
+            bm.push_back(i * 1.0, i * 0.01, "drop");
+            bm.push_back(std::string("text"), i * 0.01, "text");
+        }
+        robometry::ChannelCounters counters;
+        REQUIRE(bm.getChannelCounters("overwrite", counters));
+        REQUIRE(counters.overwritten == 5);
+        REQUIRE(counters.dropped == 0);
+        REQUIRE(bm.getChannelCounters("drop", counters));
+        REQUIRE(counters.overwritten == 0);
+        REQUIRE(counters.dropped == 5);
+        REQUIRE(bm.getChannelCounters("text", counters));
+        REQUIRE(counters.dropped == 5);
+
+        // Reaching half of the capacity, the flushed channel requests a save in background
+        for (int i = 0; i < 5; i++) {
+            bm.push_back(std::vector<double>{ i * 1.0, i * 2.0 }, i * 0.01, "flushed");
+        }
+        std::string flushFile;
+        for (int i = 0; i < 500 && flushFile.empty(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            std::scoped_lock<std::mutex> lock{ flushesMutex };
+            if (!flushes.empty()) {
+                flushFile = flushes.front();
+            }
+        }
+        REQUIRE(!flushFile.empty());
+
+        matioCpp::File file(flushFile + ".mat");
+        auto log = file.read("buffer_manager_test_overflow_policy").asStruct();
+        REQUIRE(log("flushed").asStruct()("timestamps").asVector<double>().size() == 5);
+        REQUIRE(log("overwrite").asStruct()("overwritten_samples").asElement<size_t>()() == 5);
+        REQUIRE(log("drop").asStruct()("dropped_samples").asElement<size_t>()() == 5);
+        auto dropTimestamps = log("drop").asStruct()("timestamps").asVector<double>();
+        REQUIRE(dropTimestamps.size() == 10);
+        REQUIRE(std::abs(dropTimestamps[9] - 0.09) < 1e-9);
+
+        // The counters are saved when appending to the file and in the binary log as well
+        for (const bool binaryLog : { false, true }) {
+            robometry::BufferConfig formatConfig;
+            formatConfig.n_samples = 10;
+            formatConfig.filename = binaryLog ? "buffer_manager_test_overflow_log" : "buffer_manager_test_overflow_append";
+            formatConfig.append_to_file = !binaryLog;
+            formatConfig.save_format = binaryLog ? robometry::SaveFormat::BinaryLog : robometry::SaveFormat::Mat;
+            formatConfig.mat_file_version = matioCpp::FileVersion::MAT7_3;
+            formatConfig.channels = { {"overwrite", {1, 1}}, drop };
+            robometry::BufferManager formatBm;
+            REQUIRE(formatBm.configure(formatConfig));
+
+            // Each save loses 5 samples of both channels
+            std::string formatFile;
+            for (int save = 0; save < 2; save++) {
+                for (int i = 0; i < 15; i++) {
+                    const double ts = save * 0.15 + i * 0.01;
+                    formatBm.push_back(i * 1.0, ts, "overwrite");
+                    formatBm.push_back(i * 1.0, ts, "drop");
+                }
+                REQUIRE(formatBm.saveToFile(formatFile));
+            }
+
+            if (binaryLog) {
+                REQUIRE(robometry::binaryLogToMat(formatFile + ".rblog", formatFile + ".mat"));
+                matioCpp::File logFile(formatFile + ".mat");
+                auto converted = logFile.read("buffer_manager_test_overflow_log").asStruct();
+                REQUIRE(converted("overwrite").asStruct()("overwritten_samples").asElement<size_t>()() == 10);
+                REQUIRE(converted("overwrite").asStruct()("dropped_samples").asElement<size_t>()() == 0);
+                REQUIRE(converted("drop").asStruct()("dropped_samples").asElement<size_t>()() == 10);
+            }
+            else {
+                matioCpp::File appendFile(formatFile + ".mat");
+                auto description = appendFile.read("buffer_manager_test_overflow_append").asStruct();
+                REQUIRE(description("overwrite").asStruct()("overwritten_samples_variable").asString()() == "overwrite__overwritten_samples");
+                REQUIRE(description("drop").asStruct()("dropped_samples_variable").asString()() == "drop__dropped_samples");
+                auto overwritten = appendFile.read("overwrite__overwritten_samples").asMultiDimensionalArray<size_t>();
+                REQUIRE(overwritten.numberOfElements() == 2);
+                REQUIRE(overwritten[0] == 5);
+                REQUIRE(overwritten[1] == 10);
+                auto dropped = appendFile.read("drop__dropped_samples").asMultiDimensionalArray<size_t>();
+                REQUIRE(dropped.numberOfElements() == 2);
+                REQUIRE(dropped[1] == 10);
+            }
+        }
+    }
+
+    SECTION("Save watermark") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 100;
+        bufferConfig.filename = "buffer_manager_test_save_watermark";
+        bufferConfig.save_periodically = true;
+        bufferConfig.save_period = 10.0;
+        bufferConfig.save_watermark = 0.5;
+        bufferConfig.channels = { {"scalar", {1, 1}} };
+
+        std::vector<std::string> saves;
+        std::mutex savesMutex;
+        auto callback = [&](const std::string& fileName, const robometry::SaveCallbackSaveMethod& method) {
+            std::scoped_lock<std::mutex> lock{ savesMutex };
+            if (method == robometry::SaveCallbackSaveMethod::periodic) {
+                saves.push_back(fileName);
+            }
+            return true;
+        };
+        auto numberOfSaves = [&]() {
+            std::scoped_lock<std::mutex> lock{ savesMutex };
+            return saves.size();
+        };
+
+        {
+            robometry::BufferManager bm;
+            REQUIRE(bm.setSaveCallback(callback));
+            REQUIRE(bm.configure(bufferConfig));
+            for (int i = 0; i < 40; i++) {
+                bm.push_back(i * 1.0, i * 0.01, "scalar");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            REQUIRE(numberOfSaves() == 0);
+
+            // Half of the capacity wakes up the save thread, long before the end of the period
+            for (int i = 40; i < 50; i++) {
+                bm.push_back(i * 1.0, i * 0.01, "scalar");
+            }
+            for (int i = 0; i < 500 && numberOfSaves() == 0; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            REQUIRE(numberOfSaves() == 1);
+            matioCpp::File file(saves.front() + ".mat");
+            auto log = file.read("buffer_manager_test_save_watermark").asStruct();
+            REQUIRE(log("scalar").asStruct()("timestamps").asVector<double>().size() >= 50);
+        }
+
+        // The wake ups at the end of the period do not save empty files
+        bufferConfig.save_period = 0.01;
+        robometry::BufferManager bm;
+        REQUIRE(bm.setSaveCallback(callback));
+        REQUIRE(bm.configure(bufferConfig));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        REQUIRE(numberOfSaves() == 1);
+    }
+
+    SECTION("Save deadlines") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 100;
+        bufferConfig.filename = "buffer_manager_test_save_deadlines";
+        bufferConfig.save_periodically = true;
+        bufferConfig.save_period = 0.02;
+        bufferConfig.channels = { {"scalar", {1, 1}} };
+
+        // The saves take longer than the period
+        auto callback = [](const std::string&, const robometry::SaveCallbackSaveMethod& method) {
+            if (method == robometry::SaveCallbackSaveMethod::periodic) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            return true;
+        };
+
+        {
+            robometry::BufferManager bm;
+            REQUIRE(bm.setSaveCallback(callback));
+            REQUIRE(bm.configure(bufferConfig));
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            auto counters = bm.getSaveCounters();
+            REQUIRE(counters.saves >= 2);
+            REQUIRE(counters.missed_deadlines >= counters.saves - 1);
+            // The deadline served late by a save is not missed, at most duration / period deadlines expire before it
+            REQUIRE(counters.missed_deadlines <= counters.saves * counters.max_duration / counters.period);
+            REQUIRE(counters.period == bufferConfig.save_period);
+            REQUIRE(counters.max_duration >= 0.05);
+            REQUIRE(counters.last_duration >= 0.05);
+            REQUIRE(counters.max_lag >= counters.last_lag);
+        }
+
+        // The period is stretched, so that the saves meet the deadlines
+        bufferConfig.adaptive_save_period = true;
+        robometry::BufferManager bm;
+        REQUIRE(bm.setSaveCallback(callback));
+        REQUIRE(bm.configure(bufferConfig));
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        auto counters = bm.getSaveCounters();
+        REQUIRE(counters.saves >= 2);
+        REQUIRE(counters.period >= 1.25 * 0.05);
+        REQUIRE(counters.missed_deadlines <= 2);
+    }
+
+    SECTION("Memory-mapped storage") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = 20000;
+        bufferConfig.filename = "buffer_manager_test_memory_mapped";
+        bufferConfig.memory_mapped_path = "buffer_manager_test_memory_mapped_storage";
+        bufferConfig.channels = { {"vector", {3, 1}}, {"string", {1, 1}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        REQUIRE(robometry_fs::is_directory(bufferConfig.memory_mapped_path));
+
+        // The samples wrap around the ring and span many chunks
+        for (int i = 0; i < 25000; i++) {
+            bm.push_back(std::vector<double>{ i * 1.0, i * 2.0, i * 3.0 }, i, "vector");
+        }
+        bm.push_back(std::string("not numeric"), 0.0, "string");
+        // The temporary files are removed from the file system as soon as they are created
+        REQUIRE(robometry_fs::is_empty(bufferConfig.memory_mapped_path));
+
+        std::string fileName;
+        REQUIRE(bm.saveToFile(fileName));
+        matioCpp::File file(fileName + ".mat");
+        auto vectorStruct = file.read("buffer_manager_test_memory_mapped").asStruct()("vector").asStruct();
+        auto data = vectorStruct("data").asMultiDimensionalArray<double>();
+        REQUIRE(data.numberOfElements() == 3 * 20000);
+        REQUIRE(data[0] == 5000.0);
+        REQUIRE(data[3 * 20000 - 1] == 3 * 24999.0);
+        auto timestamps = vectorStruct("timestamps").asVector<double>();
+        REQUIRE(timestamps[0] == 5000.0);
+        REQUIRE(timestamps[19999] == 24999.0);
+    }
+
+    SECTION("Flight recorder") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_flight_recorder";
+        bufferConfig.flight_recorder_path = "buffer_manager_test_flight_recorder_sessions";
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} }, currents{ "joints::currents", {2, 1} };
+        positions.clock_group = "joints";
+        currents.clock_group = "joints";
+        robometry::ChannelInfo dropped{ "dropped", {1, 1} };
+        dropped.overflow_policy = robometry::OverflowPolicy::DropNewest;
+        bufferConfig.channels = { positions, currents, {"temperature", {1, 1}}, {"string", {1, 1}}, dropped };
+
+        std::string sessionDirectory;
+        {
+            robometry::BufferManager bm;
+            REQUIRE(bm.configure(bufferConfig));
+            sessionDirectory = bm.getFlightRecorderDirectory();
+            REQUIRE(robometry_fs::is_directory(sessionDirectory));
+
+            auto frame = bm.getFrameHandle("joints");
+            auto positionsHandle = bm.getChannelHandle("joints::positions");
+            auto currentsHandle = bm.getChannelHandle("joints::currents");
+            for (int i = 0; i < 5; i++) {
+                std::vector<double> q{ i * 1.0, i * 2.0 }, c{ i * 3.0, i * 4.0 };
+                REQUIRE(frame.set(positionsHandle, q));
+                REQUIRE(frame.set(currentsHandle, c));
+                bm.push_back(frame, i);
+                bm.push_back(i, i + 0.5, "temperature");
+            }
+            bm.push_back(std::string("not numeric"), 0.0, "string");
+            // The samples dropped by the full channel are not recorded
+            const std::vector<double> droppedData{ 0.0, 1.0, 2.0, 3.0, 4.0 };
+            const std::vector<double> droppedTimestamps{ 0.0, 1.0, 2.0, 3.0, 4.0 };
+            bm.push_back_batch("dropped", matioCpp::make_span(droppedData), matioCpp::make_span(droppedTimestamps));
+            bm.push_back(10.0, 10.0, "dropped");
+
+            // The rings keep the last samples also after they are saved, as if the process crashed now
+            REQUIRE(bm.saveToFile());
+            REQUIRE(!robometry::flightRecorderToMat("not_existing_session", "not_existing.mat"));
+            REQUIRE(robometry::flightRecorderToMat(sessionDirectory, "buffer_manager_test_flight_recorder_recovered.mat"));
+        }
+        // The session is removed when the BufferManager is destroyed
+        REQUIRE(!robometry_fs::exists(sessionDirectory));
+
+        matioCpp::File file("buffer_manager_test_flight_recorder_recovered.mat");
+        auto log = file.read("buffer_manager_test_flight_recorder").asStruct();
+        auto temperature = log("temperature").asStruct();
+        auto temperatureData = temperature("data").asMultiDimensionalArray<int>();
+        REQUIRE(temperatureData.numberOfElements() == n_samples);
+        REQUIRE(temperatureData[0] == 2);
+        REQUIRE(temperature("timestamps").asVector<double>()[2] == 4.5);
+
+        auto currentsStruct = log("joints").asStruct()("currents").asStruct();
+        auto currentsData = currentsStruct("data").asMultiDimensionalArray<double>();
+        REQUIRE(currentsData.numberOfElements() == 2 * n_samples);
+        REQUIRE(currentsData[0] == 6.0);
+        REQUIRE(currentsData[5] == 16.0);
+        REQUIRE(currentsStruct("clock_group").asString()() == "joints");
+        auto jointsTimestamps = log("clock_groups").asStruct()("joints").asVector<double>();
+        REQUIRE(jointsTimestamps.size() == n_samples);
+        REQUIRE(jointsTimestamps[0] == 2.0);
+
+        auto droppedTimestampsRecovered = log("dropped").asStruct()("timestamps").asVector<double>();
+        REQUIRE(droppedTimestampsRecovered.size() == n_samples);
+        REQUIRE(droppedTimestampsRecovered[0] == 0.0);
+        REQUIRE(droppedTimestampsRecovered[n_samples - 1] == 2.0);
+    }
+
+#ifndef _WIN32
+    SECTION("Emergency dump") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_emergency_dump";
+        bufferConfig.emergency_dump_path = "buffer_manager_test_emergency_dumps";
+        robometry::ChannelInfo positions{ "joints::positions", {2, 1} };
+        positions.clock_group = "joints";
+        bufferConfig.channels = { positions, {"temperature", {1, 1}} };
+
+        auto dumpFiles = [&bufferConfig]() {
+            std::vector<std::string> files;
+            for (const auto& entry : robometry_fs::directory_iterator(bufferConfig.emergency_dump_path)) {
+                files.push_back(entry.path().string());
+            }
+            return files;
+        };
+
+        {
+            robometry::BufferManager bm;
+            REQUIRE(bm.configure(bufferConfig));
+            REQUIRE(dumpFiles().size() == 1);
+            REQUIRE(bm.emergencyDump());
+        }
+        // Nothing was pushed, the dump is not removed since it has been written
+        REQUIRE(dumpFiles().size() == 1);
+        robometry_fs::remove_all(bufferConfig.emergency_dump_path);
+
+        {
+            robometry::BufferManager bm;
+            REQUIRE(bm.configure(bufferConfig));
+        }
+        // The dump that has not been written is removed
+        REQUIRE(dumpFiles().empty());
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+        auto frame = bm.getFrameHandle("joints");
+        auto positionsHandle = bm.getChannelHandle("joints::positions");
+        for (int i = 0; i < 5; i++) {
+            std::vector<double> q{ i * 1.0, i * 2.0 };
+            REQUIRE(frame.set(positionsHandle, q));
+            bm.push_back(frame, i);
+            bm.push_back(i, i + 0.5, "temperature");
+        }
+        REQUIRE(bm.emergencyDump());
+        REQUIRE(!bm.emergencyDump());
+
+        const auto files = dumpFiles();
+        REQUIRE(files.size() == 1);
+        REQUIRE(robometry::binaryLogToMat(files.front(), "buffer_manager_test_emergency_dump.mat"));
+        matioCpp::File file("buffer_manager_test_emergency_dump.mat");
+        auto log = file.read("buffer_manager_test_emergency_dump").asStruct();
+        auto temperature = log("temperature").asStruct();
+        auto temperatureData = temperature("data").asMultiDimensionalArray<int>();
+        REQUIRE(temperatureData.numberOfElements() == n_samples);
+        REQUIRE(temperatureData[0] == 2);
+        REQUIRE(temperature("timestamps").asVector<double>()[2] == 4.5);
+        auto positionsData = log("joints").asStruct()("positions").asStruct()("data").asMultiDimensionalArray<double>();
+        REQUIRE(positionsData.numberOfElements() == 2 * n_samples);
+        REQUIRE(positionsData[5] == 8.0);
+        REQUIRE(log("clock_groups").asStruct()("joints").asVector<double>()[0] == 2.0);
+    }
+#endif
+
+    SECTION("Lock-free channels") {
+        robometry::BufferConfig bufferConfig;
+        bufferConfig.n_samples = n_samples;
+        bufferConfig.filename = "buffer_manager_test_lock_free";
+        robometry::ChannelInfo lockFreeChannel{ "lock_free", {2, 1} };
+        lockFreeChannel.lock_free = true;
+        bufferConfig.channels = { lockFreeChannel, {"overwrite", {1, 1}} };
+
+        robometry::BufferManager bm;
+        REQUIRE(bm.configure(bufferConfig));
+
+        for (int i = 0; i < 5; i++) {
+            bm.push_back({ i * 1.0, i * 2.0 }, i, "lock_free");
+            bm.push_back(i, i, "overwrite");
+        }
+
+        // When full, the lock-free channel drops the new samples instead of overwriting the oldest ones
+        robometry::ChannelCounters counters;
+        REQUIRE(bm.getChannelCounters("lock_free", counters));
+        REQUIRE(counters.dropped == 2);
+        REQUIRE(counters.overwritten == 0);
+        REQUIRE(bm.getChannelCounters("overwrite", counters));
+        REQUIRE(counters.dropped == 0);
+        REQUIRE(counters.overwritten == 2);
+        REQUIRE(!bm.getChannelCounters("three", counters));
+
+        // The samples of a different type are rejected
+        bm.push_back(std::vector<int>{ 1, 2 }, 5, "lock_free");
+        REQUIRE(bm.getChannelCounters("lock_free", counters));
+        REQUIRE(counters.dropped == 2);
+
+        // The producer keeps pushing while the channel is saved
+        std::atomic<bool> stop{ false };
+        std::thread producer([&bm, &stop]() {
+            auto handle = bm.getChannelHandle("lock_free");
+            for (int i = 0; !stop; i++) {
+                bm.push_back(handle, { i * 1.0, i * 2.0 }, i);
+            }
+        });
+        for (int i = 0; i < 5; i++) {
+            REQUIRE(bm.saveToFile());
+        }
+        stop = true;
+        producer.join();
+    }
+
 #if defined CATCH_CONFIG_ENABLE_BENCHMARKING
 
     SECTION("Benchmarking section scalar int") {